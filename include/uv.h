@@ -232,15 +232,28 @@ typedef struct uv_work_s uv_work_t;
 
 /* None of the above. */
 typedef struct uv_cpu_info_s uv_cpu_info_t;
+typedef struct uv_cpu_topology_s uv_cpu_topology_t;
 typedef struct uv_interface_address_s uv_interface_address_t;
 typedef struct uv_dirent_s uv_dirent_t;
 typedef struct uv_passwd_s uv_passwd_t;
 typedef struct uv_utsname_s uv_utsname_t;
+typedef struct uv_epoch_s uv_epoch_t;
+typedef struct uv_loop_group_s uv_loop_group_t;
+typedef struct uv_idle_task_s uv_idle_task_t;
 
 typedef enum {
-  UV_LOOP_BLOCK_SIGNAL
+  UV_LOOP_BLOCK_SIGNAL,
+  UV_LOOP_USE_ARENA,
+  UV_LOOP_TIME_BUDGET,
+  UV_LOOP_IDLE_TASK_BUDGET,
+  UV_LOOP_READ_POOL
 } uv_loop_option;
 
+enum uv_read_pool_flags {
+  /* Back the pool's slabs with huge pages where the platform has them. */
+  UV_READ_POOL_HUGEPAGES = 1
+};
+
 typedef enum {
   UV_RUN_DEFAULT = 0,
   UV_RUN_ONCE,
@@ -261,6 +274,58 @@ UV_EXTERN int uv_replace_allocator(uv_malloc_func malloc_func,
                                    uv_calloc_func calloc_func,
                                    uv_free_func free_func);
 
+typedef void* (*uv_loop_malloc_func)(void* ctx, size_t size);
+typedef void* (*uv_loop_realloc_func)(void* ctx, void* ptr, size_t size);
+typedef void (*uv_loop_free_func)(void* ctx, void* ptr);
+
+UV_EXTERN int uv_loop_replace_allocator(uv_loop_t* loop,
+                                        void* ctx,
+                                        uv_loop_malloc_func malloc_func,
+                                        uv_loop_realloc_func realloc_func,
+                                        uv_loop_free_func free_func);
+
+typedef enum {
+  UV_ALLOC_LOOP,
+  UV_ALLOC_STREAM,
+  UV_ALLOC_UDP,
+  UV_ALLOC_FS,
+  UV_ALLOC_DNS,
+  UV_ALLOC_PROCESS,
+  UV_ALLOC_SUBSYSTEM_MAX
+} uv_alloc_subsystem;
+
+typedef struct {
+  uint64_t bytes;
+  uint64_t peak_bytes;
+  uint64_t objects;
+  uint64_t peak_objects;
+} uv_alloc_stats_t;
+
+UV_EXTERN int uv_loop_alloc_stats(const uv_loop_t* loop,
+                                  uv_alloc_subsystem subsystem,
+                                  uv_alloc_stats_t* stats);
+
+typedef struct {
+  uv_handle_type type;  /* UV_UNKNOWN_HANDLE if not known. */
+  uv_handle_t* handle;
+  void (*cb)(void);  /* Function the loop dispatched, cast to its real type. */
+  uint64_t elapsed;  /* Milliseconds the loop has been stuck. */
+} uv_watchdog_report_t;
+
+typedef void (*uv_watchdog_cb)(uv_loop_t* loop,
+                               const uv_watchdog_report_t* report,
+                               void* arg);
+
+UV_EXTERN int uv_loop_watchdog_start(uv_loop_t* loop,
+                                     uint64_t timeout,
+                                     uv_watchdog_cb cb,
+                                     void* arg);
+UV_EXTERN int uv_loop_watchdog_stop(uv_loop_t* loop);
+
+UV_EXTERN int uv_loop_trace_start(uv_loop_t* loop, size_t capacity);
+UV_EXTERN int uv_loop_trace_stop(uv_loop_t* loop);
+UV_EXTERN int uv_loop_trace_dump(uv_loop_t* loop, FILE* stream);
+
 UV_EXTERN uv_loop_t* uv_default_loop(void);
 UV_EXTERN int uv_loop_init(uv_loop_t* loop);
 UV_EXTERN int uv_loop_close(uv_loop_t* loop);
@@ -282,6 +347,7 @@ UV_EXTERN int uv_loop_configure(uv_loop_t* loop, uv_loop_option option, ...);
 UV_EXTERN int uv_loop_fork(uv_loop_t* loop);
 
 UV_EXTERN int uv_run(uv_loop_t*, uv_run_mode mode);
+UV_EXTERN int uv_run_until(uv_loop_t*, uint64_t deadline);
 UV_EXTERN void uv_stop(uv_loop_t*);
 
 UV_EXTERN void uv_ref(uv_handle_t*);
@@ -304,6 +370,10 @@ typedef void (*uv_write_cb)(uv_write_t* req, int status);
 typedef void (*uv_connect_cb)(uv_connect_t* req, int status);
 typedef void (*uv_shutdown_cb)(uv_shutdown_t* req, int status);
 typedef void (*uv_connection_cb)(uv_stream_t* server, int status);
+typedef void (*uv_connection_batch_cb)(uv_stream_t* server,
+                                       int status,
+                                       unsigned int count);
+typedef void (*uv_migrate_cb)(uv_stream_t* handle, int status);
 typedef void (*uv_close_cb)(uv_handle_t* handle);
 typedef void (*uv_poll_cb)(uv_poll_t* handle, int status, int events);
 typedef void (*uv_timer_cb)(uv_timer_t* handle);
@@ -311,6 +381,8 @@ typedef void (*uv_async_cb)(uv_async_t* handle);
 typedef void (*uv_prepare_cb)(uv_prepare_t* handle);
 typedef void (*uv_check_cb)(uv_check_t* handle);
 typedef void (*uv_idle_cb)(uv_idle_t* handle);
+typedef void (*uv_idle_task_cb)(uv_idle_task_t* task, uint64_t deadline);
+typedef void (*uv_defer_cb)(void* data);
 typedef void (*uv_exit_cb)(uv_process_t*, int64_t exit_status, int term_signal);
 typedef void (*uv_walk_cb)(uv_handle_t* handle, void* arg);
 typedef void (*uv_fs_cb)(uv_fs_t* req);
@@ -441,6 +513,8 @@ UV_EXTERN void* uv_req_get_data(const uv_req_t* req);
 UV_EXTERN void uv_req_set_data(uv_req_t* req, void* data);
 UV_EXTERN uv_req_type uv_req_get_type(const uv_req_t* req);
 UV_EXTERN const char* uv_req_type_name(uv_req_type type);
+UV_EXTERN uv_req_t* uv_req_acquire(uv_loop_t* loop, uv_req_type type);
+UV_EXTERN void uv_req_release(uv_loop_t* loop, uv_req_t* req);
 
 UV_EXTERN int uv_is_active(const uv_handle_t* handle);
 
@@ -457,6 +531,16 @@ UV_EXTERN int uv_recv_buffer_size(uv_handle_t* handle, int* value);
 
 UV_EXTERN int uv_fileno(const uv_handle_t* handle, uv_os_fd_t* fd);
 
+typedef enum {
+  UV_IO_PRIORITY_NORMAL = 0,
+  UV_IO_PRIORITY_HIGH
+} uv_io_priority_t;
+
+UV_EXTERN int uv_handle_set_io_priority(uv_handle_t* handle, int priority);
+UV_EXTERN int uv_handle_set_read_size(uv_handle_t* handle,
+                                      size_t min_size,
+                                      size_t max_size);
+
 UV_EXTERN uv_buf_t uv_buf_init(char* base, unsigned int len);
 
 
@@ -483,11 +567,17 @@ struct uv_stream_s {
 UV_EXTERN size_t uv_stream_get_write_queue_size(const uv_stream_t* stream);
 
 UV_EXTERN int uv_listen(uv_stream_t* stream, int backlog, uv_connection_cb cb);
+UV_EXTERN int uv_listen_batch(uv_stream_t* stream,
+                              int backlog,
+                              unsigned int max_batch,
+                              uv_connection_batch_cb cb);
 UV_EXTERN int uv_accept(uv_stream_t* server, uv_stream_t* client);
 
 UV_EXTERN int uv_read_start(uv_stream_t*,
                             uv_alloc_cb alloc_cb,
                             uv_read_cb read_cb);
+UV_EXTERN int uv_read_start_pooled(uv_stream_t*, uv_read_cb read_cb);
+UV_EXTERN void uv_read_pool_release(uv_loop_t* loop, const uv_buf_t* buf);
 UV_EXTERN int uv_read_stop(uv_stream_t*);
 
 UV_EXTERN int uv_write(uv_write_t* req,
@@ -501,9 +591,19 @@ UV_EXTERN int uv_write2(uv_write_t* req,
                         unsigned int nbufs,
                         uv_stream_t* send_handle,
                         uv_write_cb cb);
+UV_EXTERN int uv_write_handles(uv_write_t* req,
+                               uv_stream_t* handle,
+                               const uv_buf_t bufs[],
+                               unsigned int nbufs,
+                               uv_stream_t* send_handles[],
+                               unsigned int nsend_handles,
+                               uv_write_cb cb);
 UV_EXTERN int uv_try_write(uv_stream_t* handle,
                            const uv_buf_t bufs[],
                            unsigned int nbufs);
+UV_EXTERN int uv_try_read(uv_stream_t* handle,
+                          const uv_buf_t bufs[],
+                          unsigned int nbufs);
 
 /* uv_write_t is a subclass of uv_req_t. */
 struct uv_write_s {
@@ -520,6 +620,21 @@ UV_EXTERN int uv_is_writable(const uv_stream_t* handle);
 
 UV_EXTERN int uv_stream_set_blocking(uv_stream_t* handle, int blocking);
 
+UV_EXTERN int uv_stream_migrate(uv_stream_t* handle,
+                                uv_loop_t* loop,
+                                uv_migrate_cb cb);
+
+typedef struct {
+  uint64_t max_loop_lag;  /* Milliseconds, 0 to not check. */
+  unsigned int max_connections;  /* 0 to not check. */
+  unsigned int min_free_fds;  /* 0 to not check. */
+  unsigned int hysteresis;  /* Percent. */
+} uv_admission_t;
+
+UV_EXTERN int uv_listen_set_admission(uv_stream_t* server,
+                                      const uv_admission_t* limits);
+UV_EXTERN int uv_listen_is_paused(const uv_stream_t* server);
+
 UV_EXTERN int uv_is_closing(const uv_handle_t* handle);
 
 
@@ -542,10 +657,17 @@ UV_EXTERN int uv_tcp_keepalive(uv_tcp_t* handle,
                                int enable,
                                unsigned int delay);
 UV_EXTERN int uv_tcp_simultaneous_accepts(uv_tcp_t* handle, int enable);
+UV_EXTERN int uv_tcp_exclusive_accept(uv_tcp_t* handle, int enable);
+UV_EXTERN int uv_tcp_zerocopy(uv_tcp_t* handle, int enable, size_t min_size);
+UV_EXTERN int uv_tcp_reuseport_steer_cpu(uv_tcp_t* handle);
 
 enum uv_tcp_flags {
   /* Used with uv_tcp_bind, when an IPv6 address is used. */
-  UV_TCP_IPV6ONLY = 1
+  UV_TCP_IPV6ONLY = 1,
+  /* Used with uv_tcp_bind, lets sockets on other loops bind the same address
+   * and share its incoming connections.
+   */
+  UV_TCP_REUSEPORT = 2
 };
 
 UV_EXTERN int uv_tcp_bind(uv_tcp_t* handle,
@@ -662,6 +784,8 @@ UV_EXTERN int uv_udp_try_send(uv_udp_t* handle,
 UV_EXTERN int uv_udp_recv_start(uv_udp_t* handle,
                                 uv_alloc_cb alloc_cb,
                                 uv_udp_recv_cb recv_cb);
+UV_EXTERN int uv_udp_recv_start_pooled(uv_udp_t* handle,
+                                       uv_udp_recv_cb recv_cb);
 UV_EXTERN int uv_udp_recv_stop(uv_udp_t* handle);
 UV_EXTERN size_t uv_udp_get_send_queue_size(const uv_udp_t* handle);
 UV_EXTERN size_t uv_udp_get_send_queue_count(const uv_udp_t* handle);
@@ -787,6 +911,22 @@ UV_EXTERN int uv_idle_start(uv_idle_t* idle, uv_idle_cb cb);
 UV_EXTERN int uv_idle_stop(uv_idle_t* idle);
 
 
+struct uv_idle_task_s {
+  void* data;
+  /* private */
+  uv_loop_t* loop;  /* NULL once run or cancelled. */
+  uv_idle_task_cb cb;
+  void* queue[2];
+};
+
+UV_EXTERN int uv_idle_task_post(uv_loop_t* loop,
+                                uv_idle_task_t* task,
+                                uv_idle_task_cb cb);
+UV_EXTERN int uv_idle_task_cancel(uv_idle_task_t* task);
+
+UV_EXTERN int uv_defer(uv_loop_t* loop, uv_defer_cb cb, void* data);
+
+
 struct uv_async_s {
   UV_HANDLE_FIELDS
   UV_ASYNC_PRIVATE_FIELDS
@@ -1038,6 +1178,15 @@ struct uv_cpu_info_s {
   struct uv_cpu_times_s cpu_times;
 };
 
+struct uv_cpu_topology_s {
+  int cpu;
+  int core;
+  int package;
+  int cache;
+  int node;
+  int allowed;
+};
+
 struct uv_interface_address_s {
   char* name;
   char phys_addr[6];
@@ -1144,6 +1293,8 @@ UV_EXTERN int uv_os_setpriority(uv_pid_t pid, int priority);
 
 UV_EXTERN int uv_cpu_info(uv_cpu_info_t** cpu_infos, int* count);
 UV_EXTERN void uv_free_cpu_info(uv_cpu_info_t* cpu_infos, int count);
+UV_EXTERN int uv_cpu_topology(uv_cpu_topology_t** cpus, int* count);
+UV_EXTERN void uv_free_cpu_topology(uv_cpu_topology_t* cpus, int count);
 
 UV_EXTERN int uv_interface_addresses(uv_interface_address_t** addresses,
                                      int* count);
@@ -1642,6 +1793,54 @@ UV_EXTERN uv_thread_t uv_thread_self(void);
 UV_EXTERN int uv_thread_join(uv_thread_t *tid);
 UV_EXTERN int uv_thread_equal(const uv_thread_t* t1, const uv_thread_t* t2);
 
+typedef void (*uv_epoch_cb)(void* arg);
+
+struct uv_epoch_s {
+  /* private */
+  uv_mutex_t mutex;
+  uv_cond_t cond;
+  void* loops[2];
+  void* deferred[2];
+  unsigned int counter;
+  unsigned int ndeferred;
+};
+
+UV_EXTERN int uv_epoch_init(uv_epoch_t* epoch);
+UV_EXTERN void uv_epoch_destroy(uv_epoch_t* epoch);
+UV_EXTERN int uv_epoch_register(uv_epoch_t* epoch, uv_loop_t* loop);
+UV_EXTERN int uv_epoch_unregister(uv_epoch_t* epoch, uv_loop_t* loop);
+UV_EXTERN void uv_epoch_quiescent(uv_loop_t* loop);
+UV_EXTERN void uv_epoch_synchronize(uv_epoch_t* epoch);
+UV_EXTERN int uv_epoch_defer(uv_epoch_t* epoch, uv_epoch_cb cb, void* arg);
+UV_EXTERN void* uv_epoch_read(void* const* slot);
+UV_EXTERN void* uv_epoch_publish(void** slot, void* value);
+
+
+typedef void (*uv_loop_group_cb)(uv_loop_t* loop, void* arg);
+
+enum uv_loop_group_flags {
+  /* Pin the thread of each loop to its own CPU. */
+  UV_LOOP_GROUP_PIN = 1
+};
+
+struct uv_loop_group_s {
+  void* data;
+  /* private */
+  void* members;
+  unsigned int nmembers;
+};
+
+UV_EXTERN int uv_loop_group_init(uv_loop_group_t* group,
+                                 unsigned int nloops,
+                                 unsigned int flags);
+UV_EXTERN unsigned int uv_loop_group_size(const uv_loop_group_t* group);
+UV_EXTERN int uv_loop_group_post(uv_loop_group_t* group,
+                                 unsigned int index,
+                                 uv_loop_group_cb cb,
+                                 void* arg);
+UV_EXTERN void uv_loop_group_stop(uv_loop_group_t* group);
+UV_EXTERN int uv_loop_group_join(uv_loop_group_t* group);
+
 /* The presence of these unions force similar struct layout. */
 #define XX(_, name) uv_ ## name ## _t name;
 union uv_any_handle {
@@ -1661,9 +1860,11 @@ struct uv_loop_s {
   unsigned int active_handles;
   void* handle_queue[2];
   union {
-    void* unused[2];
+    void* unused;
     unsigned int count;
   } active_reqs;
+  /* Internal storage for future extensions. */
+  void* internal_fields;
   /* Internal flag to signal loop stop. */
   unsigned int stop_flag;
   UV_LOOP_PRIVATE_FIELDS
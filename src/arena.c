@@ -0,0 +1,231 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Per-loop arena for memory libuv allocates on behalf of a loop.
+ *
+ * Small blocks come from power-of-two size classes that are carved out of
+ * large slabs and recycled through per-class free lists. The arena is only
+ * touched from the loop's thread so it needs no locking and never contends
+ * with other loops for the process-wide allocator. Slabs are released when
+ * the loop is closed. Blocks that are too big for any size class go straight
+ * to uv__malloc().
+ */
+
+#include "uv-common.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define UV__ARENA_MIN_SHIFT 5   /* Smallest block is 32 bytes. */
+#define UV__ARENA_NCLASSES 8    /* Largest block is 4 kB. */
+#define UV__ARENA_SLAB_SIZE (64 * 1024)
+#define UV__ARENA_LARGE UV__ARENA_NCLASSES
+
+/* Precedes every block. Padded so the memory that follows it is suitably
+ * aligned for any type.
+ */
+typedef union {
+  unsigned int size_class;
+  double align_d;
+  void* align_p;
+  char pad[16];
+} uv__arena_header_t;
+
+/* Slabs are linked through a header-sized prefix. */
+typedef union uv__arena_slab_u uv__arena_slab_t;
+
+union uv__arena_slab_u {
+  uv__arena_slab_t* next;
+  uv__arena_header_t align;
+};
+
+typedef struct {
+  uv__arena_header_t* free_lists[UV__ARENA_NCLASSES];
+  uv__arena_slab_t* slabs;
+  char* slab_pos;
+  char* slab_end;
+} uv__arena_t;
+
+
+static unsigned int uv__arena_size_class(size_t size) {
+  unsigned int size_class;
+  size_t block_size;
+
+  size += sizeof(uv__arena_header_t);
+  block_size = (size_t) 1 << UV__ARENA_MIN_SHIFT;
+
+  for (size_class = 0; size_class < UV__ARENA_NCLASSES; size_class++) {
+    if (size <= block_size)
+      break;
+    block_size <<= 1;
+  }
+
+  return size_class;
+}
+
+
+static size_t uv__arena_block_size(unsigned int size_class) {
+  return (size_t) 1 << (size_class + UV__ARENA_MIN_SHIFT);
+}
+
+
+static uv__arena_header_t* uv__arena_carve(uv__arena_t* arena,
+                                           unsigned int size_class) {
+  uv__arena_slab_t* slab;
+  size_t block_size;
+  char* block;
+
+  block_size = uv__arena_block_size(size_class);
+
+  if ((size_t) (arena->slab_end - arena->slab_pos) < block_size) {
+    slab = uv__malloc(UV__ARENA_SLAB_SIZE);
+    if (slab == NULL)
+      return NULL;
+
+    /* The tail of the previous slab is wasted, at most one block's worth. */
+    slab->next = arena->slabs;
+    arena->slabs = slab;
+    arena->slab_pos = (char*) (slab + 1);
+    arena->slab_end = (char*) slab + UV__ARENA_SLAB_SIZE;
+  }
+
+  block = arena->slab_pos;
+  arena->slab_pos += block_size;
+
+  return (uv__arena_header_t*) block;
+}
+
+
+static void* uv__arena_malloc(void* ctx, size_t size) {
+  uv__arena_header_t* header;
+  unsigned int size_class;
+  uv__arena_t* arena;
+
+  arena = ctx;
+  size_class = uv__arena_size_class(size);
+
+  if (size_class == UV__ARENA_LARGE) {
+    header = uv__malloc(sizeof(*header) + size);
+  } else if (arena->free_lists[size_class] != NULL) {
+    header = arena->free_lists[size_class];
+    arena->free_lists[size_class] = *(uv__arena_header_t**) (header + 1);
+  } else {
+    header = uv__arena_carve(arena, size_class);
+  }
+
+  if (header == NULL)
+    return NULL;
+
+  header->size_class = size_class;
+  return header + 1;
+}
+
+
+static void uv__arena_free(void* ctx, void* ptr) {
+  uv__arena_header_t* header;
+  uv__arena_t* arena;
+
+  arena = ctx;
+  header = (uv__arena_header_t*) ptr - 1;
+
+  if (header->size_class == UV__ARENA_LARGE) {
+    uv__free(header);
+    return;
+  }
+
+  assert(header->size_class < UV__ARENA_NCLASSES);
+  *(uv__arena_header_t**) ptr = arena->free_lists[header->size_class];
+  arena->free_lists[header->size_class] = header;
+}
+
+
+static void* uv__arena_realloc(void* ctx, void* ptr, size_t size) {
+  uv__arena_header_t* header;
+  size_t old_size;
+  void* newptr;
+
+  header = (uv__arena_header_t*) ptr - 1;
+
+  if (header->size_class == UV__ARENA_LARGE) {
+    if (uv__arena_size_class(size) == UV__ARENA_LARGE) {
+      header = uv__realloc(header, sizeof(*header) + size);
+      if (header == NULL)
+        return NULL;
+      return header + 1;
+    }
+    old_size = size;  /* The old block is bigger than any size class. */
+  } else {
+    old_size = uv__arena_block_size(header->size_class) - sizeof(*header);
+    if (size <= old_size)
+      return ptr;
+  }
+
+  newptr = uv__arena_malloc(ctx, size);
+  if (newptr == NULL)
+    return NULL;
+
+  memcpy(newptr, ptr, old_size < size ? old_size : size);
+  uv__arena_free(ctx, ptr);
+
+  return newptr;
+}
+
+
+static void uv__arena_close(void* ctx) {
+  uv__arena_slab_t* slab;
+  uv__arena_t* arena;
+
+  arena = ctx;
+
+  while (arena->slabs != NULL) {
+    slab = arena->slabs;
+    arena->slabs = slab->next;
+    uv__free(slab);
+  }
+
+  uv__free(arena);
+}
+
+
+int uv__arena_init(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  uv__arena_t* arena;
+  int err;
+
+  arena = uv__calloc(1, sizeof(*arena));
+  if (arena == NULL)
+    return UV_ENOMEM;
+
+  err = uv_loop_replace_allocator(loop,
+                                  arena,
+                                  uv__arena_malloc,
+                                  uv__arena_realloc,
+                                  uv__arena_free);
+  if (err) {
+    uv__free(arena);
+    return err;
+  }
+
+  lfields = uv__get_internal_fields(loop);
+  lfields->alloc.close_func = uv__arena_close;
+
+  return 0;
+}
@@ -0,0 +1,133 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Loop-local FIFO of deferred callbacks.
+ *
+ * The entries live in a ring that grows by doubling and is never shrunk, so
+ * once it's big enough uv_defer() doesn't allocate. The loop drains it after
+ * each callback it dispatches, see uv__defer_run().
+ */
+
+#include "uv-common.h"
+
+#include <string.h>
+
+#define UV__DEFER_MIN_SIZE 16
+
+struct uv__defer_s {
+  uv_defer_cb cb;
+  void* data;
+};
+
+
+static int uv__defer_grow(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__defer_s* ring;
+  unsigned int size;
+  unsigned int n;
+
+  lfields = uv__get_internal_fields(loop);
+  size = lfields->defer_size * 2;
+  if (size == 0)
+    size = UV__DEFER_MIN_SIZE;
+
+  if (size < lfields->defer_size)
+    return UV_ENOMEM;
+
+  ring = uv__loop_malloc(loop, UV_ALLOC_LOOP, size * sizeof(*ring));
+  if (ring == NULL)
+    return UV_ENOMEM;
+
+  /* Unwrap the old ring so the entries start at index 0. */
+  if (lfields->defer_count > 0) {
+    n = lfields->defer_size - lfields->defer_head;
+    if (n > lfields->defer_count)
+      n = lfields->defer_count;
+    memcpy(ring,
+           lfields->defer_ring + lfields->defer_head,
+           n * sizeof(*ring));
+    memcpy(ring + n,
+           lfields->defer_ring,
+           (lfields->defer_count - n) * sizeof(*ring));
+  }
+
+  uv__loop_free(loop, lfields->defer_ring);
+  lfields->defer_ring = ring;
+  lfields->defer_head = 0;
+  lfields->defer_size = size;
+
+  return 0;
+}
+
+
+int uv_defer(uv_loop_t* loop, uv_defer_cb cb, void* data) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__defer_s* e;
+  int err;
+
+  if (cb == NULL)
+    return UV_EINVAL;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->defer_count == lfields->defer_size) {
+    err = uv__defer_grow(loop);
+    if (err)
+      return err;
+  }
+
+  e = &lfields->defer_ring[(lfields->defer_head + lfields->defer_count) &
+                           (lfields->defer_size - 1)];
+  e->cb = cb;
+  e->data = data;
+  lfields->defer_count++;
+
+  return 0;
+}
+
+
+void uv__defer_drain(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__defer_s e;
+
+  lfields = uv__get_internal_fields(loop);
+
+  /* Callbacks deferred from here on run in the same drain. */
+  while (lfields->defer_count > 0) {
+    e = lfields->defer_ring[lfields->defer_head];
+    lfields->defer_head = (lfields->defer_head + 1) & (lfields->defer_size - 1);
+    lfields->defer_count--;
+
+    uv__loop_dispatch(loop, NULL, e.cb);
+    e.cb(e.data);
+  }
+}
+
+
+void uv__defer_loop_close(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  uv__loop_free(loop, lfields->defer_ring);
+  lfields->defer_ring = NULL;
+  lfields->defer_head = 0;
+  lfields->defer_count = 0;
+  lfields->defer_size = 0;
+}
@@ -0,0 +1,423 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Quiescent-state based reclamation for data shared between event loops.
+ *
+ * Every loop that is registered with an epoch domain owns a record with the
+ * last value of the domain's counter that it has observed. The loop refreshes
+ * that value each time it passes through the poll phase (a quiescent state:
+ * no callback is running so no reference to shared data can be held) and
+ * stores zero while it's blocked in the kernel or outside uv_run() (an
+ * extended quiescent state).
+ *
+ * A writer that retires an object bumps the counter. Once every online record
+ * has caught up with the new value, every reader that could have seen the old
+ * object has since passed through a quiescent state and the object can be
+ * reclaimed. Readers never write shared memory beyond their own record.
+ */
+
+#include "uv-common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#if !defined(_WIN32)
+# include "unix/internal.h"
+#endif
+
+#if defined(_WIN32)
+# define uv__epoch_barrier() MemoryBarrier()
+#else
+# define uv__epoch_barrier() __sync_synchronize()
+#endif
+
+#ifndef ACCESS_ONCE
+# define ACCESS_ONCE(type, var) (*(volatile type*) &(var))
+#endif
+
+#define UV__EPOCH_OFFLINE 0
+
+/* Wait this long between scans when a writer is blocked on a grace period.
+ * Readers don't signal writers because that would make them take a lock.
+ */
+#define UV__EPOCH_SCAN_INTERVAL 1000000  /* 1 ms in nanoseconds. */
+
+typedef struct {
+  QUEUE epoch_queue;  /* Guarded by epoch->mutex. */
+  QUEUE loop_queue;   /* Only touched from the loop's thread. */
+  uv_epoch_t* epoch;
+  uv_loop_t* loop;
+  unsigned int seen;
+} uv__epoch_record_t;
+
+typedef struct {
+  QUEUE queue;
+  uv_epoch_cb cb;
+  void* arg;
+  unsigned int target;
+} uv__epoch_deferred_t;
+
+
+/* Counter comparison that tolerates wrap-around. */
+static int uv__epoch_reached(unsigned int seen, unsigned int target) {
+  return (int) (seen - target) >= 0;
+}
+
+
+/* Must be called with epoch->mutex held. */
+static unsigned int uv__epoch_advance(uv_epoch_t* epoch) {
+  unsigned int counter;
+
+  /* Make retirements by the caller visible before readers can observe the
+   * new counter value.
+   */
+  uv__epoch_barrier();
+
+  counter = epoch->counter + 1;
+  if (counter == UV__EPOCH_OFFLINE)
+    counter++;
+
+  ACCESS_ONCE(unsigned int, epoch->counter) = counter;
+  uv__epoch_barrier();
+
+  return counter;
+}
+
+
+/* Returns the oldest counter value that all online loops have observed.
+ * Must be called with epoch->mutex held.
+ */
+static unsigned int uv__epoch_min_seen(uv_epoch_t* epoch) {
+  uv__epoch_record_t* r;
+  unsigned int min;
+  unsigned int seen;
+  QUEUE* q;
+
+  min = epoch->counter;
+
+  QUEUE_FOREACH(q, (QUEUE*) &epoch->loops) {
+    r = QUEUE_DATA(q, uv__epoch_record_t, epoch_queue);
+    seen = ACCESS_ONCE(unsigned int, r->seen);
+    if (seen != UV__EPOCH_OFFLINE && !uv__epoch_reached(seen, min))
+      min = seen;
+  }
+
+  return min;
+}
+
+
+/* Moves the callbacks whose grace period has elapsed to `done`.
+ * Must be called with epoch->mutex held.
+ */
+static void uv__epoch_collect(uv_epoch_t* epoch,
+                              unsigned int min,
+                              QUEUE* done) {
+  uv__epoch_deferred_t* d;
+  QUEUE* q;
+
+  uv__epoch_barrier();
+
+  while (!QUEUE_EMPTY((QUEUE*) &epoch->deferred)) {
+    q = QUEUE_HEAD((QUEUE*) &epoch->deferred);
+    d = QUEUE_DATA(q, uv__epoch_deferred_t, queue);
+
+    /* The list is sorted by target because targets are handed out under
+     * the mutex in increasing order.
+     */
+    if (!uv__epoch_reached(min, d->target))
+      break;
+
+    QUEUE_REMOVE(q);
+    QUEUE_INSERT_TAIL(done, q);
+    epoch->ndeferred--;
+  }
+}
+
+
+static void uv__epoch_run_deferred(QUEUE* done) {
+  uv__epoch_deferred_t* d;
+  QUEUE* q;
+
+  while (!QUEUE_EMPTY(done)) {
+    q = QUEUE_HEAD(done);
+    QUEUE_REMOVE(q);
+    d = QUEUE_DATA(q, uv__epoch_deferred_t, queue);
+    d->cb(d->arg);
+    uv__free(d);
+  }
+}
+
+
+static void uv__epoch_try_reclaim(uv_epoch_t* epoch) {
+  QUEUE done;
+
+  if (ACCESS_ONCE(unsigned int, epoch->ndeferred) == 0)
+    return;
+
+  /* Don't make a loop wait for a writer, another loop or the next quiescent
+   * state will pick up the work.
+   */
+  if (uv_mutex_trylock(&epoch->mutex))
+    return;
+
+  QUEUE_INIT(&done);
+  uv__epoch_collect(epoch, uv__epoch_min_seen(epoch), &done);
+  uv_mutex_unlock(&epoch->mutex);
+
+  uv__epoch_run_deferred(&done);
+}
+
+
+static uv__epoch_record_t* uv__epoch_find(uv_epoch_t* epoch,
+                                          uv_loop_t* loop) {
+  uv__epoch_record_t* r;
+  QUEUE* q;
+
+  QUEUE_FOREACH(q, &uv__get_internal_fields(loop)->epoch_records) {
+    r = QUEUE_DATA(q, uv__epoch_record_t, loop_queue);
+    if (r->epoch == epoch)
+      return r;
+  }
+
+  return NULL;
+}
+
+
+int uv_epoch_init(uv_epoch_t* epoch) {
+  int err;
+
+  err = uv_mutex_init(&epoch->mutex);
+  if (err)
+    return err;
+
+  err = uv_cond_init(&epoch->cond);
+  if (err) {
+    uv_mutex_destroy(&epoch->mutex);
+    return err;
+  }
+
+  QUEUE_INIT((QUEUE*) &epoch->loops);
+  QUEUE_INIT((QUEUE*) &epoch->deferred);
+  epoch->counter = UV__EPOCH_OFFLINE + 1;
+  epoch->ndeferred = 0;
+
+  return 0;
+}
+
+
+void uv_epoch_destroy(uv_epoch_t* epoch) {
+  QUEUE done;
+
+  assert(QUEUE_EMPTY((QUEUE*) &epoch->loops));
+
+  /* No loop can hold a reference anymore, everything is reclaimable. */
+  QUEUE_INIT(&done);
+  uv_mutex_lock(&epoch->mutex);
+  uv__epoch_collect(epoch, epoch->counter, &done);
+  uv_mutex_unlock(&epoch->mutex);
+  uv__epoch_run_deferred(&done);
+
+  assert(epoch->ndeferred == 0);
+  uv_cond_destroy(&epoch->cond);
+  uv_mutex_destroy(&epoch->mutex);
+}
+
+
+int uv_epoch_register(uv_epoch_t* epoch, uv_loop_t* loop) {
+  uv__epoch_record_t* r;
+
+  if (uv__epoch_find(epoch, loop) != NULL)
+    return UV_EEXIST;
+
+  r = uv__malloc(sizeof(*r));
+  if (r == NULL)
+    return UV_ENOMEM;
+
+  r->epoch = epoch;
+  r->loop = loop;
+
+  uv_mutex_lock(&epoch->mutex);
+  if (uv__get_internal_fields(loop)->epoch_online)
+    r->seen = epoch->counter;
+  else
+    r->seen = UV__EPOCH_OFFLINE;
+  QUEUE_INSERT_TAIL((QUEUE*) &epoch->loops, &r->epoch_queue);
+  uv_mutex_unlock(&epoch->mutex);
+
+  QUEUE_INSERT_TAIL(&uv__get_internal_fields(loop)->epoch_records,
+                    &r->loop_queue);
+
+  /* Reads that follow must not be satisfied before the record is visible. */
+  uv__epoch_barrier();
+
+  return 0;
+}
+
+
+int uv_epoch_unregister(uv_epoch_t* epoch, uv_loop_t* loop) {
+  uv__epoch_record_t* r;
+
+  r = uv__epoch_find(epoch, loop);
+  if (r == NULL)
+    return UV_ENOENT;
+
+  QUEUE_REMOVE(&r->loop_queue);
+
+  uv__epoch_barrier();
+  uv_mutex_lock(&epoch->mutex);
+  QUEUE_REMOVE(&r->epoch_queue);
+  uv_cond_broadcast(&epoch->cond);
+  uv_mutex_unlock(&epoch->mutex);
+
+  uv__free(r);
+
+  return 0;
+}
+
+
+void uv_epoch_quiescent(uv_loop_t* loop) {
+  /* Outside uv_run() the records are offline already, keep it that way. */
+  if (uv__get_internal_fields(loop)->epoch_online)
+    uv__epoch_online(loop);
+}
+
+
+void uv_epoch_synchronize(uv_epoch_t* epoch) {
+  unsigned int target;
+  QUEUE done;
+
+  QUEUE_INIT(&done);
+
+  uv_mutex_lock(&epoch->mutex);
+  target = uv__epoch_advance(epoch);
+
+  while (!uv__epoch_reached(uv__epoch_min_seen(epoch), target))
+    uv_cond_timedwait(&epoch->cond, &epoch->mutex, UV__EPOCH_SCAN_INTERVAL);
+
+  uv__epoch_collect(epoch, target, &done);
+  uv_mutex_unlock(&epoch->mutex);
+
+  uv__epoch_run_deferred(&done);
+}
+
+
+int uv_epoch_defer(uv_epoch_t* epoch, uv_epoch_cb cb, void* arg) {
+  uv__epoch_deferred_t* d;
+
+  if (cb == NULL)
+    return UV_EINVAL;
+
+  d = uv__malloc(sizeof(*d));
+  if (d == NULL)
+    return UV_ENOMEM;
+
+  d->cb = cb;
+  d->arg = arg;
+
+  uv_mutex_lock(&epoch->mutex);
+  d->target = uv__epoch_advance(epoch);
+  QUEUE_INSERT_TAIL((QUEUE*) &epoch->deferred, &d->queue);
+  ACCESS_ONCE(unsigned int, epoch->ndeferred) = epoch->ndeferred + 1;
+  uv_mutex_unlock(&epoch->mutex);
+
+  return 0;
+}
+
+
+void* uv_epoch_read(void* const* slot) {
+  /* Data dependency ordering covers the dereferences that follow on every
+   * architecture that libuv supports.
+   */
+  return *(void* const volatile*) slot;
+}
+
+
+void* uv_epoch_publish(void** slot, void* value) {
+  void* old;
+
+  /* Initialization of `value` must be visible before the pointer is. */
+  uv__epoch_barrier();
+  old = *(void* volatile*) slot;
+  *(void* volatile*) slot = value;
+  uv__epoch_barrier();
+
+  return old;
+}
+
+
+void uv__epoch_offline(uv_loop_t* loop) {
+  uv__epoch_record_t* r;
+  QUEUE* q;
+
+  uv__get_internal_fields(loop)->epoch_online = 0;
+
+  if (QUEUE_EMPTY(&uv__get_internal_fields(loop)->epoch_records))
+    return;
+
+  /* Reads done by callbacks must complete before we go offline. */
+  uv__epoch_barrier();
+
+  QUEUE_FOREACH(q, &uv__get_internal_fields(loop)->epoch_records) {
+    r = QUEUE_DATA(q, uv__epoch_record_t, loop_queue);
+    ACCESS_ONCE(unsigned int, r->seen) = UV__EPOCH_OFFLINE;
+  }
+}
+
+
+void uv__epoch_online(uv_loop_t* loop) {
+  uv__epoch_record_t* r;
+  QUEUE* q;
+
+  uv__get_internal_fields(loop)->epoch_online = 1;
+
+  if (QUEUE_EMPTY(&uv__get_internal_fields(loop)->epoch_records))
+    return;
+
+  uv__epoch_barrier();
+
+  QUEUE_FOREACH(q, &uv__get_internal_fields(loop)->epoch_records) {
+    r = QUEUE_DATA(q, uv__epoch_record_t, loop_queue);
+    ACCESS_ONCE(unsigned int, r->seen) =
+        ACCESS_ONCE(unsigned int, r->epoch->counter);
+  }
+
+  /* The store above must be globally visible before callbacks start reading
+   * shared data again, or a writer could free an object from under us.
+   */
+  uv__epoch_barrier();
+
+  QUEUE_FOREACH(q, &uv__get_internal_fields(loop)->epoch_records) {
+    r = QUEUE_DATA(q, uv__epoch_record_t, loop_queue);
+    uv__epoch_try_reclaim(r->epoch);
+  }
+}
+
+
+void uv__epoch_loop_close(uv_loop_t* loop) {
+  uv__epoch_record_t* r;
+  QUEUE* q;
+
+  while (!QUEUE_EMPTY(&uv__get_internal_fields(loop)->epoch_records)) {
+    q = QUEUE_HEAD(&uv__get_internal_fields(loop)->epoch_records);
+    r = QUEUE_DATA(q, uv__epoch_record_t, loop_queue);
+    uv_epoch_unregister(r->epoch, loop);
+  }
+}
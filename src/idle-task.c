@@ -0,0 +1,142 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Background callbacks that only run when the loop has nothing else to do.
+ *
+ * uv_run() hands the queue to uv__idle_tasks_run() once it has worked out
+ * that it's going to block for I/O. Each task gets a deadline: the next timer
+ * or the idle budget, whichever comes first. Tasks that don't fit in this idle
+ * period run in the next one, after a non-blocking poll so that I/O that came
+ * in meanwhile goes first. A queued task keeps the loop alive.
+ */
+
+#include "uv-common.h"
+
+#define UV__IDLE_TASK_BUDGET 50  /* Milliseconds. */
+
+
+int uv_idle_task_post(uv_loop_t* loop,
+                      uv_idle_task_t* task,
+                      uv_idle_task_cb cb) {
+  uv__loop_internal_fields_t* lfields;
+
+  if (cb == NULL)
+    return UV_EINVAL;
+
+  lfields = uv__get_internal_fields(loop);
+  task->loop = loop;
+  task->cb = cb;
+  QUEUE_INSERT_TAIL(&lfields->idle_tasks, (QUEUE*) &task->queue);
+  uv__req_register(loop, task);
+
+  return 0;
+}
+
+
+int uv_idle_task_cancel(uv_idle_task_t* task) {
+  if (task->loop == NULL)
+    return UV_EINVAL;
+
+  QUEUE_REMOVE((QUEUE*) &task->queue);
+  uv__req_unregister(task->loop, task);
+  task->loop = NULL;
+
+  return 0;
+}
+
+
+int uv__idle_task_budget(uv_loop_t* loop, unsigned int budget) {
+  if (budget == 0)
+    return UV_EINVAL;
+
+  uv__get_internal_fields(loop)->idle_task_budget = budget;
+  return 0;
+}
+
+
+/* Called by uv_run() instead of blocking for up to `timeout` milliseconds,
+ * -1 meaning forever. Returns the timeout to poll with afterwards.
+ */
+int uv__idle_tasks_run(uv_loop_t* loop, int timeout) {
+  uv__loop_internal_fields_t* lfields;
+  uv_idle_task_t* task;
+  uv_idle_task_cb cb;
+  unsigned int budget;
+  uint64_t deadline;
+  uint64_t elapsed;
+  uint64_t start;
+  QUEUE tasks;
+  QUEUE* q;
+  int next;
+
+  lfields = uv__get_internal_fields(loop);
+  budget = lfields->idle_task_budget;
+  if (budget == 0)
+    budget = UV__IDLE_TASK_BUDGET;
+
+  if (timeout != -1 && (unsigned int) timeout < budget)
+    budget = timeout;
+
+  start = uv_hrtime();
+  deadline = start + (uint64_t) budget * 1000000;
+
+  /* Tasks posted from here on wait for the next idle period. */
+  QUEUE_MOVE(&lfields->idle_tasks, &tasks);
+
+  while (!QUEUE_EMPTY(&tasks)) {
+    q = QUEUE_HEAD(&tasks);
+    QUEUE_REMOVE(q);
+    task = QUEUE_DATA(q, uv_idle_task_t, queue);
+    uv__req_unregister(loop, task);
+    cb = task->cb;
+    task->loop = NULL;
+
+    uv__loop_dispatch(loop, NULL, cb);
+    cb(task, deadline);
+
+    if (uv_hrtime() >= deadline)
+      break;
+  }
+
+  /* Put what's left in front of the tasks that were posted meanwhile. */
+  if (!QUEUE_EMPTY(&tasks)) {
+    if (!QUEUE_EMPTY(&lfields->idle_tasks))
+      QUEUE_ADD(&tasks, &lfields->idle_tasks);
+    QUEUE_MOVE(&tasks, &lfields->idle_tasks);
+  }
+
+  if (!QUEUE_EMPTY(&lfields->idle_tasks))
+    return 0;
+
+  /* The tasks may have started I/O or timers, but don't sleep past what's
+   * left of `timeout` either, uv_run_until() may have shortened it.
+   */
+  uv_update_time(loop);
+  next = uv_backend_timeout(loop);
+  if (timeout != -1) {
+    elapsed = (uv_hrtime() - start) / 1000000;
+    timeout = elapsed < (uint64_t) timeout ? timeout - (int) elapsed : 0;
+    if (next == -1 || next > timeout)
+      next = timeout;
+  }
+
+  return next;
+}
@@ -0,0 +1,357 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Thread-per-core runtime: a fixed set of event loops, each running on its
+ * own thread, optionally pinned to its own CPU.
+ *
+ * Other threads talk to a loop by posting callbacks to it. Posted callbacks
+ * sit in a mutex-protected queue and the loop is woken up with a uv_async_t.
+ * Every uv_async_send() happens with the mutex held so nobody can wake up a
+ * loop after it has seen the stop request and closed its async handle.
+ */
+
+#include "uv-common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#if !defined(_WIN32)
+# include "unix/internal.h"
+#endif
+
+typedef struct {
+  uv_loop_t loop;
+  uv_async_t async;
+  uv_thread_t thread;
+  uv_mutex_t mutex;
+  QUEUE posted;   /* Guarded by mutex. */
+  int stopping;   /* Guarded by mutex. */
+  int cpu;        /* CPU to pin the thread to or -1. */
+  int err;        /* Result of closing the loop. */
+} uv__loop_group_member_t;
+
+typedef struct {
+  QUEUE queue;
+  uv_loop_group_cb cb;
+  void* arg;
+} uv__loop_group_work_t;
+
+
+static void uv__loop_group_close_cb(uv_handle_t* handle, void* arg) {
+  if (!uv_is_closing(handle))
+    uv_close(handle, NULL);
+}
+
+
+static void uv__loop_group_async_cb(uv_async_t* handle) {
+  uv__loop_group_member_t* m;
+  uv__loop_group_work_t* w;
+  QUEUE queue;
+  QUEUE* q;
+  int stopping;
+
+  m = container_of(handle, uv__loop_group_member_t, async);
+
+  uv_mutex_lock(&m->mutex);
+  QUEUE_MOVE(&m->posted, &queue);
+  stopping = m->stopping;
+  uv_mutex_unlock(&m->mutex);
+
+  while (!QUEUE_EMPTY(&queue)) {
+    q = QUEUE_HEAD(&queue);
+    QUEUE_REMOVE(q);
+    w = QUEUE_DATA(q, uv__loop_group_work_t, queue);
+    w->cb(&m->loop, w->arg);
+    uv__free(w);
+  }
+
+  /* Callbacks posted before the stop request have all run by now. The loop
+   * keeps running until the handles that the user owns are closed too.
+   */
+  if (stopping)
+    uv_close((uv_handle_t*) &m->async, NULL);
+}
+
+
+static void uv__loop_group_thread(void* arg) {
+  uv__loop_group_member_t* m;
+
+  m = arg;
+
+  /* Pinning is best effort, the loop works fine on any CPU. */
+  if (m->cpu >= 0)
+    uv__thread_pin_self(m->cpu);
+
+  uv_run(&m->loop, UV_RUN_DEFAULT);
+
+  /* Close what's left: inactive handles the user didn't bother to close. */
+  uv_walk(&m->loop, uv__loop_group_close_cb, NULL);
+  uv_run(&m->loop, UV_RUN_DEFAULT);
+  m->err = uv_loop_close(&m->loop);
+}
+
+
+/* Fills `cpus` with the first `n` CPUs that this process may run on. Falls
+ * back to 0 .. n-1 when the topology is unknown.
+ */
+static void uv__loop_group_cpus(int* cpus, unsigned int n) {
+  uv_cpu_topology_t* topology;
+  unsigned int i;
+  int count;
+  int j;
+
+  for (i = 0; i < n; i++)
+    cpus[i] = i;
+
+  if (uv_cpu_topology(&topology, &count))
+    return;
+
+  i = 0;
+  for (j = 0; j < count && i < n; j++)
+    if (topology[j].allowed)
+      cpus[i++] = topology[j].cpu;
+
+  uv_free_cpu_topology(topology, count);
+}
+
+
+static unsigned int uv__loop_group_default_size(void) {
+  uv_cpu_topology_t* topology;
+  uv_cpu_info_t* cpu_infos;
+  unsigned int n;
+  int count;
+  int i;
+
+  n = 0;
+
+  if (uv_cpu_topology(&topology, &count) == 0) {
+    for (i = 0; i < count; i++)
+      n += topology[i].allowed != 0;
+    uv_free_cpu_topology(topology, count);
+  } else if (uv_cpu_info(&cpu_infos, &count) == 0) {
+    n = count;
+    uv_free_cpu_info(cpu_infos, count);
+  }
+
+  return n > 0 ? n : 1;
+}
+
+
+/* Waits for the threads of the first group->nmembers loops to exit. Returns
+ * the first error encountered.
+ */
+static int uv__loop_group_join_threads(uv_loop_group_t* group) {
+  uv__loop_group_member_t* m;
+  unsigned int i;
+  int err;
+  int rc;
+
+  rc = 0;
+
+  for (i = 0; i < group->nmembers; i++) {
+    m = (uv__loop_group_member_t*) group->members + i;
+
+    err = uv_thread_join(&m->thread);
+    if (err == 0)
+      err = m->err;
+    if (rc == 0)
+      rc = err;
+
+    assert(QUEUE_EMPTY(&m->posted));
+    uv_mutex_destroy(&m->mutex);
+  }
+
+  return rc;
+}
+
+
+int uv_loop_group_init(uv_loop_group_t* group,
+                       unsigned int nloops,
+                       unsigned int flags) {
+  uv__loop_group_member_t* members;
+  uv__loop_group_member_t* m;
+  unsigned int i;
+  int* cpus;
+  int err;
+
+  if (flags & ~UV_LOOP_GROUP_PIN)
+    return UV_EINVAL;
+
+  if (nloops == 0)
+    nloops = uv__loop_group_default_size();
+
+  members = uv__calloc(nloops, sizeof(*members));
+  if (members == NULL)
+    return UV_ENOMEM;
+
+  cpus = uv__malloc(nloops * sizeof(*cpus));
+  if (cpus == NULL) {
+    uv__free(members);
+    return UV_ENOMEM;
+  }
+
+  uv__loop_group_cpus(cpus, nloops);
+
+  group->members = members;
+  group->nmembers = 0;
+
+  /* Set up every loop before starting any thread so that a failure doesn't
+   * leave threads behind that need to be stopped.
+   */
+  for (i = 0; i < nloops; i++) {
+    m = members + i;
+    m->cpu = (flags & UV_LOOP_GROUP_PIN) ? cpus[i] : -1;
+    QUEUE_INIT(&m->posted);
+
+    err = uv_loop_init(&m->loop);
+    if (err)
+      goto fail;
+
+    err = uv_mutex_init(&m->mutex);
+    if (err) {
+      uv_loop_close(&m->loop);
+      goto fail;
+    }
+
+    err = uv_async_init(&m->loop, &m->async, uv__loop_group_async_cb);
+    if (err) {
+      uv_mutex_destroy(&m->mutex);
+      uv_loop_close(&m->loop);
+      goto fail;
+    }
+
+    group->nmembers++;
+  }
+
+  uv__free(cpus);
+
+  for (i = 0; i < nloops; i++) {
+    m = members + i;
+    err = uv_thread_create(&m->thread, uv__loop_group_thread, m);
+    if (err)
+      break;
+  }
+
+  if (i == nloops)
+    return 0;
+
+  /* Stop the threads that did start and throw away the other loops. */
+  group->nmembers = i;
+  uv_loop_group_stop(group);
+  uv__loop_group_join_threads(group);
+  group->nmembers = nloops;
+
+  while (group->nmembers > i) {
+    m = members + --group->nmembers;
+    uv_close((uv_handle_t*) &m->async, NULL);
+    uv_run(&m->loop, UV_RUN_DEFAULT);
+    uv_loop_close(&m->loop);
+    uv_mutex_destroy(&m->mutex);
+  }
+
+  uv__free(members);
+  group->members = NULL;
+  group->nmembers = 0;
+  return err;
+
+fail:
+  uv__free(cpus);
+
+  while (group->nmembers > 0) {
+    m = members + --group->nmembers;
+    uv_close((uv_handle_t*) &m->async, NULL);
+    uv_run(&m->loop, UV_RUN_DEFAULT);
+    uv_loop_close(&m->loop);
+    uv_mutex_destroy(&m->mutex);
+  }
+
+  uv__free(members);
+  group->members = NULL;
+  return err;
+}
+
+
+unsigned int uv_loop_group_size(const uv_loop_group_t* group) {
+  return group->nmembers;
+}
+
+
+int uv_loop_group_post(uv_loop_group_t* group,
+                       unsigned int index,
+                       uv_loop_group_cb cb,
+                       void* arg) {
+  uv__loop_group_member_t* m;
+  uv__loop_group_work_t* w;
+
+  if (index >= group->nmembers || cb == NULL)
+    return UV_EINVAL;
+
+  w = uv__malloc(sizeof(*w));
+  if (w == NULL)
+    return UV_ENOMEM;
+
+  w->cb = cb;
+  w->arg = arg;
+
+  m = (uv__loop_group_member_t*) group->members + index;
+  uv_mutex_lock(&m->mutex);
+
+  if (m->stopping) {
+    uv_mutex_unlock(&m->mutex);
+    uv__free(w);
+    return UV_ECANCELED;
+  }
+
+  QUEUE_INSERT_TAIL(&m->posted, &w->queue);
+  uv_async_send(&m->async);
+  uv_mutex_unlock(&m->mutex);
+
+  return 0;
+}
+
+
+void uv_loop_group_stop(uv_loop_group_t* group) {
+  uv__loop_group_member_t* m;
+  unsigned int i;
+
+  for (i = 0; i < group->nmembers; i++) {
+    m = (uv__loop_group_member_t*) group->members + i;
+    uv_mutex_lock(&m->mutex);
+    if (!m->stopping) {
+      m->stopping = 1;
+      uv_async_send(&m->async);
+    }
+    uv_mutex_unlock(&m->mutex);
+  }
+}
+
+
+int uv_loop_group_join(uv_loop_group_t* group) {
+  int err;
+
+  err = uv__loop_group_join_threads(group);
+
+  uv__free(group->members);
+  group->members = NULL;
+  group->nmembers = 0;
+
+  return err;
+}
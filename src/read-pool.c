@@ -0,0 +1,265 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Loop-owned pool of read buffers.
+ *
+ * uv_read_start_pooled() and uv_udp_recv_start_pooled() install an alloc_cb
+ * that draws fixed-size blocks from the loop's pool instead of asking the
+ * application. The blocks are carved out of large slabs, which can be backed
+ * by huge pages, and come back through a free list when the application
+ * releases them, so neither busy nor idle connections go through malloc()
+ * once the pool has grown to the peak number of buffers in use. The pool is
+ * only touched from the loop's thread and the slabs are released when the
+ * loop is closed.
+ */
+
+#include "uv-common.h"
+
+#include <assert.h>
+#include <limits.h>  /* UINT_MAX */
+
+#if defined(__linux__)
+# include <sys/mman.h>
+#endif
+
+#define UV__READ_POOL_BLOCK_SIZE (64 * 1024)
+#define UV__READ_POOL_SLAB_BLOCKS 16
+#define UV__READ_POOL_ALIGN 64
+#define UV__READ_POOL_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+typedef struct uv__read_slab_s uv__read_slab_t;
+
+struct uv__read_slab_s {
+  uv__read_slab_t* next;
+  void* base;
+  size_t size;
+  int mapped;  /* mmap()ed rather than malloc()ed. */
+};
+
+struct uv__read_pool_s {
+  size_t block_size;
+  unsigned int flags;
+  void* free_list;  /* Released blocks, linked through their first word. */
+  char* slab_pos;
+  char* slab_end;
+  uv__read_slab_t* slabs;
+};
+
+
+static uv__read_pool_t* uv__read_pool(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  uv__read_pool_t* pool;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->read_pool != NULL)
+    return lfields->read_pool;
+
+  pool = uv__calloc(1, sizeof(*pool));
+  if (pool == NULL)
+    return NULL;
+
+  pool->block_size = UV__READ_POOL_BLOCK_SIZE;
+  lfields->read_pool = pool;
+
+  return pool;
+}
+
+
+/* Takes the block size as a size_t and UV_READ_POOL_* flags. */
+int uv__read_pool_configure(uv_loop_t* loop, va_list ap) {
+  uv__read_pool_t* pool;
+  unsigned int flags;
+  size_t block_size;
+
+  block_size = va_arg(ap, size_t);
+  flags = va_arg(ap, unsigned int);
+
+  if (block_size == 0 || block_size > UINT_MAX)
+    return UV_EINVAL;
+
+  if (flags & ~UV_READ_POOL_HUGEPAGES)
+    return UV_EINVAL;
+
+  pool = uv__read_pool(loop);
+  if (pool == NULL)
+    return UV_ENOMEM;
+
+  /* The blocks that are already carved have the old size. */
+  if (pool->slabs != NULL)
+    return UV_EBUSY;
+
+  pool->block_size = (block_size + UV__READ_POOL_ALIGN - 1) &
+                     ~(size_t) (UV__READ_POOL_ALIGN - 1);
+  pool->flags = flags;
+
+  return 0;
+}
+
+
+static int uv__read_pool_grow(uv__read_pool_t* pool) {
+  uv__read_slab_t* slab;
+  size_t size;
+
+  slab = uv__malloc(sizeof(*slab));
+  if (slab == NULL)
+    return UV_ENOMEM;
+
+  size = pool->block_size * UV__READ_POOL_SLAB_BLOCKS;
+  slab->base = NULL;
+  slab->mapped = 0;
+
+#if defined(__linux__)
+  if (pool->flags & UV_READ_POOL_HUGEPAGES) {
+    size = (size + UV__READ_POOL_HUGEPAGE_SIZE - 1) &
+           ~(size_t) (UV__READ_POOL_HUGEPAGE_SIZE - 1);
+
+# if defined(MAP_HUGETLB)
+    /* Reserved huge pages first, transparent huge pages otherwise. */
+    slab->base = mmap(NULL,
+                      size,
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                      -1,
+                      0);
+# endif /* defined(MAP_HUGETLB) */
+
+    if (slab->base == NULL || slab->base == MAP_FAILED) {
+      slab->base = mmap(NULL,
+                        size,
+                        PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS,
+                        -1,
+                        0);
+# if defined(MADV_HUGEPAGE)
+      if (slab->base != MAP_FAILED)
+        madvise(slab->base, size, MADV_HUGEPAGE);
+# endif /* defined(MADV_HUGEPAGE) */
+    }
+
+    if (slab->base == MAP_FAILED)
+      slab->base = NULL;
+    else
+      slab->mapped = 1;
+  }
+#endif /* defined(__linux__) */
+
+  if (slab->base == NULL)
+    slab->base = uv__malloc(size);
+
+  if (slab->base == NULL) {
+    uv__free(slab);
+    return UV_ENOMEM;
+  }
+
+  /* The tail of the previous slab is wasted, less than a block. */
+  slab->size = size;
+  slab->next = pool->slabs;
+  pool->slabs = slab;
+  pool->slab_pos = slab->base;
+  pool->slab_end = pool->slab_pos + size;
+
+  return 0;
+}
+
+
+static void uv__read_pool_alloc(uv_handle_t* handle,
+                                size_t suggested_size,
+                                uv_buf_t* buf) {
+  uv__read_pool_t* pool;
+  char* block;
+
+  *buf = uv_buf_init(NULL, 0);
+
+  pool = uv__read_pool(handle->loop);
+  if (pool == NULL)
+    return;
+
+  if (pool->free_list != NULL) {
+    block = pool->free_list;
+    pool->free_list = *(void**) block;
+  } else {
+    if ((size_t) (pool->slab_end - pool->slab_pos) < pool->block_size)
+      if (uv__read_pool_grow(pool))
+        return;
+
+    block = pool->slab_pos;
+    pool->slab_pos += pool->block_size;
+  }
+
+  *buf = uv_buf_init(block, pool->block_size);
+}
+
+
+void uv_read_pool_release(uv_loop_t* loop, const uv_buf_t* buf) {
+  uv__read_pool_t* pool;
+
+  if (buf->base == NULL)
+    return;
+
+  pool = uv__get_internal_fields(loop)->read_pool;
+  assert(pool != NULL);
+
+  *(void**) buf->base = pool->free_list;
+  pool->free_list = buf->base;
+}
+
+
+int uv_read_start_pooled(uv_stream_t* stream, uv_read_cb read_cb) {
+  return uv_read_start(stream, uv__read_pool_alloc, read_cb);
+}
+
+
+/* Whether `stream` is reading into buffers from its loop's pool. */
+int uv__read_pool_reading(const uv_stream_t* stream) {
+  return stream->alloc_cb == uv__read_pool_alloc;
+}
+
+
+int uv_udp_recv_start_pooled(uv_udp_t* handle, uv_udp_recv_cb recv_cb) {
+  return uv_udp_recv_start(handle, uv__read_pool_alloc, recv_cb);
+}
+
+
+void uv__read_pool_loop_close(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  uv__read_pool_t* pool;
+  uv__read_slab_t* slab;
+
+  lfields = uv__get_internal_fields(loop);
+  pool = lfields->read_pool;
+  if (pool == NULL)
+    return;
+
+  while (pool->slabs != NULL) {
+    slab = pool->slabs;
+    pool->slabs = slab->next;
+#if defined(__linux__)
+    if (slab->mapped)
+      munmap(slab->base, slab->size);
+    else
+#endif /* defined(__linux__) */
+      uv__free(slab->base);
+    uv__free(slab);
+  }
+
+  uv__free(pool);
+  lfields->read_pool = NULL;
+}
@@ -35,6 +35,7 @@ static uv_mutex_t mutex;
 static unsigned int idle_threads;
 static unsigned int slow_io_work_running;
 static unsigned int nthreads;
+static unsigned int nworkers;  /* Numbers the threads for the trace recorder. */
 static uv_thread_t* threads;
 static uv_thread_t default_threads[4];
 static QUEUE exit_message;
@@ -57,12 +58,15 @@ static void uv__cancelled(struct uv__work* w) {
 static void worker(void* arg) {
   struct uv__work* w;
   QUEUE* q;
+  uint64_t start;
+  unsigned int id;
   int is_slow_work;
 
   uv_sem_post((uv_sem_t*) arg);
   arg = NULL;
 
   uv_mutex_lock(&mutex);
+  id = nworkers++;
   for (;;) {
     /* `mutex` should always be locked at this point. */
 
@@ -119,8 +123,20 @@ static void worker(void* arg) {
     uv_mutex_unlock(&mutex);
 
     w = QUEUE_DATA(q, struct uv__work, wq);
+    UV__PROBE2(work__dequeue, w, id);
+
+    /* Pairs with the release fence in uv_loop_trace_start(). */
+    start = 0;
+    if (uv__atomic_load(int, uv__get_internal_fields(w->loop)->tracing)) {
+      uv__atomic_fence_acquire();
+      start = uv_hrtime();
+    }
+
     w->work(w);
 
+    if (start != 0)
+      uv__trace_work(w, start, id);
+
     uv_mutex_lock(&w->loop->wq_mutex);
     w->work = NULL;  /* Signal uv_cancel() that the work req is done
                         executing. */
@@ -190,6 +206,7 @@ static void init_threads(void) {
   const char* val;
   uv_sem_t sem;
 
+  nworkers = 0;
   nthreads = ARRAY_SIZE(default_threads);
   val = getenv("UV_THREADPOOL_SIZE");
   if (val != NULL)
@@ -262,10 +279,29 @@ void uv__work_submit(uv_loop_t* loop,
   w->loop = loop;
   w->work = work;
   w->done = done;
+  if (uv__get_internal_fields(loop)->tracing)
+    uv__trace_work_submit(w, kind);
+  UV__PROBE2(work__enqueue, w, kind);
   post(&w->wq, kind);
 }
 
 
+/* Queue `done` to run on `loop` as if `w` had finished on the threadpool.
+ * Safe to call from any thread.
+ */
+void uv__work_post_done(uv_loop_t* loop,
+                        struct uv__work* w,
+                        void (*done)(struct uv__work* w, int status)) {
+  w->loop = loop;
+  w->work = NULL;
+  w->done = done;
+  uv_mutex_lock(&loop->wq_mutex);
+  QUEUE_INSERT_TAIL(&loop->wq, &w->wq);
+  uv_async_send(&loop->wq_async);
+  uv_mutex_unlock(&loop->wq_mutex);
+}
+
+
 static int uv__work_cancel(uv_loop_t* loop, uv_req_t* req, struct uv__work* w) {
   int cancelled;
 
@@ -310,6 +346,8 @@ void uv__work_done(uv_async_t* handle) {
 
     w = container_of(q, struct uv__work, wq);
     err = (w->work == uv__cancelled) ? UV_ECANCELED : 0;
+    UV__PROBE2(work__done, w, err);
+    uv__loop_dispatch(loop, NULL, w->done);
     w->done(w, err);
   }
 }
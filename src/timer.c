@@ -171,7 +171,10 @@ void uv__run_timers(uv_loop_t* loop) {
 
     uv_timer_stop(handle);
     uv_timer_again(handle);
+    UV__PROBE1(timer__fire, handle);
+    uv__loop_dispatch(loop, handle, handle->timer_cb);
     handle->timer_cb(handle);
+    uv__defer_run(loop);
   }
 }
 
@@ -0,0 +1,608 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Event trace recorder.
+ *
+ * The loop thread appends to a ring of its own without locking: loop phases
+ * and callback dispatches, both as complete events, threadpool submissions
+ * and per-iteration syscall counts. Threadpool threads append to a second
+ * ring under a mutex. uv_loop_trace_dump() writes both out in the Chrome
+ * trace event format, which Perfetto reads too.
+ */
+
+#include "uv-common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  UV__TRACE_EVENT_PHASE,
+  UV__TRACE_EVENT_DISPATCH,
+  UV__TRACE_EVENT_SUBMIT,
+  UV__TRACE_EVENT_WORK,
+  UV__TRACE_EVENT_SYSCALLS
+};
+
+typedef struct {
+  uint64_t start;
+  uint64_t end;
+  union {
+    struct {
+      uintptr_t ptr;  /* Handle or threadpool work. */
+      uintptr_t cb;
+    } obj;
+    unsigned int counts[UV__TRACE_SYSCALL_MAX];
+  } u;
+  unsigned char type;
+  unsigned char arg;  /* Phase, handle type or work kind. */
+  unsigned short worker;
+} uv__trace_event_t;
+
+typedef struct {
+  uv__trace_event_t* events;
+  size_t size;
+  uint64_t count;  /* Events ever recorded, the ring holds the newest. */
+} uv__trace_ring_t;
+
+struct uv__trace_s {
+  uv__trace_ring_t ring;  /* Loop thread only. */
+  uv__trace_ring_t work;  /* Guarded by mutex. */
+  uv_mutex_t mutex;
+  uint64_t phase_start;
+  int phase;
+  uint64_t dispatch_start;  /* 0 if no dispatch is open. */
+  uv_handle_t* dispatch_handle;
+  int dispatch_type;
+  unsigned int counts[UV__TRACE_SYSCALL_MAX];
+};
+
+static const char* uv__trace_phase_names[UV__LOOP_PHASE_MAX] = {
+  "none",
+  "timers",
+  "pending",
+  "idle",
+  "prepare",
+  "poll",
+  "check",
+  "closing"
+};
+
+static const char* uv__trace_syscall_names[UV__TRACE_SYSCALL_MAX] = {
+  "poll",
+  "read",
+  "write",
+  "accept",
+  "recv",
+  "send"
+};
+
+
+static uv__trace_event_t* uv__trace_append(uv__trace_ring_t* ring) {
+  return &ring->events[ring->count++ % ring->size];
+}
+
+
+static void uv__trace_flush_counts(struct uv__trace_s* t, uint64_t now) {
+  uv__trace_event_t* e;
+  unsigned int i;
+
+  for (i = 0; i < UV__TRACE_SYSCALL_MAX; i++)
+    if (t->counts[i] != 0)
+      break;
+
+  if (i == UV__TRACE_SYSCALL_MAX)
+    return;
+
+  e = uv__trace_append(&t->ring);
+  e->type = UV__TRACE_EVENT_SYSCALLS;
+  e->start = now;
+  e->end = now;
+  memcpy(e->u.counts, t->counts, sizeof(e->u.counts));
+  memset(t->counts, 0, sizeof(t->counts));
+}
+
+
+static void uv__trace_close_dispatch(uv_loop_t* loop,
+                                     struct uv__trace_s* t,
+                                     uint64_t now) {
+  uv__trace_event_t* e;
+
+  if (t->dispatch_start == 0)
+    return;
+
+  e = uv__trace_append(&t->ring);
+  e->type = UV__TRACE_EVENT_DISPATCH;
+  e->arg = t->dispatch_type;
+  e->start = t->dispatch_start;
+  e->end = now;
+  e->u.obj.ptr = (uintptr_t) t->dispatch_handle;
+  e->u.obj.cb = (uintptr_t) uv__get_internal_fields(loop)->watch_cb;
+  t->dispatch_start = 0;
+}
+
+
+void uv__trace_phase(uv_loop_t* loop, int phase) {
+  struct uv__trace_s* t;
+  uv__trace_event_t* e;
+  uint64_t now;
+
+  t = uv__get_internal_fields(loop)->trace;
+  now = uv_hrtime();
+  uv__trace_close_dispatch(loop, t, now);
+
+  if (t->phase != UV__LOOP_PHASE_NONE) {
+    e = uv__trace_append(&t->ring);
+    e->type = UV__TRACE_EVENT_PHASE;
+    e->arg = t->phase;
+    e->start = t->phase_start;
+    e->end = now;
+  }
+
+  /* A new iteration starts or uv_run() returns. */
+  if (phase == UV__LOOP_PHASE_TIMERS || phase == UV__LOOP_PHASE_NONE)
+    uv__trace_flush_counts(t, now);
+
+  t->phase = phase;
+  t->phase_start = now;
+}
+
+
+void uv__trace_dispatch(uv_loop_t* loop, uv_handle_t* handle) {
+  struct uv__trace_s* t;
+  uint64_t now;
+
+  t = uv__get_internal_fields(loop)->trace;
+  now = uv_hrtime();
+  uv__trace_close_dispatch(loop, t, now);
+  t->dispatch_start = now;
+  uv__trace_handle(loop, handle);
+}
+
+
+void uv__trace_handle(uv_loop_t* loop, uv_handle_t* handle) {
+  struct uv__trace_s* t;
+
+  /* Look at the type now, a close callback may free the handle. */
+  t = uv__get_internal_fields(loop)->trace;
+  t->dispatch_handle = handle;
+  t->dispatch_type = handle != NULL ? handle->type : UV_UNKNOWN_HANDLE;
+}
+
+
+void uv__trace_count(uv_loop_t* loop, int what) {
+  uv__get_internal_fields(loop)->trace->counts[what]++;
+}
+
+
+void uv__trace_work_submit(struct uv__work* w, int kind) {
+  struct uv__trace_s* t;
+  uv__trace_event_t* e;
+
+  t = uv__get_internal_fields(w->loop)->trace;
+  e = uv__trace_append(&t->ring);
+  e->type = UV__TRACE_EVENT_SUBMIT;
+  e->arg = kind;
+  e->start = uv_hrtime();
+  e->end = e->start;
+  e->u.obj.ptr = (uintptr_t) w;
+  e->u.obj.cb = (uintptr_t) w->work;
+}
+
+
+/* Called on a threadpool thread once `w` has run. */
+void uv__trace_work(struct uv__work* w, uint64_t start, unsigned int worker) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__trace_s* t;
+  uv__trace_event_t* e;
+  uint64_t end;
+
+  end = uv_hrtime();
+  lfields = uv__get_internal_fields(w->loop);
+  t = uv__atomic_load(struct uv__trace_s*, lfields->trace);
+  uv__atomic_fence_acquire();
+  if (t == NULL)
+    return;
+
+  uv_mutex_lock(&t->mutex);
+  if (t->work.events != NULL) {
+    e = uv__trace_append(&t->work);
+    e->type = UV__TRACE_EVENT_WORK;
+    e->arg = 0;
+    e->worker = worker;
+    e->start = start;
+    e->end = end;
+    e->u.obj.ptr = (uintptr_t) w;
+    e->u.obj.cb = 0;
+  }
+  uv_mutex_unlock(&t->mutex);
+}
+
+
+int uv_loop_trace_start(uv_loop_t* loop, size_t capacity) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__trace_s* t;
+  uv__trace_event_t* events;
+  uv__trace_event_t* work;
+
+  lfields = uv__get_internal_fields(loop);
+
+  if (capacity == 0 || capacity > (size_t) -1 / sizeof(uv__trace_event_t))
+    return UV_EINVAL;
+
+  if (lfields->tracing)
+    return UV_EBUSY;
+
+  t = lfields->trace;
+  if (t == NULL) {
+    t = uv__calloc(1, sizeof(*t));
+    if (t == NULL)
+      return UV_ENOMEM;
+
+    if (uv_mutex_init(&t->mutex)) {
+      uv__free(t);
+      return UV_ENOMEM;
+    }
+
+    uv__atomic_fence_release();
+    uv__atomic_store(struct uv__trace_s*, lfields->trace, t);
+  }
+
+  events = uv__malloc(capacity * sizeof(*events));
+  work = uv__malloc(capacity * sizeof(*work));
+  if (events == NULL || work == NULL) {
+    uv__free(events);
+    uv__free(work);
+    return UV_ENOMEM;
+  }
+
+  uv__free(t->ring.events);
+  t->ring.events = events;
+  t->ring.size = capacity;
+  t->ring.count = 0;
+
+  uv_mutex_lock(&t->mutex);
+  uv__free(t->work.events);
+  t->work.events = work;
+  t->work.size = capacity;
+  t->work.count = 0;
+  uv_mutex_unlock(&t->mutex);
+
+  t->phase = UV__LOOP_PHASE_NONE;
+  t->dispatch_start = 0;
+  memset(t->counts, 0, sizeof(t->counts));
+  uv__atomic_fence_release();
+  uv__atomic_store(int, lfields->tracing, 1);
+
+  return 0;
+}
+
+
+int uv_loop_trace_stop(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  if (!lfields->tracing)
+    return 0;
+
+  /* Finish the phase and callback we're in, if called from a callback. */
+  uv__trace_phase(loop, UV__LOOP_PHASE_NONE);
+  uv__atomic_store(int, lfields->tracing, 0);
+
+  return 0;
+}
+
+
+static void uv__trace_ts(FILE* stream, const char* key, uint64_t ns) {
+  fprintf(stream,
+          ",\"%s\":%llu.%03u",
+          key,
+          (unsigned long long) (ns / 1000),
+          (unsigned int) (ns % 1000));
+}
+
+
+static const char* uv__trace_type_name(int type) {
+  switch (type) {
+#define X(uc, lc) case UV_##uc: return #lc;
+    UV_HANDLE_TYPE_MAP(X)
+#undef X
+    default: return "callback";
+  }
+}
+
+
+static const char* uv__trace_kind_name(int kind) {
+  switch (kind) {
+    case UV__WORK_FAST_IO: return "fs";
+    case UV__WORK_SLOW_IO: return "dns";
+    default: return "work";
+  }
+}
+
+
+static int uv__trace_submit_cmp(const void* a, const void* b) {
+  const uv__trace_event_t* x;
+  const uv__trace_event_t* y;
+
+  x = *(const uv__trace_event_t* const*) a;
+  y = *(const uv__trace_event_t* const*) b;
+
+  if (x->u.obj.ptr != y->u.obj.ptr)
+    return x->u.obj.ptr < y->u.obj.ptr ? -1 : 1;
+
+  return (x->start > y->start) - (x->start < y->start);
+}
+
+
+static int uv__trace_worker_cmp(const void* a, const void* b) {
+  const uv__trace_event_t* x;
+  const uv__trace_event_t* y;
+
+  x = a;
+  y = b;
+  return (x->worker > y->worker) - (x->worker < y->worker);
+}
+
+
+/* Finds the submission that `work` ran for: the last one of the same request
+ * that happened before it started. `submits` is sorted by request and time.
+ */
+static const uv__trace_event_t* uv__trace_find_submit(
+    uv__trace_event_t** submits,
+    size_t nsubmits,
+    const uv__trace_event_t* work) {
+  const uv__trace_event_t* found;
+  size_t lo;
+  size_t hi;
+  size_t mid;
+
+  found = NULL;
+  lo = 0;
+  hi = nsubmits;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (submits[mid]->u.obj.ptr < work->u.obj.ptr ||
+        (submits[mid]->u.obj.ptr == work->u.obj.ptr &&
+         submits[mid]->start <= work->start)) {
+      if (submits[mid]->u.obj.ptr == work->u.obj.ptr)
+        found = submits[mid];
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return found;
+}
+
+
+static void uv__trace_dump_event(FILE* stream,
+                                 const uv__trace_event_t* e,
+                                 const uv__trace_event_t* submit,
+                                 int pid,
+                                 int* first) {
+  unsigned int i;
+
+  fputs(*first ? "\n" : ",\n", stream);
+  *first = 0;
+
+  switch (e->type) {
+    case UV__TRACE_EVENT_PHASE:
+      fprintf(stream,
+              "{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\"",
+              uv__trace_phase_names[e->arg]);
+      break;
+
+    case UV__TRACE_EVENT_DISPATCH:
+      fprintf(stream,
+              "{\"name\":\"%s\",\"cat\":\"callback\",\"ph\":\"X\"",
+              uv__trace_type_name(e->arg));
+      break;
+
+    case UV__TRACE_EVENT_SUBMIT:
+      fprintf(stream,
+              "{\"name\":\"%s\",\"cat\":\"threadpool\",\"ph\":\"i\","
+              "\"s\":\"t\"",
+              uv__trace_kind_name(e->arg));
+      break;
+
+    case UV__TRACE_EVENT_WORK:
+      fprintf(stream,
+              "{\"name\":\"%s\",\"cat\":\"threadpool\",\"ph\":\"X\"",
+              submit != NULL ? uv__trace_kind_name(submit->arg) : "work");
+      break;
+
+    case UV__TRACE_EVENT_SYSCALLS:
+      fputs("{\"name\":\"syscalls\",\"cat\":\"syscalls\",\"ph\":\"C\"",
+            stream);
+      break;
+  }
+
+  uv__trace_ts(stream, "ts", e->start);
+  if (e->type == UV__TRACE_EVENT_PHASE ||
+      e->type == UV__TRACE_EVENT_DISPATCH ||
+      e->type == UV__TRACE_EVENT_WORK) {
+    uv__trace_ts(stream, "dur", e->end - e->start);
+  }
+
+  fprintf(stream,
+          ",\"pid\":%d,\"tid\":%u,\"args\":{",
+          pid,
+          e->type == UV__TRACE_EVENT_WORK ? 1u + e->worker : 0u);
+
+  switch (e->type) {
+    case UV__TRACE_EVENT_DISPATCH:
+      fprintf(stream,
+              "\"handle\":\"0x%llx\",\"cb\":\"0x%llx\"",
+              (unsigned long long) e->u.obj.ptr,
+              (unsigned long long) e->u.obj.cb);
+      break;
+
+    case UV__TRACE_EVENT_SUBMIT:
+      fprintf(stream, "\"req\":\"0x%llx\"", (unsigned long long) e->u.obj.ptr);
+      break;
+
+    case UV__TRACE_EVENT_WORK:
+      fprintf(stream, "\"req\":\"0x%llx\"", (unsigned long long) e->u.obj.ptr);
+      if (submit != NULL)
+        uv__trace_ts(stream, "queued_us", e->start - submit->start);
+      break;
+
+    case UV__TRACE_EVENT_SYSCALLS:
+      for (i = 0; i < UV__TRACE_SYSCALL_MAX; i++) {
+        fprintf(stream,
+                "%s\"%s\":%u",
+                i == 0 ? "" : ",",
+                uv__trace_syscall_names[i],
+                e->u.counts[i]);
+      }
+      break;
+  }
+
+  fputs("}}", stream);
+}
+
+
+/* Returns the index of the oldest event in the ring and how many there are. */
+static size_t uv__trace_ring_span(const uv__trace_ring_t* ring, size_t* n) {
+  if (ring->count <= ring->size) {
+    *n = (size_t) ring->count;
+    return 0;
+  }
+
+  *n = ring->size;
+  return (size_t) (ring->count % ring->size);
+}
+
+
+int uv_loop_trace_dump(uv_loop_t* loop, FILE* stream) {
+  struct uv__trace_s* t;
+  uv__trace_event_t** submits;
+  uv__trace_event_t* work;
+  uv__trace_event_t* e;
+  size_t nsubmits;
+  size_t nwork;
+  size_t first;
+  size_t n;
+  size_t i;
+  int first_event;
+  int pid;
+
+  t = uv__get_internal_fields(loop)->trace;
+  if (t == NULL || t->ring.events == NULL)
+    return UV_EINVAL;
+
+  /* Snapshot the threadpool ring so the lock isn't held while writing. */
+  uv_mutex_lock(&t->mutex);
+  first = uv__trace_ring_span(&t->work, &nwork);
+  work = uv__malloc((nwork + 1) * sizeof(*work));
+  if (work != NULL)
+    for (i = 0; i < nwork; i++)
+      work[i] = t->work.events[(first + i) % t->work.size];
+  uv_mutex_unlock(&t->mutex);
+
+  if (work == NULL)
+    return UV_ENOMEM;
+
+  first = uv__trace_ring_span(&t->ring, &n);
+
+  submits = uv__malloc((n + 1) * sizeof(*submits));
+  if (submits == NULL) {
+    uv__free(work);
+    return UV_ENOMEM;
+  }
+
+  nsubmits = 0;
+  for (i = 0; i < n; i++) {
+    e = &t->ring.events[(first + i) % t->ring.size];
+    if (e->type == UV__TRACE_EVENT_SUBMIT)
+      submits[nsubmits++] = e;
+  }
+  qsort(submits, nsubmits, sizeof(*submits), uv__trace_submit_cmp);
+
+  pid = (int) uv_os_getpid();
+  first_event = 1;
+
+  fputs("{\"traceEvents\":[", stream);
+
+  for (i = 0; i < n; i++) {
+    e = &t->ring.events[(first + i) % t->ring.size];
+    uv__trace_dump_event(stream, e, NULL, pid, &first_event);
+  }
+
+  for (i = 0; i < nwork; i++) {
+    uv__trace_dump_event(stream,
+                         &work[i],
+                         uv__trace_find_submit(submits, nsubmits, &work[i]),
+                         pid,
+                         &first_event);
+  }
+
+  fprintf(stream,
+          "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,"
+          "\"args\":{\"name\":\"event loop\"}}",
+          first_event ? "\n" : ",\n",
+          pid);
+
+  /* Name the threadpool threads that show up in the trace. */
+  qsort(work, nwork, sizeof(*work), uv__trace_worker_cmp);
+  for (i = 0; i < nwork; i++) {
+    if (i > 0 && work[i].worker == work[i - 1].worker)
+      continue;
+
+    fprintf(stream,
+            ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,"
+            "\"args\":{\"name\":\"threadpool %u\"}}",
+            pid,
+            work[i].worker + 1u,
+            (unsigned int) work[i].worker);
+  }
+
+  fputs("\n],\"displayTimeUnit\":\"ns\"}\n", stream);
+
+  uv__free(submits);
+  uv__free(work);
+
+  if (ferror(stream))
+    return UV_EIO;
+
+  return 0;
+}
+
+
+void uv__trace_loop_close(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__trace_s* t;
+
+  lfields = uv__get_internal_fields(loop);
+  t = lfields->trace;
+  if (t == NULL)
+    return;
+
+  uv_mutex_destroy(&t->mutex);
+  uv__free(t->ring.events);
+  uv__free(t->work.events);
+  uv__free(t);
+  uv__atomic_store(struct uv__trace_s*, lfields->trace, NULL);
+  uv__atomic_store(int, lfields->tracing, 0);
+}
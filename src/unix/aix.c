@@ -130,6 +130,7 @@ int uv__io_check_fd(uv_loop_t* loop, int fd) {
 
 
 void uv__io_poll(uv_loop_t* loop, int timeout) {
+  uv__loop_internal_fields_t* lfields;
   struct pollfd events[1024];
   struct pollfd pqry;
   struct pollfd* pe;
@@ -146,6 +147,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   int rc;
   int add_failed;
 
+  lfields = uv__get_internal_fields(loop);
+
   if (loop->nfds == 0) {
     assert(QUEUE_EMPTY(&loop->watcher_queue));
     return;
@@ -159,9 +162,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     w = QUEUE_DATA(q, uv__io_t, watcher_queue);
     assert(w->pevents != 0);
     assert(w->fd >= 0);
-    assert(w->fd < (int) loop->nwatchers);
 
-    pc.events = w->pevents;
+    pc.events = w->pevents & ~UV__POLLHIGHPRI;
     pc.fd = w->fd;
 
     add_failed = 0;
@@ -215,10 +217,13 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   count = 48; /* Benchmarks suggest this gives the best throughput. */
 
   for (;;) {
+    uv__trace_syscall(loop, UV__TRACE_POLL);
+    uv__epoch_offline(loop);
     nfds = pollset_poll(loop->backend_fd,
                         events,
                         ARRAY_SIZE(events),
                         timeout);
+    SAVE_ERRNO(uv__epoch_online(loop));
 
     /* Update loop->time unconditionally. It's tempting to skip the update when
      * timeout == 0 (i.e. non-blocking poll) but there is no guarantee that the
@@ -249,9 +254,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     have_signals = 0;
     nevents = 0;
 
-    assert(loop->watchers != NULL);
-    loop->watchers[loop->nwatchers] = (void*) events;
-    loop->watchers[loop->nwatchers + 1] = (void*) (uintptr_t) nfds;
+    lfields->poll_events = events;
+    lfields->poll_nevents = nfds;
 
     for (i = 0; i < nfds; i++) {
       pe = events + i;
@@ -263,9 +267,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         continue;
 
       assert(pc.fd >= 0);
-      assert((unsigned) pc.fd < loop->nwatchers);
 
-      w = loop->watchers[pc.fd];
+      w = uv__io_watcher(loop, pc.fd);
 
       if (w == NULL) {
         /* File descriptor that we've stopped watching, disarm it.
@@ -280,25 +283,32 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       /* Run signal watchers last.  This also affects child process watchers
        * because those are implemented in terms of signal watchers.
        */
-      if (w == &loop->signal_io_watcher)
+      if (w == &loop->signal_io_watcher) {
         have_signals = 1;
-      else
+      } else {
+        uv__loop_dispatch(loop, NULL, w->cb);
         w->cb(loop, w, pe->revents);
+        uv__defer_run(loop);
+      }
 
       nevents++;
     }
 
-    if (have_signals != 0)
+    if (have_signals != 0) {
+      uv__loop_dispatch(loop, NULL, loop->signal_io_watcher.cb);
       loop->signal_io_watcher.cb(loop, &loop->signal_io_watcher, POLLIN);
+    }
 
-    loop->watchers[loop->nwatchers] = NULL;
-    loop->watchers[loop->nwatchers + 1] = NULL;
+    lfields->poll_events = NULL;
+    lfields->poll_nevents = 0;
 
     if (have_signals != 0)
       return;  /* Event loop should cycle now so don't poll again. */
 
     if (nevents != 0) {
-      if (nfds == ARRAY_SIZE(events) && --count != 0) {
+      if (nfds == ARRAY_SIZE(events) &&
+          --count != 0 &&
+          !uv__loop_over_budget(loop)) {
         /* Poll for more events but don't block this time. */
         timeout = 0;
         continue;
@@ -348,6 +358,12 @@ uint64_t uv_get_constrained_memory(void) {
   return 0;  /* Memory constraints are unknown. */
 }
 
+int uv_cpu_topology(uv_cpu_topology_t** cpus, int* count) {
+  *cpus = NULL;
+  *count = 0;
+  return UV_ENOSYS;
+}
+
 
 void uv_loadavg(double avg[3]) {
   perfstat_cpu_total_t ps_total;
@@ -1040,16 +1056,17 @@ int uv_cpu_info(uv_cpu_info_t** cpu_infos, int* count) {
 
 
 void uv__platform_invalidate_fd(uv_loop_t* loop, int fd) {
+  uv__loop_internal_fields_t* lfields;
   struct pollfd* events;
   uintptr_t i;
   uintptr_t nfds;
   struct poll_ctl pc;
 
-  assert(loop->watchers != NULL);
   assert(fd >= 0);
 
-  events = (struct pollfd*) loop->watchers[loop->nwatchers];
-  nfds = (uintptr_t) loop->watchers[loop->nwatchers + 1];
+  lfields = uv__get_internal_fields(loop);
+  events = lfields->poll_events;
+  nfds = lfields->poll_nevents;
 
   if (events != NULL)
     /* Invalidate events with same file descriptor */
@@ -32,6 +32,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sched.h>  /* sched_yield() */
 
 static void uv__async_send(uv_loop_t* loop);
 static int uv__async_start(uv_loop_t* loop);
@@ -79,19 +80,29 @@ int uv_async_send(uv_async_t* handle) {
 /* Only call this from the event loop thread. */
 static int uv__async_spin(uv_async_t* handle) {
   int rc;
+  int i;
 
   for (;;) {
-    /* rc=0 -- handle is not pending.
-     * rc=1 -- handle is pending, other thread is still working with it.
-     * rc=2 -- handle is pending, other thread is done.
-     */
-    rc = cmpxchgi(&handle->pending, 2, 0);
-
-    if (rc != 1)
-      return rc;
+    for (i = 0; i < 1000; i++) {
+      /* rc=0 -- handle is not pending.
+       * rc=1 -- handle is pending, other thread is still working with it.
+       * rc=2 -- handle is pending, other thread is done.
+       */
+      rc = cmpxchgi(&handle->pending, 2, 0);
+
+      if (rc != 1)
+        return rc;
+
+      /* Other thread is busy with this handle, spin until it's done. */
+      cpu_relax();
+    }
 
-    /* Other thread is busy with this handle, spin until it's done. */
-    cpu_relax();
+    /* The other thread may be waiting for this CPU: uv_async_send() wakes
+     * up the loop before it marks the handle as done, so when both threads
+     * share a CPU the wake-up can preempt the sender. Spinning would then
+     * burn the rest of the time slice.
+     */
+    sched_yield();
   }
 }
 
@@ -144,6 +155,7 @@ static void uv__async_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
     if (h->async_cb == NULL)
       continue;
 
+    uv__loop_dispatch(loop, h, h->async_cb);
     h->async_cb(h);
   }
 }
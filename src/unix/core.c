@@ -112,6 +112,9 @@ uint64_t uv_hrtime(void) {
 void uv_close(uv_handle_t* handle, uv_close_cb close_cb) {
   assert(!uv__is_closing(handle));
 
+  if (uv__get_internal_fields(handle->loop)->high_priority_watchers != 0)
+    uv_handle_set_io_priority(handle, UV_IO_PRIORITY_NORMAL);
+
   handle->flags |= UV_HANDLE_CLOSING;
   handle->close_cb = close_cb;
 
@@ -283,6 +286,7 @@ static void uv__finish_close(uv_handle_t* handle) {
   QUEUE_REMOVE(&handle->handle_queue);
 
   if (handle->close_cb) {
+    uv__loop_dispatch(handle->loop, handle, handle->close_cb);
     handle->close_cb(handle);
   }
 }
@@ -320,6 +324,9 @@ int uv_backend_timeout(const uv_loop_t* loop) {
   if (!uv__has_active_handles(loop) && !uv__has_active_reqs(loop))
     return 0;
 
+  if (uv__has_deferred(loop))
+    return 0;
+
   if (!QUEUE_EMPTY(&loop->idle_handles))
     return 0;
 
@@ -329,6 +336,9 @@ int uv_backend_timeout(const uv_loop_t* loop) {
   if (loop->closing_handles)
     return 0;
 
+  if (uv__get_internal_fields(loop)->poll_ncarry != 0)
+    return 0;
+
   return uv__next_timeout(loop);
 }
 
@@ -336,6 +346,7 @@ int uv_backend_timeout(const uv_loop_t* loop) {
 static int uv__loop_alive(const uv_loop_t* loop) {
   return uv__has_active_handles(loop) ||
          uv__has_active_reqs(loop) ||
+         uv__has_deferred(loop) ||
          loop->closing_handles != NULL;
 }
 
@@ -345,7 +356,27 @@ int uv_loop_alive(const uv_loop_t* loop) {
 }
 
 
-int uv_run(uv_loop_t* loop, uv_run_mode mode) {
+/* Set the time at which the coming iteration should stop dispatching I/O:
+ * whichever comes first of the time budget running out and `deadline`.
+ */
+static void uv__run_budget(uv_loop_t* loop, uint64_t deadline) {
+  uv__loop_internal_fields_t* lfields;
+  uint64_t budget;
+
+  lfields = uv__get_internal_fields(loop);
+  lfields->iter_deadline = deadline;
+
+  if (lfields->time_budget != 0) {
+    budget = uv__hrtime(UV_CLOCK_PRECISE) + lfields->time_budget;
+    if (deadline == 0 || budget < deadline)
+      lfields->iter_deadline = budget;
+  }
+}
+
+
+static int uv__run(uv_loop_t* loop, uv_run_mode mode, uint64_t deadline) {
+  uint64_t now;
+  uint64_t left;
   int timeout;
   int r;
   int ran_pending;
@@ -354,20 +385,55 @@ int uv_run(uv_loop_t* loop, uv_run_mode mode) {
   if (!r)
     uv__update_time(loop);
 
+  /* Callbacks may hold references to epoch-protected data from here on. */
+  uv__epoch_online(loop);
+
   while (r != 0 && loop->stop_flag == 0) {
+    if (deadline != 0 || uv__get_internal_fields(loop)->time_budget != 0)
+      uv__run_budget(loop, deadline);
+
+    UV__PROBE1(loop__start, loop);
     uv__update_time(loop);
+    uv__loop_phase(loop, UV__LOOP_PHASE_TIMERS);
     uv__run_timers(loop);
+    uv__loop_phase(loop, UV__LOOP_PHASE_PENDING);
     ran_pending = uv__run_pending(loop);
+    uv__loop_phase(loop, UV__LOOP_PHASE_IDLE);
     uv__run_idle(loop);
+    uv__defer_run(loop);
+    uv__loop_phase(loop, UV__LOOP_PHASE_PREPARE);
     uv__run_prepare(loop);
+    uv__defer_run(loop);
 
     timeout = 0;
     if ((mode == UV_RUN_ONCE && !ran_pending) || mode == UV_RUN_DEFAULT)
       timeout = uv_backend_timeout(loop);
 
+    if (deadline != 0 && timeout != 0) {
+      /* Don't sleep past the deadline, rounding up to whole milliseconds. */
+      now = uv__hrtime(UV_CLOCK_PRECISE);
+      left = deadline > now ? (deadline - now + 999999) / 1000000 : 0;
+      if (timeout == -1 || (uint64_t) timeout > left)
+        timeout = left;
+    }
+
+    if (timeout != 0 && uv__has_idle_tasks(loop))
+      timeout = uv__idle_tasks_run(loop, timeout);
+
+    if (!QUEUE_EMPTY(&uv__get_internal_fields(loop)->admissions))
+      timeout = uv__stream_admission_check(loop, timeout);
+
+    uv__loop_phase(loop, UV__LOOP_PHASE_POLL);
     uv__io_poll(loop, timeout);
+    /* Roughly when the kernel returned, uv__io_poll() updates the time. */
+    uv__get_internal_fields(loop)->poll_time = loop->time;
+    uv__defer_run(loop);
+    uv__loop_phase(loop, UV__LOOP_PHASE_CHECK);
     uv__run_check(loop);
+    uv__defer_run(loop);
+    uv__loop_phase(loop, UV__LOOP_PHASE_CLOSING);
     uv__run_closing_handles(loop);
+    uv__defer_run(loop);
 
     if (mode == UV_RUN_ONCE) {
       /* UV_RUN_ONCE implies forward progress: at least one callback must have
@@ -379,12 +445,17 @@ int uv_run(uv_loop_t* loop, uv_run_mode mode) {
        * the check.
        */
       uv__update_time(loop);
+      uv__loop_phase(loop, UV__LOOP_PHASE_TIMERS);
       uv__run_timers(loop);
     }
 
     r = uv__loop_alive(loop);
+    UV__PROBE2(loop__end, loop, r);
     if (mode == UV_RUN_ONCE || mode == UV_RUN_NOWAIT)
       break;
+
+    if (deadline != 0 && uv__hrtime(UV_CLOCK_PRECISE) >= deadline)
+      break;
   }
 
   /* The if statement lets gcc compile it to a conditional store. Avoids
@@ -393,10 +464,29 @@ int uv_run(uv_loop_t* loop, uv_run_mode mode) {
   if (loop->stop_flag != 0)
     loop->stop_flag = 0;
 
+  uv__loop_phase(loop, UV__LOOP_PHASE_NONE);
+  uv__epoch_offline(loop);
+
+  if (deadline != 0)
+    uv__get_internal_fields(loop)->iter_deadline = 0;
+
   return r;
 }
 
 
+int uv_run(uv_loop_t* loop, uv_run_mode mode) {
+  return uv__run(loop, mode, 0);
+}
+
+
+int uv_run_until(uv_loop_t* loop, uint64_t deadline) {
+  if (deadline <= uv__hrtime(UV_CLOCK_PRECISE))
+    return uv__loop_alive(loop);
+
+  return uv__run(loop, UV_RUN_DEFAULT, deadline);
+}
+
+
 void uv_update_time(uv_loop_t* loop) {
   uv__update_time(loop);
 }
@@ -762,6 +852,174 @@ int uv_fileno(const uv_handle_t* handle, uv_os_fd_t* fd) {
 }
 
 
+static uv__io_t* uv__handle_io_watcher(uv_handle_t* handle) {
+  switch (handle->type) {
+  case UV_TCP:
+  case UV_NAMED_PIPE:
+  case UV_TTY:
+    return &((uv_stream_t*) handle)->io_watcher;
+
+  case UV_UDP:
+    return &((uv_udp_t*) handle)->io_watcher;
+
+  case UV_POLL:
+    return &((uv_poll_t*) handle)->io_watcher;
+
+  default:
+    return NULL;
+  }
+}
+
+
+int uv_handle_set_io_priority(uv_handle_t* handle, int priority) {
+  uv__loop_internal_fields_t* lfields;
+  uv__io_t* w;
+
+  w = uv__handle_io_watcher(handle);
+  if (w == NULL || uv__is_closing(handle))
+    return UV_EINVAL;
+
+  lfields = uv__get_internal_fields(handle->loop);
+
+  switch (priority) {
+  case UV_IO_PRIORITY_NORMAL:
+    if (w->pevents & UV__POLLHIGHPRI) {
+      w->pevents &= ~UV__POLLHIGHPRI;
+      lfields->high_priority_watchers--;
+    }
+    return 0;
+
+  case UV_IO_PRIORITY_HIGH:
+    if (!(w->pevents & UV__POLLHIGHPRI)) {
+      w->pevents |= UV__POLLHIGHPRI;
+      lfields->high_priority_watchers++;
+    }
+    return 0;
+
+  default:
+    return UV_EINVAL;
+  }
+}
+
+
+/* The read size estimate and its bounds live in the reserved handle fields so
+ * the public structs keep their size. The first slot holds the zero-copy
+ * state of TCP streams.
+ */
+#define UV__READ_SIZE_ESTIMATE 1
+#define UV__READ_SIZE_MIN 2
+#define UV__READ_SIZE_MAX 3
+
+#define uv__read_size_get(handle, slot)                                       \
+  ((size_t) (uintptr_t) (handle)->u.reserved[(slot)])
+
+#define uv__read_size_put(handle, slot, value)                                \
+  ((handle)->u.reserved[(slot)] = (void*) (uintptr_t) (value))
+
+
+static size_t uv__read_size_clamp(uv_handle_t* handle, size_t size) {
+  if (size < uv__read_size_get(handle, UV__READ_SIZE_MIN))
+    return uv__read_size_get(handle, UV__READ_SIZE_MIN);
+
+  if (size > uv__read_size_get(handle, UV__READ_SIZE_MAX))
+    return uv__read_size_get(handle, UV__READ_SIZE_MAX);
+
+  return size;
+}
+
+
+void uv__read_size_init(uv_handle_t* handle) {
+  /* Datagrams that don't fit the buffer are truncated so UDP handles stick to
+   * the largest size until told otherwise. Streams start small and grow as
+   * soon as a read fills the buffer.
+   */
+  if (handle->type == UV_UDP) {
+    uv__read_size_put(handle, UV__READ_SIZE_MIN, 64 * 1024);
+    uv__read_size_put(handle, UV__READ_SIZE_ESTIMATE, 64 * 1024);
+  } else {
+    uv__read_size_put(handle, UV__READ_SIZE_MIN, 256);
+    uv__read_size_put(handle, UV__READ_SIZE_ESTIMATE, 4096);
+  }
+
+  uv__read_size_put(handle, UV__READ_SIZE_MAX, 64 * 1024);
+}
+
+
+size_t uv__read_size_suggest(uv_handle_t* handle, int fd, int query) {
+  size_t size;
+  int pending;
+
+  size = uv__read_size_get(handle, UV__READ_SIZE_ESTIMATE);
+
+  /* Ask the kernel how much is waiting when the estimate is likely off: the
+   * previous read filled the buffer, or the caller can't afford to guess low.
+   * Not worth a system call when the size is fixed.
+   */
+  if (query &&
+      uv__read_size_get(handle, UV__READ_SIZE_MIN) <
+      uv__read_size_get(handle, UV__READ_SIZE_MAX)) {
+    pending = 0;
+    if (ioctl(fd, FIONREAD, &pending) == 0 && pending > 0)
+      size = pending;
+  }
+
+  return uv__read_size_clamp(handle, size);
+}
+
+
+void uv__read_size_update(uv_handle_t* handle, size_t nread) {
+  size_t estimate;
+  size_t size;
+  size_t max;
+
+  /* Jump up to fit the last read but back off by halves, a burst of small
+   * reads shouldn't shrink the buffer to nothing straight away.
+   */
+  size = uv__read_size_get(handle, UV__READ_SIZE_MIN);
+  max = uv__read_size_get(handle, UV__READ_SIZE_MAX);
+  while (size < nread && size < max / 2)
+    size *= 2;
+  if (size < nread)
+    size = max;
+
+  estimate = uv__read_size_get(handle, UV__READ_SIZE_ESTIMATE) / 2;
+  if (estimate < size)
+    estimate = size;
+
+  uv__read_size_put(handle,
+                    UV__READ_SIZE_ESTIMATE,
+                    uv__read_size_clamp(handle, estimate));
+}
+
+
+int uv_handle_set_read_size(uv_handle_t* handle,
+                            size_t min_size,
+                            size_t max_size) {
+  switch (handle->type) {
+  case UV_TCP:
+  case UV_NAMED_PIPE:
+  case UV_TTY:
+  case UV_UDP:
+    break;
+
+  default:
+    return UV_EINVAL;
+  }
+
+  if (uv__is_closing(handle) || min_size == 0 || min_size > max_size)
+    return UV_EINVAL;
+
+  uv__read_size_put(handle, UV__READ_SIZE_MIN, min_size);
+  uv__read_size_put(handle, UV__READ_SIZE_MAX, max_size);
+  uv__read_size_put(handle,
+                    UV__READ_SIZE_ESTIMATE,
+                    uv__read_size_clamp(handle, uv__read_size_get(
+                        handle, UV__READ_SIZE_ESTIMATE)));
+
+  return 0;
+}
+
+
 static int uv__run_pending(uv_loop_t* loop) {
   QUEUE* q;
   QUEUE pq;
@@ -777,56 +1035,160 @@ static int uv__run_pending(uv_loop_t* loop) {
     QUEUE_REMOVE(q);
     QUEUE_INIT(q);
     w = QUEUE_DATA(q, uv__io_t, pending_queue);
+    uv__loop_dispatch(loop, NULL, w->cb);
     w->cb(loop, w, POLLOUT);
+    uv__defer_run(loop);
   }
 
   return 1;
 }
 
 
-static unsigned int next_power_of_two(unsigned int val) {
-  val -= 1;
-  val |= val >> 1;
-  val |= val >> 2;
-  val |= val >> 4;
-  val |= val >> 8;
-  val |= val >> 16;
-  val += 1;
-  return val;
+static uv__io_t** uv__io_slot(uv_loop_t* loop, int fd) {
+  uv__watcher_chunk_t** chunks;
+  uv__watcher_chunk_t* chunk;
+  unsigned int index;
+  unsigned int i;
+
+  index = (unsigned int) fd >> UV__WATCHER_CHUNK_SHIFT;
+  chunks = uv__watcher_chunks(loop);
+
+  if (index >= loop->nwatchers) {
+    chunks = uv__loop_realloc(loop,
+                              UV_ALLOC_LOOP,
+                              chunks,
+                              (index + 1) * sizeof(*chunks));
+    if (chunks == NULL)
+      abort();
+
+    for (i = loop->nwatchers; i <= index; i++)
+      chunks[i] = NULL;
+
+    loop->watchers = (uv__io_t**) chunks;
+    loop->nwatchers = index + 1;
+  }
+
+  chunk = chunks[index];
+  if (chunk == NULL) {
+    chunk = uv__loop_malloc(loop, UV_ALLOC_LOOP, sizeof(*chunk));
+    if (chunk == NULL)
+      abort();
+
+    memset(chunk, 0, sizeof(*chunk));
+    chunks[index] = chunk;
+  }
+
+  return chunk->slots + (fd & (UV__WATCHER_CHUNK_SIZE - 1));
 }
 
-static void maybe_resize(uv_loop_t* loop, unsigned int len) {
-  uv__io_t** watchers;
-  void* fake_watcher_list;
-  void* fake_watcher_count;
-  unsigned int nwatchers;
-  unsigned int i;
 
-  if (len <= loop->nwatchers)
+static void uv__io_slot_clear(uv_loop_t* loop, int fd) {
+  uv__watcher_chunk_t** chunks;
+  uv__watcher_chunk_t* chunk;
+  unsigned int index;
+  unsigned int n;
+
+  index = (unsigned int) fd >> UV__WATCHER_CHUNK_SHIFT;
+  chunks = uv__watcher_chunks(loop);
+  chunk = chunks[index];
+
+  chunk->slots[fd & (UV__WATCHER_CHUNK_SIZE - 1)] = NULL;
+  assert(chunk->count > 0);
+  if (--chunk->count > 0)
     return;
 
-  /* Preserve fake watcher list and count at the end of the watchers */
-  if (loop->watchers != NULL) {
-    fake_watcher_list = loop->watchers[loop->nwatchers];
-    fake_watcher_count = loop->watchers[loop->nwatchers + 1];
-  } else {
-    fake_watcher_list = NULL;
-    fake_watcher_count = NULL;
+  uv__loop_free(loop, chunk);
+  chunks[index] = NULL;
+
+  /* Shrink the directory once its upper half is unused. Not every time the
+   * last chunk goes away, that makes a file descriptor that keeps being
+   * opened and closed at a chunk boundary reallocate the directory.
+   */
+  n = loop->nwatchers;
+  while (n > 0 && chunks[n - 1] == NULL)
+    n--;
+
+  if (n == 0) {
+    uv__loop_free(loop, chunks);
+    loop->watchers = NULL;
+    loop->nwatchers = 0;
+  } else if (n <= loop->nwatchers / 2) {
+    chunks = uv__loop_realloc(loop,
+                              UV_ALLOC_LOOP,
+                              chunks,
+                              n * sizeof(*chunks));
+    if (chunks != NULL) {
+      loop->watchers = (uv__io_t**) chunks;
+      loop->nwatchers = n;
+    }
+  }
+}
+
+
+size_t uv__io_table_allocs(const uv_loop_t* loop) {
+  unsigned int i;
+  size_t n;
+
+  if (loop->watchers == NULL)
+    return 0;
+
+  n = 1;
+  for (i = 0; i < loop->nwatchers; i++)
+    if (uv__watcher_chunks(loop)[i] != NULL)
+      n++;
+
+  return n;
+}
+
+
+/* Moves the watcher table from the allocator `prev` to the loop's current
+ * allocator. Leaves the table untouched if that fails.
+ */
+int uv__io_table_move(uv_loop_t* loop, uv__loop_alloc_t* prev) {
+  uv__watcher_chunk_t** newchunks;
+  uv__watcher_chunk_t** chunks;
+  unsigned int i;
+
+  chunks = uv__watcher_chunks(loop);
+  if (chunks == NULL)
+    return 0;
+
+  newchunks = uv__loop_malloc(loop,
+                              UV_ALLOC_LOOP,
+                              loop->nwatchers * sizeof(*chunks));
+  if (newchunks == NULL)
+    return UV_ENOMEM;
+
+  for (i = 0; i < loop->nwatchers; i++)
+    newchunks[i] = NULL;
+
+  for (i = 0; i < loop->nwatchers; i++) {
+    if (chunks[i] == NULL)
+      continue;
+
+    newchunks[i] = uv__loop_malloc(loop, UV_ALLOC_LOOP, sizeof(*chunks[i]));
+    if (newchunks[i] == NULL)
+      goto fail;
+
+    memcpy(newchunks[i], chunks[i], sizeof(*chunks[i]));
   }
 
-  nwatchers = next_power_of_two(len + 2) - 2;
-  watchers = uv__realloc(loop->watchers,
-                         (nwatchers + 2) * sizeof(loop->watchers[0]));
+  for (i = 0; i < loop->nwatchers; i++)
+    if (chunks[i] != NULL)
+      uv__loop_alloc_release(loop, prev, chunks[i]);
+
+  uv__loop_alloc_release(loop, prev, chunks);
+  loop->watchers = (uv__io_t**) newchunks;
 
-  if (watchers == NULL)
-    abort();
-  for (i = loop->nwatchers; i < nwatchers; i++)
-    watchers[i] = NULL;
-  watchers[nwatchers] = fake_watcher_list;
-  watchers[nwatchers + 1] = fake_watcher_count;
+  return 0;
+
+fail:
+  for (i = 0; i < loop->nwatchers; i++)
+    uv__loop_free(loop, newchunks[i]);
+
+  uv__loop_free(loop, newchunks);
 
-  loop->watchers = watchers;
-  loop->nwatchers = nwatchers;
+  return UV_ENOMEM;
 }
 
 
@@ -848,13 +1210,15 @@ void uv__io_init(uv__io_t* w, uv__io_cb cb, int fd) {
 
 
 void uv__io_start(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
-  assert(0 == (events & ~(POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI)));
-  assert(0 != events);
+  uv__io_t** slot;
+
+  assert(0 == (events & ~(POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI |
+                          UV__POLLEXCLUSIVE | UV__POLLHIGHPRI)));
+  assert(0 != (events & ~UV__POLLHIGHPRI));
   assert(w->fd >= 0);
   assert(w->fd < INT_MAX);
 
   w->pevents |= events;
-  maybe_resize(loop, w->fd + 1);
 
 #if !defined(__sun)
   /* The event ports backend needs to rearm all file descriptors on each and
@@ -868,15 +1232,18 @@ void uv__io_start(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
   if (QUEUE_EMPTY(&w->watcher_queue))
     QUEUE_INSERT_TAIL(&loop->watcher_queue, &w->watcher_queue);
 
-  if (loop->watchers[w->fd] == NULL) {
-    loop->watchers[w->fd] = w;
+  slot = uv__io_slot(loop, w->fd);
+  if (*slot == NULL) {
+    *slot = w;
+    uv__watcher_chunks(loop)[w->fd >> UV__WATCHER_CHUNK_SHIFT]->count++;
     loop->nfds++;
   }
 }
 
 
 void uv__io_stop(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
-  assert(0 == (events & ~(POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI)));
+  assert(0 == (events & ~(POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI |
+                          UV__POLLEXCLUSIVE)));
   assert(0 != events);
 
   if (w->fd == -1)
@@ -884,20 +1251,21 @@ void uv__io_stop(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
 
   assert(w->fd >= 0);
 
-  /* Happens when uv__io_stop() is called on a handle that was never started. */
-  if ((unsigned) w->fd >= loop->nwatchers)
-    return;
-
   w->pevents &= ~events;
 
-  if (w->pevents == 0) {
+  /* The modifiers don't keep the watcher alive on their own. */
+  if ((w->pevents & ~UV__POLLHIGHPRI) == UV__POLLEXCLUSIVE)
+    w->pevents &= ~UV__POLLEXCLUSIVE;
+
+  if ((w->pevents & ~UV__POLLHIGHPRI) == 0) {
     QUEUE_REMOVE(&w->watcher_queue);
     QUEUE_INIT(&w->watcher_queue);
 
-    if (loop->watchers[w->fd] != NULL) {
-      assert(loop->watchers[w->fd] == w);
+    /* NULL when uv__io_stop() is called on a handle that was never started. */
+    if (uv__io_watcher(loop, w->fd) != NULL) {
+      assert(uv__io_watcher(loop, w->fd) == w);
       assert(loop->nfds > 0);
-      loop->watchers[w->fd] = NULL;
+      uv__io_slot_clear(loop, w->fd);
       loop->nfds--;
       w->events = 0;
     }
@@ -931,7 +1299,7 @@ int uv__io_active(const uv__io_t* w, unsigned int events) {
 
 
 int uv__fd_exists(uv_loop_t* loop, int fd) {
-  return (unsigned) fd < loop->nwatchers && loop->watchers[fd] != NULL;
+  return uv__io_watcher(loop, fd) != NULL;
 }
 
 
@@ -52,3 +52,9 @@ void uv_free_cpu_info(uv_cpu_info_t* cpu_infos, int count) {
   (void)cpu_infos;
   (void)count;
 }
+
+int uv_cpu_topology(uv_cpu_topology_t** cpus, int* count) {
+  *cpus = NULL;
+  *count = 0;
+  return UV_ENOSYS;
+}
@@ -127,6 +127,7 @@ extern char *mkdtemp(char *template); /* See issue #740 on AIX < 7 */
   do {                                                                        \
     if (cb != NULL) {                                                         \
       uv__req_register(loop, req);                                            \
+      uv__loop_alloc_charge(loop, UV_ALLOC_FS, uv__fs_path_size(req));        \
       uv__work_submit(loop,                                                   \
                       &req->work_req,                                         \
                       UV__WORK_FAST_IO,                                       \
@@ -142,6 +143,21 @@ extern char *mkdtemp(char *template); /* See issue #740 on AIX < 7 */
   while (0)
 
 
+#if defined(UV_ALLOC_STATS)
+static size_t uv__fs_path_size(const uv_fs_t* req) {
+  size_t size;
+
+  size = 0;
+  if (req->path != NULL)
+    size += strlen(req->path) + 1;
+  if (req->new_path != NULL)
+    size += strlen(req->new_path) + 1;
+
+  return size;
+}
+#endif
+
+
 static int uv__fs_close(int fd) {
   int rc;
 
@@ -1356,6 +1372,7 @@ static void uv__fs_done(struct uv__work* w, int status) {
 
   req = container_of(w, uv_fs_t, work_req);
   uv__req_unregister(req->loop, req);
+  uv__loop_alloc_uncharge(req->loop, UV_ALLOC_FS, uv__fs_path_size(req));
 
   if (status == UV_ECANCELED) {
     assert(req->result == 0);
@@ -1760,8 +1777,12 @@ void uv_fs_req_cleanup(uv_fs_t* req) {
    * Synchronous ones don't copy their arguments and have req->path and
    * req->new_path pointing to user-owned memory.  UV_FS_MKDTEMP is the
    * exception to the rule, it always allocates memory.
+   *
+   * The paths don't come from the loop's allocator because this may be
+   * called after the loop has been closed.
    */
-  if (req->path != NULL && (req->cb != NULL || req->fs_type == UV_FS_MKDTEMP))
+  if (req->path != NULL &&
+      (req->cb != NULL || req->fs_type == UV_FS_MKDTEMP))
     uv__free((void*) req->path);  /* Memory is shared with req->new_path. */
 
   req->path = NULL;
@@ -110,20 +110,28 @@ static void uv__getaddrinfo_work(struct uv__work* w) {
 
 static void uv__getaddrinfo_done(struct uv__work* w, int status) {
   uv_getaddrinfo_t* req;
+  void* buf;
 
   req = container_of(w, uv_getaddrinfo_t, work_req);
   uv__req_unregister(req->loop, req);
 
   /* See initialization in uv_getaddrinfo(). */
+  buf = NULL;
   if (req->hints)
-    uv__free(req->hints);
+    buf = req->hints;
   else if (req->service)
-    uv__free(req->service);
+    buf = req->service;
   else if (req->hostname)
-    uv__free(req->hostname);
+    buf = req->hostname;
   else
     assert(0);
 
+  /* Synchronous requests may run on any thread. */
+  if (req->cb != NULL)
+    uv__loop_free(req->loop, buf);
+  else
+    uv__free(buf);
+
   req->hints = NULL;
   req->service = NULL;
   req->hostname = NULL;
@@ -175,7 +183,11 @@ int uv_getaddrinfo(uv_loop_t* loop,
   hostname_len = hostname ? strlen(hostname) + 1 : 0;
   service_len = service ? strlen(service) + 1 : 0;
   hints_len = hints ? sizeof(*hints) : 0;
-  buf = uv__malloc(hostname_len + service_len + hints_len);
+  len = hostname_len + service_len + hints_len;
+  if (cb != NULL)
+    buf = uv__loop_malloc(loop, UV_ALLOC_DNS, len);
+  else
+    buf = uv__malloc(len);  /* Synchronous requests may run on any thread. */
 
   if (buf == NULL)
     return UV_ENOMEM;
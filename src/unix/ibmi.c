@@ -187,6 +187,12 @@ uint64_t uv_get_constrained_memory(void) {
   return 0;  /* Memory constraints are unknown. */
 }
 
+int uv_cpu_topology(uv_cpu_topology_t** cpus, int* count) {
+  *cpus = NULL;
+  *count = 0;
+  return UV_ENOSYS;
+}
+
 
 void uv_loadavg(double avg[3]) {
   SSTS0200 rcvr;
@@ -116,6 +116,22 @@ int uv__pthread_sigmask(int how, const sigset_t* set, sigset_t* oset);
 # define UV__POLLPRI 0
 #endif
 
+/* Not an event but a modifier for POLLIN that asks the backend to wake up
+ * only one of the loops watching a shared file descriptor. Equal to
+ * EPOLLEXCLUSIVE, which older libc headers don't define.
+ */
+#if defined(__linux__)
+# define UV__POLLEXCLUSIVE 0x10000000
+#else
+# define UV__POLLEXCLUSIVE 0
+#endif
+
+/* Not an event either: dispatch the watcher before the other watchers in the
+ * same poll batch. Unlike the other bits it survives uv__io_stop(), backends
+ * must strip it before handing the mask to the kernel.
+ */
+#define UV__POLLHIGHPRI 0x08000000
+
 #if !defined(O_CLOEXEC) && defined(__FreeBSD__)
 /*
  * It may be that we are just missing `__POSIX_VISIBLE >= 200809`.
@@ -188,6 +204,9 @@ int uv__socket(int domain, int type, int protocol);
 ssize_t uv__recvmsg(int fd, struct msghdr *msg, int flags);
 void uv__make_close_pending(uv_handle_t* handle);
 int uv__getiovmax(void);
+void uv__read_size_init(uv_handle_t* handle);
+size_t uv__read_size_suggest(uv_handle_t* handle, int fd, int query);
+void uv__read_size_update(uv_handle_t* handle, size_t nread);
 
 void uv__io_init(uv__io_t* w, uv__io_cb cb, int fd);
 void uv__io_start(uv_loop_t* loop, uv__io_t* w, unsigned int events);
@@ -200,6 +219,21 @@ void uv__io_poll(uv_loop_t* loop, int timeout); /* in milliseconds or -1 */
 int uv__io_fork(uv_loop_t* loop);
 int uv__fd_exists(uv_loop_t* loop, int fd);
 
+/* The watcher table maps file descriptors to watchers. loop->watchers is a
+ * directory of loop->nwatchers pointers to fixed-size chunks, so memory use
+ * follows the number of watched file descriptors rather than the highest
+ * file descriptor number. Chunks are freed when their last watcher stops.
+ */
+#define UV__WATCHER_CHUNK_SHIFT 9
+#define UV__WATCHER_CHUNK_SIZE (1u << UV__WATCHER_CHUNK_SHIFT)
+
+typedef struct {
+  unsigned int count;
+  uv__io_t* slots[UV__WATCHER_CHUNK_SIZE];
+} uv__watcher_chunk_t;
+
+#define uv__watcher_chunks(loop) ((uv__watcher_chunk_t**) (loop)->watchers)
+
 /* async */
 void uv__async_stop(uv_loop_t* loop);
 int uv__async_fork(uv_loop_t* loop);
@@ -219,6 +253,9 @@ void uv__stream_destroy(uv_stream_t* stream);
 int uv__stream_try_select(uv_stream_t* stream, int* fd);
 #endif /* defined(__APPLE__) */
 void uv__server_io(uv_loop_t* loop, uv__io_t* w, unsigned int events);
+void uv__server_io_start(uv_stream_t* stream);
+int uv__stream_admission_check(uv_loop_t* loop, int timeout);
+int uv__stream_zerocopy_set(uv_stream_t* stream, int enable, size_t min_size);
 int uv__accept(int sockfd);
 int uv__dup2_cloexec(int oldfd, int newfd);
 int uv__open_cloexec(const char* path, int flags);
@@ -286,12 +323,37 @@ void uv__fsevents_loop_delete(uv_loop_t* loop);
 
 #endif /* defined(__APPLE__) */
 
+/* Nonzero once the current loop iteration has used up its time budget or
+ * reached the uv_run_until() deadline.
+ */
+UV_UNUSED(static int uv__loop_over_budget(uv_loop_t* loop)) {
+  uint64_t deadline;
+
+  deadline = uv__get_internal_fields(loop)->iter_deadline;
+  return deadline != 0 && uv__hrtime(UV_CLOCK_PRECISE) >= deadline;
+}
+
 UV_UNUSED(static void uv__update_time(uv_loop_t* loop)) {
   /* Use a fast time source if available.  We only need millisecond precision.
    */
   loop->time = uv__hrtime(UV_CLOCK_FAST) / 1000000;
 }
 
+UV_UNUSED(static uv__io_t* uv__io_watcher(const uv_loop_t* loop, int fd)) {
+  uv__watcher_chunk_t* chunk;
+  unsigned int index;
+
+  index = (unsigned int) fd >> UV__WATCHER_CHUNK_SHIFT;
+  if (index >= loop->nwatchers)
+    return NULL;
+
+  chunk = uv__watcher_chunks(loop)[index];
+  if (chunk == NULL)
+    return NULL;
+
+  return chunk->slots[fd & (UV__WATCHER_CHUNK_SIZE - 1)];
+}
+
 UV_UNUSED(static char* uv__basename_r(const char* path)) {
   char* s;
 
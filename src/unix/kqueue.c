@@ -109,7 +109,33 @@ int uv__io_check_fd(uv_loop_t* loop, int fd) {
 }
 
 
+/* Move the events of high priority watchers to the front of the batch. */
+static void uv__kqueue_prioritize(uv_loop_t* loop,
+                                  struct kevent* events,
+                                  int nfds) {
+  struct kevent tmp;
+  uv__io_t* w;
+  int i;
+  int j;
+
+  for (i = 0, j = 0; i < nfds; i++) {
+    w = uv__io_watcher(loop, events[i].ident);
+    if (w == NULL || (w->pevents & UV__POLLHIGHPRI) == 0)
+      continue;
+
+    if (i != j) {
+      tmp = events[j];
+      events[j] = events[i];
+      events[i] = tmp;
+    }
+
+    j++;
+  }
+}
+
+
 void uv__io_poll(uv_loop_t* loop, int timeout) {
+  uv__loop_internal_fields_t* lfields;
   struct kevent events[1024];
   struct kevent* ev;
   struct timespec spec;
@@ -130,6 +156,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   int op;
   int i;
 
+  lfields = uv__get_internal_fields(loop);
+
   if (loop->nfds == 0) {
     assert(QUEUE_EMPTY(&loop->watcher_queue));
     return;
@@ -145,7 +173,6 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     w = QUEUE_DATA(q, uv__io_t, watcher_queue);
     assert(w->pevents != 0);
     assert(w->fd >= 0);
-    assert(w->fd < (int) loop->nwatchers);
 
     if ((w->events & POLLIN) == 0 && (w->pevents & POLLIN) != 0) {
       filter = EVFILT_READ;
@@ -211,12 +238,15 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     if (pset != NULL)
       pthread_sigmask(SIG_BLOCK, pset, NULL);
 
+    uv__trace_syscall(loop, UV__TRACE_POLL);
+    uv__epoch_offline(loop);
     nfds = kevent(loop->backend_fd,
                   events,
                   nevents,
                   events,
                   ARRAY_SIZE(events),
                   timeout == -1 ? NULL : &spec);
+    SAVE_ERRNO(uv__epoch_online(loop));
 
     if (pset != NULL)
       pthread_sigmask(SIG_UNBLOCK, pset, NULL);
@@ -249,16 +279,18 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     have_signals = 0;
     nevents = 0;
 
-    assert(loop->watchers != NULL);
-    loop->watchers[loop->nwatchers] = (void*) events;
-    loop->watchers[loop->nwatchers + 1] = (void*) (uintptr_t) nfds;
+    if (lfields->high_priority_watchers != 0)
+      uv__kqueue_prioritize(loop, events, nfds);
+
+    lfields->poll_events = events;
+    lfields->poll_nevents = nfds;
     for (i = 0; i < nfds; i++) {
       ev = events + i;
       fd = ev->ident;
       /* Skip invalidated events, see uv__platform_invalidate_fd */
       if (fd == -1)
         continue;
-      w = loop->watchers[fd];
+      w = uv__io_watcher(loop, fd);
 
       if (w == NULL) {
         /* File descriptor that we've stopped watching, disarm it.
@@ -276,7 +308,9 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       if (ev->filter == EVFILT_VNODE) {
         assert(w->events == POLLIN);
         assert(w->pevents == POLLIN);
+        uv__loop_dispatch(loop, NULL, w->cb);
         w->cb(loop, w, ev->fflags); /* XXX always uv__fs_event() */
+        uv__defer_run(loop);
         nevents++;
         continue;
       }
@@ -337,25 +371,32 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       /* Run signal watchers last.  This also affects child process watchers
        * because those are implemented in terms of signal watchers.
        */
-      if (w == &loop->signal_io_watcher)
+      if (w == &loop->signal_io_watcher) {
         have_signals = 1;
-      else
+      } else {
+        uv__loop_dispatch(loop, NULL, w->cb);
         w->cb(loop, w, revents);
+        uv__defer_run(loop);
+      }
 
       nevents++;
     }
 
-    if (have_signals != 0)
+    if (have_signals != 0) {
+      uv__loop_dispatch(loop, NULL, loop->signal_io_watcher.cb);
       loop->signal_io_watcher.cb(loop, &loop->signal_io_watcher, POLLIN);
+    }
 
-    loop->watchers[loop->nwatchers] = NULL;
-    loop->watchers[loop->nwatchers + 1] = NULL;
+    lfields->poll_events = NULL;
+    lfields->poll_nevents = 0;
 
     if (have_signals != 0)
       return;  /* Event loop should cycle now so don't poll again. */
 
     if (nevents != 0) {
-      if (nfds == ARRAY_SIZE(events) && --count != 0) {
+      if (nfds == ARRAY_SIZE(events) &&
+          --count != 0 &&
+          !uv__loop_over_budget(loop)) {
         /* Poll for more events but don't block this time. */
         timeout = 0;
         continue;
@@ -382,15 +423,16 @@ update_timeout:
 
 
 void uv__platform_invalidate_fd(uv_loop_t* loop, int fd) {
+  uv__loop_internal_fields_t* lfields;
   struct kevent* events;
   uintptr_t i;
   uintptr_t nfds;
 
-  assert(loop->watchers != NULL);
   assert(fd >= 0);
 
-  events = (struct kevent*) loop->watchers[loop->nwatchers];
-  nfds = (uintptr_t) loop->watchers[loop->nwatchers + 1];
+  lfields = uv__get_internal_fields(loop);
+  events = lfields->poll_events;
+  nfds = lfields->poll_nevents;
   if (events == NULL)
     return;
 
@@ -34,7 +34,9 @@
 #include <assert.h>
 #include <errno.h>
 
+#include <dirent.h>
 #include <net/if.h>
+#include <sched.h>
 #include <sys/epoll.h>
 #include <sys/param.h>
 #include <sys/prctl.h>
@@ -140,22 +142,30 @@ void uv__platform_loop_delete(uv_loop_t* loop) {
 
 
 void uv__platform_invalidate_fd(uv_loop_t* loop, int fd) {
+  uv__loop_internal_fields_t* lfields;
   struct epoll_event* events;
   struct epoll_event dummy;
   uintptr_t i;
   uintptr_t nfds;
 
-  assert(loop->watchers != NULL);
   assert(fd >= 0);
 
-  events = (struct epoll_event*) loop->watchers[loop->nwatchers];
-  nfds = (uintptr_t) loop->watchers[loop->nwatchers + 1];
+  lfields = uv__get_internal_fields(loop);
+  events = lfields->poll_events;
+  nfds = lfields->poll_nevents;
   if (events != NULL)
     /* Invalidate events with same file descriptor */
     for (i = 0; i < nfds; i++)
       if (events[i].data.fd == fd)
         events[i].data.fd = -1;
 
+  /* Same for the events carried over to the next iteration. */
+  events = lfields->poll_carry;
+  nfds = lfields->poll_ncarry;
+  for (i = 0; i < nfds; i++)
+    if (events[i].data.fd == fd)
+      events[i].data.fd = -1;
+
   /* Remove the file descriptor from the epoll.
    * This avoids a problem where the same file description remains open
    * in another process, causing repeated junk epoll events.
@@ -193,6 +203,60 @@ int uv__io_check_fd(uv_loop_t* loop, int fd) {
 }
 
 
+/* Move the events of high priority watchers to the front of the batch. */
+static void uv__epoll_prioritize(uv_loop_t* loop,
+                                 struct epoll_event* events,
+                                 int nfds) {
+  struct epoll_event tmp;
+  uv__io_t* w;
+  int i;
+  int j;
+
+  for (i = 0, j = 0; i < nfds; i++) {
+    w = uv__io_watcher(loop, events[i].data.fd);
+    if (w == NULL || (w->pevents & UV__POLLHIGHPRI) == 0)
+      continue;
+
+    if (i != j) {
+      tmp = events[j];
+      events[j] = events[i];
+      events[i] = tmp;
+    }
+
+    j++;
+  }
+}
+
+
+/* Keep the events that the loop ran out of time for so the next iteration
+ * dispatches them before polling again. Without this, level-triggered
+ * events at the end of a large batch would keep losing out to the ones at
+ * the start. If the buffer can't be allocated, the kernel reports the events
+ * again anyway, just not first.
+ */
+static void uv__epoll_carry(uv_loop_t* loop,
+                            struct epoll_event* events,
+                            int nfds) {
+  uv__loop_internal_fields_t* lfields;
+  struct epoll_event* carry;
+  int i;
+
+  lfields = uv__get_internal_fields(loop);
+  carry = lfields->poll_carry;
+
+  if (carry == NULL) {
+    carry = uv__loop_malloc(loop, UV_ALLOC_LOOP, 1024 * sizeof(*carry));
+    if (carry == NULL)
+      return;
+    lfields->poll_carry = carry;
+  }
+
+  for (i = 0; i < nfds; i++)
+    if (events[i].data.fd != -1)
+      carry[lfields->poll_ncarry++] = events[i];
+}
+
+
 void uv__io_poll(uv_loop_t* loop, int timeout) {
   /* A bug in kernels < 2.6.37 makes timeouts larger than ~30 minutes
    * effectively infinite on 32 bits architectures.  To avoid blocking
@@ -202,6 +266,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
    * the value of CONFIG_HZ.  The magic constant assumes CONFIG_HZ=1200,
    * that being the largest value I have seen in the wild (and only once.)
    */
+  uv__loop_internal_fields_t* lfields;
   static const int max_safe_timeout = 1789569;
   struct epoll_event events[1024];
   struct epoll_event* pe;
@@ -213,6 +278,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   sigset_t* psigset;
   uint64_t base;
   int have_signals;
+  int exhausted;
   int nevents;
   int count;
   int nfds;
@@ -220,8 +286,11 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   int op;
   int i;
 
+  lfields = uv__get_internal_fields(loop);
+
   if (loop->nfds == 0) {
     assert(QUEUE_EMPTY(&loop->watcher_queue));
+    lfields->poll_ncarry = 0;
     return;
   }
 
@@ -235,9 +304,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     w = QUEUE_DATA(q, uv__io_t, watcher_queue);
     assert(w->pevents != 0);
     assert(w->fd >= 0);
-    assert(w->fd < (int) loop->nwatchers);
 
-    e.events = w->pevents;
+    e.events = w->pevents & ~UV__POLLHIGHPRI;
     e.data.fd = w->fd;
 
     if (w->events == 0)
@@ -245,6 +313,12 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     else
       op = EPOLL_CTL_MOD;
 
+    /* EPOLLEXCLUSIVE can only be set when the file descriptor is added. */
+    if (op == EPOLL_CTL_MOD && (e.events & UV__POLLEXCLUSIVE)) {
+      epoll_ctl(loop->backend_fd, EPOLL_CTL_DEL, w->fd, &e);
+      op = EPOLL_CTL_ADD;
+    }
+
     /* XXX Future optimization: do EPOLL_CTL_MOD lazily if we stop watching
      * events, skip the syscall and squelch the events after epoll_wait().
      */
@@ -254,9 +328,20 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
 
       assert(op == EPOLL_CTL_ADD);
 
-      /* We've reactivated a file descriptor that's been watched before. */
-      if (epoll_ctl(loop->backend_fd, EPOLL_CTL_MOD, w->fd, &e))
-        abort();
+      /* We've reactivated a file descriptor that's been watched before.
+       * The kernel refuses to modify EPOLLEXCLUSIVE registrations, start
+       * over with those.
+       */
+      if (epoll_ctl(loop->backend_fd, EPOLL_CTL_MOD, w->fd, &e)) {
+        if (errno != EINVAL)
+          abort();
+
+        if (epoll_ctl(loop->backend_fd, EPOLL_CTL_DEL, w->fd, &e))
+          abort();
+
+        if (epoll_ctl(loop->backend_fd, EPOLL_CTL_ADD, w->fd, &e))
+          abort();
+      }
     }
 
     w->events = w->pevents;
@@ -281,11 +366,26 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     if (sizeof(int32_t) == sizeof(long) && timeout >= max_safe_timeout)
       timeout = max_safe_timeout;
 
-    nfds = epoll_pwait(loop->backend_fd,
-                       events,
-                       ARRAY_SIZE(events),
-                       timeout,
-                       psigset);
+    if (lfields->poll_ncarry != 0) {
+      /* Finish the batch the previous iteration ran out of time for before
+       * asking the kernel for more. uv_backend_timeout() made this a
+       * non-blocking poll.
+       */
+      nfds = lfields->poll_ncarry;
+      memcpy(events, lfields->poll_carry, nfds * sizeof(events[0]));
+      lfields->poll_ncarry = 0;
+    } else {
+      uv__trace_syscall(loop, UV__TRACE_POLL);
+      uv__epoch_offline(loop);
+      UV__PROBE2(poll__enter, loop, timeout);
+      nfds = epoll_pwait(loop->backend_fd,
+                         events,
+                         ARRAY_SIZE(events),
+                         timeout,
+                         psigset);
+      UV__PROBE2(poll__exit, loop, nfds);
+      SAVE_ERRNO(uv__epoch_online(loop));
+    }
 
     /* Update loop->time unconditionally. It's tempting to skip the update when
      * timeout == 0 (i.e. non-blocking poll) but there is no guarantee that the
@@ -320,11 +420,14 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     }
 
     have_signals = 0;
+    exhausted = 0;
     nevents = 0;
 
-    assert(loop->watchers != NULL);
-    loop->watchers[loop->nwatchers] = (void*) events;
-    loop->watchers[loop->nwatchers + 1] = (void*) (uintptr_t) nfds;
+    if (lfields->high_priority_watchers != 0)
+      uv__epoll_prioritize(loop, events, nfds);
+
+    lfields->poll_events = events;
+    lfields->poll_nevents = nfds;
     for (i = 0; i < nfds; i++) {
       pe = events + i;
       fd = pe->data.fd;
@@ -334,9 +437,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         continue;
 
       assert(fd >= 0);
-      assert((unsigned) fd < loop->nwatchers);
 
-      w = loop->watchers[fd];
+      w = uv__io_watcher(loop, fd);
 
       if (w == NULL) {
         /* File descriptor that we've stopped watching, disarm it.
@@ -378,22 +480,33 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         /* Run signal watchers last.  This also affects child process watchers
          * because those are implemented in terms of signal watchers.
          */
-        if (w == &loop->signal_io_watcher)
+        if (w == &loop->signal_io_watcher) {
           have_signals = 1;
-        else
+        } else {
+          uv__loop_dispatch(loop, NULL, w->cb);
           w->cb(loop, w, pe->events);
+          uv__defer_run(loop);
+        }
 
         nevents++;
+
+        if (uv__loop_over_budget(loop)) {
+          uv__epoll_carry(loop, events + i + 1, nfds - i - 1);
+          exhausted = 1;
+          break;
+        }
       }
     }
 
-    if (have_signals != 0)
+    if (have_signals != 0) {
+      uv__loop_dispatch(loop, NULL, loop->signal_io_watcher.cb);
       loop->signal_io_watcher.cb(loop, &loop->signal_io_watcher, POLLIN);
+    }
 
-    loop->watchers[loop->nwatchers] = NULL;
-    loop->watchers[loop->nwatchers + 1] = NULL;
+    lfields->poll_events = NULL;
+    lfields->poll_nevents = 0;
 
-    if (have_signals != 0)
+    if (have_signals != 0 || exhausted != 0)
       return;  /* Event loop should cycle now so don't poll again. */
 
     if (nevents != 0) {
@@ -822,6 +935,269 @@ void uv_free_cpu_info(uv_cpu_info_t* cpu_infos, int count) {
   uv__free(cpu_infos);
 }
 
+
+/* Reads the first line of a sysfs attribute into `buf`, minus the newline. */
+static int read_sysfs_line(const char* path, char* buf, size_t len) {
+  FILE* fp;
+  char* p;
+
+  fp = uv__open_file(path);
+  if (fp == NULL)
+    return UV__ERR(errno);
+
+  if (fgets(buf, len, fp) == NULL) {
+    fclose(fp);
+    return UV_EIO;
+  }
+
+  fclose(fp);
+
+  p = strchr(buf, '\n');
+  if (p != NULL)
+    *p = '\0';
+
+  return 0;
+}
+
+
+/* Returns the next "n" or "n-m" range from a sysfs CPU list like "0-3,8,10".
+ * Returns 0 when the list is exhausted.
+ */
+static int read_cpulist_range(const char** list,
+                              unsigned int* lo,
+                              unsigned int* hi) {
+  const char* p;
+  char* end;
+
+  p = *list;
+  while (*p == ',')
+    p++;
+
+  if (*p < '0' || *p > '9')
+    return 0;
+
+  *lo = strtoul(p, &end, 10);
+  *hi = *lo;
+  if (*end == '-')
+    *hi = strtoul(end + 1, &end, 10);
+
+  *list = end;
+  return *hi >= *lo;
+}
+
+
+static int read_cpulist_first(const char* path) {
+  char buf[4096];
+  const char* list;
+  unsigned int lo;
+  unsigned int hi;
+
+  if (read_sysfs_line(path, buf, sizeof(buf)))
+    return -1;
+
+  list = buf;
+  if (!read_cpulist_range(&list, &lo, &hi))
+    return -1;
+
+  return lo;
+}
+
+
+static int read_cpu_package(unsigned int cpu) {
+  char path[128];
+  char buf[32];
+
+  snprintf(path,
+           sizeof(path),
+           "/sys/devices/system/cpu/cpu%u/topology/physical_package_id",
+           cpu);
+
+  if (read_sysfs_line(path, buf, sizeof(buf)))
+    return -1;
+
+  return atoi(buf);
+}
+
+
+/* The last-level cache is the cache/indexN directory with the highest level.
+ * Returns the lowest-numbered CPU that shares it.
+ */
+static int read_cpu_llc(unsigned int cpu) {
+  char path[128];
+  char buf[32];
+  unsigned int index;
+  int best_level;
+  int level;
+  int first;
+  int best;
+
+  best_level = -1;
+  best = -1;
+
+  for (index = 0; /* empty */; index++) {
+    snprintf(path,
+             sizeof(path),
+             "/sys/devices/system/cpu/cpu%u/cache/index%u/level",
+             cpu,
+             index);
+
+    if (read_sysfs_line(path, buf, sizeof(buf)))
+      break;
+
+    level = atoi(buf);
+    if (level <= best_level)
+      continue;
+
+    snprintf(path,
+             sizeof(path),
+             "/sys/devices/system/cpu/cpu%u/cache/index%u/shared_cpu_list",
+             cpu,
+             index);
+
+    first = read_cpulist_first(path);
+    if (first == -1)
+      continue;
+
+    best_level = level;
+    best = first;
+  }
+
+  return best;
+}
+
+
+static uv_cpu_topology_t* find_cpu(uv_cpu_topology_t* cpus,
+                                   int count,
+                                   unsigned int cpu) {
+  int lo;
+  int hi;
+  int mid;
+
+  /* The online list is sorted so the array is too. */
+  lo = 0;
+  hi = count - 1;
+  while (lo <= hi) {
+    mid = lo + (hi - lo) / 2;
+    if ((unsigned int) cpus[mid].cpu == cpu)
+      return cpus + mid;
+    if ((unsigned int) cpus[mid].cpu < cpu)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+
+  return NULL;
+}
+
+
+static void read_numa_nodes(uv_cpu_topology_t* cpus, int count) {
+  uv_cpu_topology_t* ct;
+  struct dirent* ent;
+  const char* list;
+  char path[128];
+  char buf[4096];
+  unsigned int node;
+  unsigned int cpu;
+  unsigned int lo;
+  unsigned int hi;
+  DIR* dir;
+
+  /* Kernels built without CONFIG_NUMA don't have this directory. */
+  dir = opendir("/sys/devices/system/node");
+  if (dir == NULL)
+    return;
+
+  while ((ent = readdir(dir)) != NULL) {
+    if (sscanf(ent->d_name, "node%u", &node) != 1)
+      continue;
+
+    snprintf(path,
+             sizeof(path),
+             "/sys/devices/system/node/node%u/cpulist",
+             node);
+
+    if (read_sysfs_line(path, buf, sizeof(buf)))
+      continue;
+
+    list = buf;
+    while (read_cpulist_range(&list, &lo, &hi)) {
+      for (cpu = lo; cpu <= hi; cpu++) {
+        ct = find_cpu(cpus, count, cpu);
+        if (ct != NULL)
+          ct->node = node;
+      }
+    }
+  }
+
+  closedir(dir);
+}
+
+
+int uv_cpu_topology(uv_cpu_topology_t** cpus, int* count) {
+  uv_cpu_topology_t* ct;
+  cpu_set_t allowed;
+  const char* list;
+  char buf[4096];
+  unsigned int cpu;
+  unsigned int lo;
+  unsigned int hi;
+  int have_allowed;
+  char path[128];
+  int err;
+  int n;
+
+  *cpus = NULL;
+  *count = 0;
+
+  err = read_sysfs_line("/sys/devices/system/cpu/online", buf, sizeof(buf));
+  if (err)
+    return err;
+
+  n = 0;
+  list = buf;
+  while (read_cpulist_range(&list, &lo, &hi))
+    n += hi - lo + 1;
+
+  if (n == 0)
+    return UV_EIO;
+
+  ct = uv__calloc(n, sizeof(*ct));
+  if (ct == NULL)
+    return UV_ENOMEM;
+
+  CPU_ZERO(&allowed);
+  have_allowed = (0 == sched_getaffinity(0, sizeof(allowed), &allowed));
+
+  n = 0;
+  list = buf;
+  while (read_cpulist_range(&list, &lo, &hi)) {
+    for (cpu = lo; cpu <= hi; cpu++, n++) {
+      ct[n].cpu = cpu;
+      ct[n].package = read_cpu_package(cpu);
+      ct[n].cache = read_cpu_llc(cpu);
+      ct[n].node = -1;
+
+      snprintf(path,
+               sizeof(path),
+               "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list",
+               cpu);
+      ct[n].core = read_cpulist_first(path);
+
+      if (have_allowed && cpu < CPU_SETSIZE)
+        ct[n].allowed = CPU_ISSET(cpu, &allowed) != 0;
+      else
+        ct[n].allowed = !have_allowed;
+    }
+  }
+
+  read_numa_nodes(ct, n);
+
+  *cpus = ct;
+  *count = n;
+
+  return 0;
+}
+
 static int uv__ifaddr_exclude(struct ifaddrs *ent, int exclude_type) {
   if (!((ent->ifa_flags & IFF_UP) && (ent->ifa_flags & IFF_RUNNING)))
     return 1;
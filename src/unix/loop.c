@@ -28,6 +28,7 @@
 #include <unistd.h>
 
 int uv_loop_init(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
   void* saved_data;
   int err;
 
@@ -36,6 +37,17 @@ int uv_loop_init(uv_loop_t* loop) {
   memset(loop, 0, sizeof(*loop));
   loop->data = saved_data;
 
+  lfields = uv__calloc(1, sizeof(*lfields));
+  if (lfields == NULL)
+    return UV_ENOMEM;
+  loop->internal_fields = lfields;
+  QUEUE_INIT(&lfields->epoch_records);
+  QUEUE_INIT(&lfields->idle_tasks);
+  QUEUE_INIT(&lfields->stream_migrations);
+  QUEUE_INIT(&lfields->admissions);
+  QUEUE_INIT(&lfields->accept_batches);
+  lfields->watch_idle = 1;
+
   heap_init((struct heap*) &loop->timer_heap);
   QUEUE_INIT(&loop->wq);
   QUEUE_INIT(&loop->idle_handles);
@@ -66,7 +78,7 @@ int uv_loop_init(uv_loop_t* loop) {
 
   err = uv__platform_loop_init(loop);
   if (err)
-    return err;
+    goto fail_platform_init;
 
   uv__signal_global_once_init();
   err = uv_signal_init(loop, &loop->child_watcher);
@@ -106,14 +118,20 @@ fail_rwlock_init:
 fail_signal_init:
   uv__platform_loop_delete(loop);
 
+fail_platform_init:
+  uv__free(lfields);
+  loop->internal_fields = NULL;
+
   return err;
 }
 
 
 int uv_loop_fork(uv_loop_t* loop) {
-  int err;
+  uv__watcher_chunk_t* chunk;
   unsigned int i;
+  unsigned int j;
   uv__io_t* w;
+  int err;
 
   err = uv__io_fork(loop);
   if (err)
@@ -127,15 +145,23 @@ int uv_loop_fork(uv_loop_t* loop) {
   if (err)
     return err;
 
+  uv__watchdog_fork(loop);
+
   /* Rearm all the watchers that aren't re-queued by the above. */
   for (i = 0; i < loop->nwatchers; i++) {
-    w = loop->watchers[i];
-    if (w == NULL)
+    chunk = uv__watcher_chunks(loop)[i];
+    if (chunk == NULL)
       continue;
 
-    if (w->pevents != 0 && QUEUE_EMPTY(&w->watcher_queue)) {
-      w->events = 0; /* Force re-registration in uv__io_poll. */
-      QUEUE_INSERT_TAIL(&loop->watcher_queue, &w->watcher_queue);
+    for (j = 0; j < UV__WATCHER_CHUNK_SIZE; j++) {
+      w = chunk->slots[j];
+      if (w == NULL)
+        continue;
+
+      if (w->pevents != 0 && QUEUE_EMPTY(&w->watcher_queue)) {
+        w->events = 0; /* Force re-registration in uv__io_poll. */
+        QUEUE_INSERT_TAIL(&loop->watcher_queue, &w->watcher_queue);
+      }
     }
   }
 
@@ -144,6 +170,9 @@ int uv_loop_fork(uv_loop_t* loop) {
 
 
 void uv__loop_close(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  unsigned int i;
+
   uv__signal_loop_cleanup(loop);
   uv__platform_loop_delete(loop);
   uv__async_stop(loop);
@@ -176,13 +205,35 @@ void uv__loop_close(uv_loop_t* loop) {
   assert(loop->nfds == 0);
 #endif
 
-  uv__free(loop->watchers);
+  for (i = 0; i < loop->nwatchers; i++)
+    uv__loop_free(loop, uv__watcher_chunks(loop)[i]);
+
+  lfields = uv__get_internal_fields(loop);
+  uv__loop_free(loop, lfields->poll_carry);
+  lfields->poll_carry = NULL;
+  lfields->poll_ncarry = 0;
+
+  uv__loop_free(loop, loop->watchers);
   loop->watchers = NULL;
   loop->nwatchers = 0;
+
+  uv__loop_alloc_close(loop);
+  lfields = uv__get_internal_fields(loop);
+  uv__free(lfields);
+  loop->internal_fields = NULL;
 }
 
 
 int uv__loop_configure(uv_loop_t* loop, uv_loop_option option, va_list ap) {
+  uv__loop_internal_fields_t* lfields;
+
+  if (option == UV_LOOP_TIME_BUDGET) {
+    lfields = uv__get_internal_fields(loop);
+    lfields->time_budget = (uint64_t) va_arg(ap, unsigned int) * 1000000;
+    lfields->iter_deadline = 0;
+    return 0;
+  }
+
   if (option != UV_LOOP_BLOCK_SIGNAL)
     return UV_ENOSYS;
 
@@ -360,6 +360,12 @@ uint64_t uv_get_constrained_memory(void) {
   return 0;  /* Memory constraints are unknown. */
 }
 
+int uv_cpu_topology(uv_cpu_topology_t** cpus, int* count) {
+  *cpus = NULL;
+  *count = 0;
+  return UV_ENOSYS;
+}
+
 
 int uv_resident_set_memory(size_t* rss) {
   char* ascb;
@@ -656,16 +662,17 @@ void uv_free_interface_addresses(uv_interface_address_t* addresses,
 
 
 void uv__platform_invalidate_fd(uv_loop_t* loop, int fd) {
+  uv__loop_internal_fields_t* lfields;
   struct epoll_event* events;
   struct epoll_event dummy;
   uintptr_t i;
   uintptr_t nfds;
 
-  assert(loop->watchers != NULL);
   assert(fd >= 0);
 
-  events = (struct epoll_event*) loop->watchers[loop->nwatchers];
-  nfds = (uintptr_t) loop->watchers[loop->nwatchers + 1];
+  lfields = uv__get_internal_fields(loop);
+  events = lfields->poll_events;
+  nfds = lfields->poll_nevents;
   if (events != NULL)
     /* Invalidate events with same file descriptor */
     for (i = 0; i < nfds; i++)
@@ -811,6 +818,7 @@ static int os390_message_queue_handler(uv__os390_epoll* ep) {
 
 
 void uv__io_poll(uv_loop_t* loop, int timeout) {
+  uv__loop_internal_fields_t* lfields;
   static const int max_safe_timeout = 1789569;
   struct epoll_event events[1024];
   struct epoll_event* pe;
@@ -826,6 +834,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   int op;
   int i;
 
+  lfields = uv__get_internal_fields(loop);
+
   if (loop->nfds == 0) {
     assert(QUEUE_EMPTY(&loop->watcher_queue));
     return;
@@ -844,9 +854,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
 
     stream= container_of(w, uv_stream_t, io_watcher);
 
-    assert(w->fd < (int) loop->nwatchers);
 
-    e.events = w->pevents;
+    e.events = w->pevents & ~UV__POLLHIGHPRI;
     e.fd = w->fd;
 
     if (w->events == 0)
@@ -882,8 +891,11 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     if (sizeof(int32_t) == sizeof(long) && timeout >= max_safe_timeout)
       timeout = max_safe_timeout;
 
+    uv__trace_syscall(loop, UV__TRACE_POLL);
+    uv__epoch_offline(loop);
     nfds = epoll_wait(loop->ep, events,
                       ARRAY_SIZE(events), timeout);
+    SAVE_ERRNO(uv__epoch_online(loop));
 
     /* Update loop->time unconditionally. It's tempting to skip the update when
      * timeout == 0 (i.e. non-blocking poll) but there is no guarantee that the
@@ -918,9 +930,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     }
 
 
-    assert(loop->watchers != NULL);
-    loop->watchers[loop->nwatchers] = (void*) events;
-    loop->watchers[loop->nwatchers + 1] = (void*) (uintptr_t) nfds;
+    lfields->poll_events = events;
+    lfields->poll_nevents = nfds;
     for (i = 0; i < nfds; i++) {
       pe = events + i;
       fd = pe->fd;
@@ -936,9 +947,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       }
 
       assert(fd >= 0);
-      assert((unsigned) fd < loop->nwatchers);
 
-      w = loop->watchers[fd];
+      w = uv__io_watcher(loop, fd);
 
       if (w == NULL) {
         /* File descriptor that we've stopped watching, disarm it.
@@ -961,15 +971,19 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         pe->events |= w->pevents & (POLLIN | POLLOUT);
 
       if (pe->events != 0) {
+        uv__loop_dispatch(loop, NULL, w->cb);
         w->cb(loop, w, pe->events);
+        uv__defer_run(loop);
         nevents++;
       }
     }
-    loop->watchers[loop->nwatchers] = NULL;
-    loop->watchers[loop->nwatchers + 1] = NULL;
+    lfields->poll_events = NULL;
+    lfields->poll_nevents = 0;
 
     if (nevents != 0) {
-      if (nfds == ARRAY_SIZE(events) && --count != 0) {
+      if (nfds == ARRAY_SIZE(events) &&
+          --count != 0 &&
+          !uv__loop_over_budget(loop)) {
         /* Poll for more events but don't block this time. */
         timeout = 0;
         continue;
@@ -32,6 +32,7 @@ static void uv__poll_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
   int pevents;
 
   handle = container_of(w, uv_poll_t, io_watcher);
+  uv__loop_dispatch_handle(loop, handle);
 
   /*
    * As documented in the kernel source fs/kernfs/file.c #780
@@ -91,7 +91,7 @@ static void uv__pollfds_add(uv_loop_t* loop, uv__io_t* w) {
   assert(!loop->poll_fds_iterating);
   for (i = 0; i < loop->poll_fds_used; ++i) {
     if (loop->poll_fds[i].fd == w->fd) {
-      loop->poll_fds[i].events = w->pevents;
+      loop->poll_fds[i].events = w->pevents & ~UV__POLLHIGHPRI;
       return;
     }
   }
@@ -100,7 +100,7 @@ static void uv__pollfds_add(uv_loop_t* loop, uv__io_t* w) {
   uv__pollfds_maybe_resize(loop);
   pe = &loop->poll_fds[loop->poll_fds_used++];
   pe->fd = w->fd;
-  pe->events = w->pevents;
+  pe->events = w->pevents & ~UV__POLLHIGHPRI;
 }
 
 /* Remove a watcher's fd from our poll fds array.  */
@@ -159,7 +159,6 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     w = QUEUE_DATA(q, uv__io_t, watcher_queue);
     assert(w->pevents != 0);
     assert(w->fd >= 0);
-    assert(w->fd < (int) loop->nwatchers);
 
     uv__pollfds_add(loop, w);
 
@@ -185,7 +184,10 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     if (pset != NULL)
       if (pthread_sigmask(SIG_BLOCK, pset, NULL))
         abort();
+    uv__trace_syscall(loop, UV__TRACE_POLL);
+    uv__epoch_offline(loop);
     nfds = poll(loop->poll_fds, (nfds_t)loop->poll_fds_used, timeout);
+    SAVE_ERRNO(uv__epoch_online(loop));
     if (pset != NULL)
       if (pthread_sigmask(SIG_UNBLOCK, pset, NULL))
         abort();
@@ -234,9 +236,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         continue;
 
       assert(fd >= 0);
-      assert((unsigned) fd < loop->nwatchers);
 
-      w = loop->watchers[fd];
+      w = uv__io_watcher(loop, fd);
 
       if (w == NULL) {
         /* File descriptor that we've stopped watching, ignore.  */
@@ -254,15 +255,19 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         if (w == &loop->signal_io_watcher) {
           have_signals = 1;
         } else {
+          uv__loop_dispatch(loop, NULL, w->cb);
           w->cb(loop, w, pe->revents);
+          uv__defer_run(loop);
         }
 
         nevents++;
       }
     }
 
-    if (have_signals != 0)
+    if (have_signals != 0) {
+      uv__loop_dispatch(loop, NULL, loop->signal_io_watcher.cb);
       loop->signal_io_watcher.cb(loop, &loop->signal_io_watcher, POLLIN);
+    }
 
     loop->poll_fds_iterating = 0;
 
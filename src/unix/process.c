@@ -445,7 +445,9 @@ int uv_spawn(uv_loop_t* loop,
   err = UV_ENOMEM;
   pipes = pipes_storage;
   if (stdio_count > (int) ARRAY_SIZE(pipes_storage))
-    pipes = uv__malloc(stdio_count * sizeof(*pipes));
+    pipes = uv__loop_malloc(loop,
+                            UV_ALLOC_PROCESS,
+                            stdio_count * sizeof(*pipes));
 
   if (pipes == NULL)
     goto error;
@@ -552,7 +554,7 @@ int uv_spawn(uv_loop_t* loop,
   process->exit_cb = options->exit_cb;
 
   if (pipes != pipes_storage)
-    uv__free(pipes);
+    uv__loop_free(loop, pipes);
 
   return exec_errorno;
 
@@ -569,7 +571,7 @@ error:
     }
 
     if (pipes != pipes_storage)
-      uv__free(pipes);
+      uv__loop_free(loop, pipes);
   }
 
   return err;
@@ -465,6 +465,7 @@ static void uv__signal_event(uv_loop_t* loop,
 
       if (msg->signum == handle->signum) {
         assert(!(handle->flags & UV_HANDLE_CLOSING));
+        uv__loop_dispatch(loop, handle, handle->signal_cb);
         handle->signal_cb(handle, handle->signum);
       }
 
@@ -29,12 +29,18 @@
 #include <errno.h>
 
 #include <sys/types.h>
+#include <sys/resource.h>  /* getrlimit() */
 #include <sys/socket.h>
 #include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 #include <limits.h> /* IOV_MAX */
 
+#if defined(__linux__)
+# include <netinet/in.h>
+# include <linux/errqueue.h>
+#endif /* defined(__linux__) */
+
 #if defined(__APPLE__)
 # include <sys/event.h>
 # include <sys/time.h>
@@ -74,12 +80,90 @@ struct uv__stream_select_s {
     (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
 #endif /* defined(__APPLE__) */
 
+/* The most file descriptors that go in one message, either way. */
+#define UV__CMSG_FD_COUNT 64
+#define UV__CMSG_FD_SIZE (UV__CMSG_FD_COUNT * sizeof(int))
+
+#if defined(__linux__)
+/* Linux 4.14 and newer, for when the headers are older. */
+# ifndef SO_ZEROCOPY
+#  define SO_ZEROCOPY 60
+# endif
+# ifndef MSG_ZEROCOPY
+#  define MSG_ZEROCOPY 0x4000000
+# endif
+# ifndef SO_EE_ORIGIN_ZEROCOPY
+#  define SO_EE_ORIGIN_ZEROCOPY 5
+# endif
+# ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#  define SO_EE_CODE_ZEROCOPY_COPIED 1
+# endif
+#endif /* defined(__linux__) */
+
 static void uv__stream_connect(uv_stream_t*);
 static void uv__write(uv_stream_t* stream);
 static void uv__read(uv_stream_t* stream);
 static void uv__stream_io(uv_loop_t* loop, uv__io_t* w, unsigned int events);
 static void uv__write_callbacks(uv_stream_t* stream);
 static size_t uv__write_req_size(uv_write_t* req);
+static void uv__stream_migrate_detach(uv_stream_t* stream);
+static void uv__stream_migrate_cancel(uv_stream_t* stream);
+static int uv__stream_zerocopy_busy(uv_stream_t* stream);
+static void uv__stream_zerocopy_close(uv_stream_t* stream, int error);
+static int uv__stream_queue_fd(uv_stream_t* stream, int fd);
+void uv_try_write_cb(uv_write_t* req, int status);
+
+typedef struct {
+  struct uv__work work;
+  QUEUE queue;  /* Source loop's stream_migrations. */
+  uv_stream_t* stream;
+  uv_loop_t* target;
+  uv_migrate_cb cb;
+  uv_buf_t* bufs;  /* Write queue buffers while in transit. */
+  unsigned int events;
+  int active;
+} uv__stream_migration_t;
+
+typedef struct {
+  QUEUE queue;  /* Loop's admissions. */
+  uv_stream_t* server;
+  uv_admission_t limits;
+  uint64_t fd_limit;  /* RLIMIT_NOFILE when the limits were set. */
+  int next_fd;  /* Estimate of the lowest free file descriptor. */
+  int paused;
+} uv__stream_admission_t;
+
+/* The handles of a uv_write_handles() request. The first one is also in
+ * send_handle so the request is treated like any other that sends a handle.
+ */
+typedef struct {
+  unsigned int count;
+  uv_stream_t* handles[1];
+} uv__write_handles_t;
+
+#define uv__write_handles(req) ((uv__write_handles_t*) (req)->reserved[1])
+
+typedef struct {
+  QUEUE queue;  /* Loop's accept_batches. */
+  uv_stream_t* server;
+  uv_connection_batch_cb cb;
+  unsigned int max;
+} uv__stream_batch_t;
+
+/* Servers started with uv_listen_batch() have a batch record instead of a
+ * connection callback.
+ */
+#define uv__stream_is_listening(stream)                                       \
+  ((stream)->connection_cb != NULL ||                                         \
+   ((stream)->flags & UV_HANDLE_LISTEN_BATCH))
+
+/* How often a paused server is reconsidered when the loop is otherwise idle,
+ * in milliseconds.
+ */
+#define UV__ADMISSION_RECHECK 10
+
+/* Max number of iovecs uv__write() gathers from consecutive write requests. */
+#define UV__WRITE_BATCH 64
 
 
 void uv__stream_init(uv_loop_t* loop,
@@ -116,6 +200,7 @@ void uv__stream_init(uv_loop_t* loop,
   stream->select = NULL;
 #endif /* defined(__APPLE_) */
 
+  uv__read_size_init((uv_handle_t*) stream);
   uv__io_init(&stream->io_watcher, uv__stream_io, -1);
 }
 
@@ -443,6 +528,10 @@ int uv__stream_open(uv_stream_t* stream, int fd, int flags) {
 void uv__stream_flush_write_queue(uv_stream_t* stream, int error) {
   uv_write_t* req;
   QUEUE* q;
+
+  /* The requests that wait for the kernel were written first. */
+  uv__stream_zerocopy_close(stream, error);
+
   while (!QUEUE_EMPTY(&stream->write_queue)) {
     q = QUEUE_HEAD(&stream->write_queue);
     QUEUE_REMOVE(q);
@@ -465,6 +554,9 @@ void uv__stream_destroy(uv_stream_t* stream) {
     stream->connect_req = NULL;
   }
 
+  if (stream->flags & UV_HANDLE_MIGRATING)
+    uv__stream_migrate_cancel(stream);
+
   uv__stream_flush_write_queue(stream, UV_ECANCELED);
   uv__write_callbacks(stream);
 
@@ -525,16 +617,310 @@ static int uv__emfile_trick(uv_loop_t* loop, int accept_fd) {
 #endif /* defined(UV_HAVE_KQUEUE) */
 
 
+static uv__stream_admission_t* uv__stream_admission(const uv_stream_t* server) {
+  uv__loop_internal_fields_t* lfields;
+  uv__stream_admission_t* adm;
+  QUEUE* q;
+
+  lfields = uv__get_internal_fields(server->loop);
+  QUEUE_FOREACH(q, &lfields->admissions) {
+    adm = QUEUE_DATA(q, uv__stream_admission_t, queue);
+    if (adm->server == server)
+      return adm;
+  }
+
+  return NULL;
+}
+
+
+static uv__stream_batch_t* uv__stream_batch(const uv_stream_t* server) {
+  uv__loop_internal_fields_t* lfields;
+  uv__stream_batch_t* batch;
+  QUEUE* q;
+
+  lfields = uv__get_internal_fields(server->loop);
+  QUEUE_FOREACH(q, &lfields->accept_batches) {
+    batch = QUEUE_DATA(q, uv__stream_batch_t, queue);
+    if (batch->server == server)
+      return batch;
+  }
+
+  return NULL;
+}
+
+
+static void uv__stream_batch_remove(uv__stream_batch_t* batch) {
+  batch->server->flags &= ~UV_HANDLE_LISTEN_BATCH;
+  QUEUE_REMOVE(&batch->queue);
+  uv__loop_free(batch->server->loop, batch);
+}
+
+
+/* Returns the lowest free file descriptor, the one the next accept() would
+ * get, or -1 if there is none.
+ */
+static int uv__stream_lowest_free_fd(uv_stream_t* server) {
+  int fd;
+
+  fd = dup(uv__stream_fd(server));
+  if (fd != -1)
+    uv__close(fd);
+
+  return fd;
+}
+
+
+/* Returns non-zero if `adm` says the server should not accept. A paused
+ * server is held to limits that are `hysteresis` percent stricter so it
+ * doesn't flip back and forth at the edge.
+ */
+static int uv__stream_admission_exceeded(uv__stream_admission_t* adm,
+                                         int resume) {
+  uv__loop_internal_fields_t* lfields;
+  const uv_admission_t* l;
+  uint64_t free_fds;
+  uint64_t margin;
+
+  lfields = uv__get_internal_fields(adm->server->loop);
+  l = &adm->limits;
+  margin = resume ? l->hysteresis : 0;
+
+  if (l->max_loop_lag != 0)
+    if (lfields->loop_lag * 100 > l->max_loop_lag * (100 - margin))
+      return 1;
+
+  if (l->max_connections != 0)
+    if ((uint64_t) lfields->connections * 100 >=
+        (uint64_t) l->max_connections * (100 - margin))
+      return 1;
+
+  if (l->min_free_fds != 0) {
+    free_fds = 0;
+    if (adm->next_fd >= 0 && (uint64_t) adm->next_fd < adm->fd_limit)
+      free_fds = adm->fd_limit - adm->next_fd;
+    if (free_fds * 100 < (uint64_t) l->min_free_fds * (100 + margin))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+static void uv__stream_admission_pause(uv__stream_admission_t* adm) {
+  uv_stream_t* server;
+
+  server = adm->server;
+  if (!adm->paused) {
+    adm->paused = 1;
+    uv__get_internal_fields(server->loop)->admission_paused++;
+  }
+
+  uv__io_stop(server->loop,
+              &server->io_watcher,
+              POLLIN | UV__POLLEXCLUSIVE);
+}
+
+
+static void uv__stream_admission_resume(uv__stream_admission_t* adm) {
+  uv_stream_t* server;
+
+  server = adm->server;
+  adm->paused = 0;
+  uv__get_internal_fields(server->loop)->admission_paused--;
+
+  /* Still waiting for uv_accept() otherwise, which restarts it. */
+  if (server->accepted_fd == -1)
+    uv__server_io_start(server);
+}
+
+
+static void uv__stream_admission_remove(uv__stream_admission_t* adm) {
+  uv_stream_t* server;
+
+  server = adm->server;
+  if (adm->paused && !uv__is_closing(server))
+    uv__stream_admission_resume(adm);
+  else if (adm->paused)
+    uv__get_internal_fields(server->loop)->admission_paused--;
+
+  QUEUE_REMOVE(&adm->queue);
+  uv__loop_free(server->loop, adm);
+}
+
+
+/* Called by uv_run() right before it polls for I/O. Measures how long the
+ * loop took since the previous poll, pauses the servers that are over their
+ * limits, resumes the ones that are back under, and returns the poll timeout
+ * to use so paused servers get reconsidered even when nothing else happens.
+ */
+int uv__stream_admission_check(uv_loop_t* loop, int timeout) {
+  uv__loop_internal_fields_t* lfields;
+  uv__stream_admission_t* adm;
+  QUEUE* q;
+
+  lfields = uv__get_internal_fields(loop);
+  uv__update_time(loop);
+  lfields->loop_lag = loop->time - lfields->poll_time;
+
+  QUEUE_FOREACH(q, &lfields->admissions) {
+    adm = QUEUE_DATA(q, uv__stream_admission_t, queue);
+    if (!uv__stream_is_listening(adm->server))
+      continue;
+
+    if (adm->paused) {
+      if (adm->limits.min_free_fds != 0)
+        adm->next_fd = uv__stream_lowest_free_fd(adm->server);
+      if (!uv__stream_admission_exceeded(adm, 1))
+        uv__stream_admission_resume(adm);
+    } else if (uv__stream_admission_exceeded(adm, 0)) {
+      uv__stream_admission_pause(adm);
+    }
+  }
+
+  if (lfields->admission_paused > 0)
+    if (timeout == -1 || timeout > UV__ADMISSION_RECHECK)
+      timeout = UV__ADMISSION_RECHECK;
+
+  return timeout;
+}
+
+
+void uv__server_io_start(uv_stream_t* stream) {
+  unsigned int events;
+
+  events = POLLIN;
+  if (stream->type == UV_TCP &&
+      (stream->flags & UV_HANDLE_TCP_EXCLUSIVE_ACCEPT)) {
+    events |= UV__POLLEXCLUSIVE;
+  }
+
+  uv__io_start(stream->loop, &stream->io_watcher, events);
+}
+
+
+/* Like uv__server_io() but accepts up to batch->max connections before it
+ * calls back. The first one goes in accepted_fd and the rest are queued
+ * behind it, uv_accept() hands them out in order.
+ */
+static void uv__server_io_batch(uv_loop_t* loop,
+                                uv_stream_t* stream,
+                                uv__stream_batch_t* batch) {
+  uv__loop_internal_fields_t* lfields;
+  uv__stream_admission_t* adm;
+  unsigned int count;
+  int err;
+
+  lfields = uv__get_internal_fields(loop);
+
+  while (uv__stream_fd(stream) != -1) {
+    assert(stream->accepted_fd == -1);
+    count = 0;
+    err = 0;
+
+    while (count < batch->max) {
+      adm = NULL;
+      if (!QUEUE_EMPTY(&lfields->admissions))
+        adm = uv__stream_admission(stream);
+
+      if (adm != NULL) {
+        if (adm->paused || uv__stream_admission_exceeded(adm, 0)) {
+          uv__stream_admission_pause(adm);
+          err = UV_EAGAIN;
+          break;
+        }
+      }
+
+#if defined(UV_HAVE_KQUEUE)
+      if (stream->io_watcher.rcount <= 0) {
+        err = UV_EAGAIN;
+        break;
+      }
+#endif /* defined(UV_HAVE_KQUEUE) */
+
+      uv__trace_syscall(loop, UV__TRACE_ACCEPT);
+      err = uv__accept(uv__stream_fd(stream));
+      if (err == UV_ECONNABORTED)
+        continue;  /* Ignore. Nothing we can do about that. */
+
+      if (err < 0)
+        break;
+
+      UV__PROBE2(accept, stream, err);
+      UV_DEC_BACKLOG((&stream->io_watcher))
+
+      if (adm != NULL)
+        adm->next_fd = err + 1;
+
+      if (count == 0) {
+        stream->accepted_fd = err;
+      } else if (uv__stream_queue_fd(stream, err) != 0) {
+        uv__close(err);
+        err = UV_ENOMEM;
+        break;
+      }
+
+      count++;
+      err = 0;
+    }
+
+    if (count > 0) {
+      batch->cb(stream, 0, count);
+
+      if (uv__stream_fd(stream) == -1)
+        return;
+
+      if (stream->accepted_fd != -1) {
+        /* The user hasn't yet accepted them all. */
+        uv__io_stop(loop, &stream->io_watcher, POLLIN);
+        return;
+      }
+    }
+
+    if (err == UV_EAGAIN || err == UV__ERR(EWOULDBLOCK))
+      return;  /* Not an error. */
+
+    if (err == UV_EMFILE || err == UV_ENFILE) {
+      /* Try again, the batch may have given some back. */
+      if (count > 0)
+        continue;
+
+      err = uv__emfile_trick(loop, uv__stream_fd(stream));
+      if (err == UV_EAGAIN || err == UV__ERR(EWOULDBLOCK))
+        return;
+    }
+
+    if (err != 0)
+      batch->cb(stream, err, 0);
+
+    if (stream->type == UV_TCP &&
+        (stream->flags & UV_HANDLE_TCP_SINGLE_ACCEPT)) {
+      /* Give other processes a chance to accept connections. */
+      struct timespec timeout = { 0, 1 };
+      nanosleep(&timeout, NULL);
+    }
+  }
+}
+
+
 void uv__server_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
+  uv__loop_internal_fields_t* lfields;
+  uv__stream_admission_t* adm;
   uv_stream_t* stream;
   int err;
 
   stream = container_of(w, uv_stream_t, io_watcher);
+  uv__loop_dispatch_handle(loop, stream);
   assert(events & POLLIN);
   assert(stream->accepted_fd == -1);
   assert(!(stream->flags & UV_HANDLE_CLOSING));
 
   uv__io_start(stream->loop, &stream->io_watcher, POLLIN);
+  lfields = uv__get_internal_fields(loop);
+
+  if (stream->flags & UV_HANDLE_LISTEN_BATCH) {
+    uv__server_io_batch(loop, stream, uv__stream_batch(stream));
+    return;
+  }
 
   /* connection_cb can close the server socket while we're
    * in the loop so check it on each iteration.
@@ -542,11 +928,24 @@ void uv__server_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
   while (uv__stream_fd(stream) != -1) {
     assert(stream->accepted_fd == -1);
 
+    /* Looked up every time, connection_cb can change or remove the limits. */
+    adm = NULL;
+    if (!QUEUE_EMPTY(&lfields->admissions))
+      adm = uv__stream_admission(stream);
+
+    if (adm != NULL) {
+      if (adm->paused || uv__stream_admission_exceeded(adm, 0)) {
+        uv__stream_admission_pause(adm);
+        return;
+      }
+    }
+
 #if defined(UV_HAVE_KQUEUE)
     if (w->rcount <= 0)
       return;
 #endif /* defined(UV_HAVE_KQUEUE) */
 
+    uv__trace_syscall(loop, UV__TRACE_ACCEPT);
     err = uv__accept(uv__stream_fd(stream));
     if (err < 0) {
       if (err == UV_EAGAIN || err == UV__ERR(EWOULDBLOCK))
@@ -565,8 +964,13 @@ void uv__server_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
       continue;
     }
 
+    UV__PROBE2(accept, stream, err);
     UV_DEC_BACKLOG(w)
     stream->accepted_fd = err;
+
+    if (adm != NULL)
+      adm->next_fd = err + 1;
+
     stream->connection_cb(stream, 0);
 
     if (stream->accepted_fd != -1) {
@@ -623,6 +1027,12 @@ int uv_accept(uv_stream_t* server, uv_stream_t* client) {
 
   client->flags |= UV_HANDLE_BOUND;
 
+  /* Counted against uv_admission_t.max_connections until it's closed. */
+  if (client->type != UV_UDP && uv__stream_is_listening(server)) {
+    client->flags |= UV_HANDLE_CONNECTION;
+    uv__get_internal_fields(client->loop)->connections++;
+  }
+
 done:
   /* Process queued fds */
   if (server->queued_fds != NULL) {
@@ -636,7 +1046,7 @@ done:
     /* All read, free */
     assert(queued_fds->offset > 0);
     if (--queued_fds->offset == 0) {
-      uv__free(queued_fds);
+      uv__loop_free(server->loop, queued_fds);
       server->queued_fds = NULL;
     } else {
       /* Shift rest */
@@ -646,14 +1056,74 @@ done:
     }
   } else {
     server->accepted_fd = -1;
-    if (err == 0)
-      uv__io_start(server->loop, &server->io_watcher, POLLIN);
+    if (err == 0 && !uv_listen_is_paused(server))
+      uv__server_io_start(server);
   }
   return err;
 }
 
 
-int uv_listen(uv_stream_t* stream, int backlog, uv_connection_cb cb) {
+int uv_listen_set_admission(uv_stream_t* server,
+                            const uv_admission_t* limits) {
+  uv__loop_internal_fields_t* lfields;
+  uv__stream_admission_t* adm;
+  struct rlimit rlim;
+
+  if (server->type != UV_TCP && server->type != UV_NAMED_PIPE)
+    return UV_EINVAL;
+
+  if (uv__is_closing(server))
+    return UV_EINVAL;
+
+  if (limits != NULL && limits->hysteresis > 100)
+    return UV_EINVAL;
+
+  lfields = uv__get_internal_fields(server->loop);
+  adm = uv__stream_admission(server);
+
+  if (limits == NULL) {
+    if (adm != NULL)
+      uv__stream_admission_remove(adm);
+    return 0;
+  }
+
+  if (adm == NULL) {
+    adm = uv__loop_malloc(server->loop, UV_ALLOC_STREAM, sizeof(*adm));
+    if (adm == NULL)
+      return UV_ENOMEM;
+
+    adm->server = server;
+    adm->next_fd = 0;
+    adm->paused = 0;
+
+    /* Don't blame the time before the first limits were set on the loop. */
+    if (QUEUE_EMPTY(&lfields->admissions))
+      lfields->poll_time = server->loop->time;
+
+    QUEUE_INSERT_TAIL(&lfields->admissions, &adm->queue);
+  }
+
+  adm->limits = *limits;
+  adm->fd_limit = (uint64_t) -1;
+  if (getrlimit(RLIMIT_NOFILE, &rlim) == 0 && rlim.rlim_cur != RLIM_INFINITY)
+    adm->fd_limit = rlim.rlim_cur;
+
+  return 0;
+}
+
+
+int uv_listen_is_paused(const uv_stream_t* server) {
+  uv__stream_admission_t* adm;
+
+  if (QUEUE_EMPTY(&uv__get_internal_fields(server->loop)->admissions))
+    return 0;
+
+  adm = uv__stream_admission(server);
+  return adm != NULL && adm->paused;
+}
+
+
+static int uv__listen(uv_stream_t* stream, int backlog, uv_connection_cb cb) {
   int err;
 
   switch (stream->type) {
@@ -676,6 +1146,68 @@ int uv_listen(uv_stream_t* stream, int backlog, uv_connection_cb cb) {
 }
 
 
+int uv_listen(uv_stream_t* stream, int backlog, uv_connection_cb cb) {
+  int err;
+
+  err = uv__listen(stream, backlog, cb);
+
+  /* Back to one connection per callback. */
+  if (err == 0 && (stream->flags & UV_HANDLE_LISTEN_BATCH))
+    uv__stream_batch_remove(uv__stream_batch(stream));
+
+  return err;
+}
+
+
+int uv_listen_batch(uv_stream_t* stream,
+                    int backlog,
+                    unsigned int max_batch,
+                    uv_connection_batch_cb cb) {
+  uv__loop_internal_fields_t* lfields;
+  uv__stream_batch_t* batch;
+  uv__stream_batch_t prev;
+  int err;
+
+  if (stream->type != UV_TCP && stream->type != UV_NAMED_PIPE)
+    return UV_EINVAL;
+
+  if (uv__is_closing(stream) || max_batch == 0 || cb == NULL)
+    return UV_EINVAL;
+
+  if (stream->flags & UV_HANDLE_LISTEN_BATCH) {
+    batch = uv__stream_batch(stream);
+  } else {
+    batch = uv__loop_malloc(stream->loop, UV_ALLOC_STREAM, sizeof(*batch));
+    if (batch == NULL)
+      return UV_ENOMEM;
+
+    lfields = uv__get_internal_fields(stream->loop);
+    batch->server = stream;
+    QUEUE_INSERT_TAIL(&lfields->accept_batches, &batch->queue);
+  }
+
+  prev = *batch;
+  batch->cb = cb;
+  batch->max = max_batch;
+
+  /* The record is what uv__server_io() calls back, not connection_cb. */
+  err = uv__listen(stream, backlog, NULL);
+  if (err != 0) {
+    /* Leave a server that was already batching as it was. */
+    if (stream->flags & UV_HANDLE_LISTEN_BATCH) {
+      batch->cb = prev.cb;
+      batch->max = prev.max;
+    } else {
+      uv__stream_batch_remove(batch);
+    }
+    return err;
+  }
+
+  stream->flags |= UV_HANDLE_LISTEN_BATCH;
+  return 0;
+}
+
+
 static void uv__drain(uv_stream_t* stream) {
   uv_shutdown_t* req;
   int err;
@@ -684,8 +1216,9 @@ static void uv__drain(uv_stream_t* stream) {
   uv__io_stop(stream->loop, &stream->io_watcher, POLLOUT);
   uv__stream_osx_interrupt_select(stream);
 
-  /* Shutdown? */
+  /* Shutdown? Not before the write callbacks of the zero-copy writes. */
   if ((stream->flags & UV_HANDLE_SHUTTING) &&
+      !uv__stream_zerocopy_busy(stream) &&
       !(stream->flags & UV_HANDLE_CLOSING) &&
       !(stream->flags & UV_HANDLE_SHUT)) {
     assert(stream->shutdown_req);
@@ -695,24 +1228,336 @@ static void uv__drain(uv_stream_t* stream) {
     stream->flags &= ~UV_HANDLE_SHUTTING;
     uv__req_unregister(stream->loop, req);
 
-    err = 0;
-    if (shutdown(uv__stream_fd(stream), SHUT_WR))
-      err = UV__ERR(errno);
+    err = 0;
+    if (shutdown(uv__stream_fd(stream), SHUT_WR))
+      err = UV__ERR(errno);
+
+    if (err == 0)
+      stream->flags |= UV_HANDLE_SHUT;
+
+    if (req->cb != NULL)
+      req->cb(req, err);
+  }
+}
+
+
+static ssize_t uv__writev(int fd, struct iovec* vec, size_t n) {
+  if (n == 1)
+    return write(fd, vec->iov_base, vec->iov_len);
+  else
+    return writev(fd, vec, n);
+}
+
+
+/* Zero-copy writes. Every sendmsg(MSG_ZEROCOPY) that sends something gets the
+ * next 32-bit id from the kernel, which reports on the socket's error queue
+ * when it no longer needs the pages of a range of ids. Write requests that
+ * are done while sends are outstanding wait on |pending|, in order, until
+ * every id issued before them has been reported. That covers the zero-copy
+ * requests themselves and keeps the write callbacks of the requests queued
+ * after them in order.
+ */
+typedef struct {
+  uint32_t lo;
+  uint32_t hi;
+} uv__zerocopy_range_t;
+
+typedef struct {
+  QUEUE pending;
+  size_t min_size;  /* Smallest request that is sent zero-copy, 0 if off. */
+  uint32_t next;  /* Id of the next zero-copy send. */
+  uint32_t done;  /* Every id before this one has been reported. */
+  uv__zerocopy_range_t* ranges;  /* Reported out of order, past |done|. */
+  unsigned int nranges;
+  unsigned int maxranges;
+} uv__stream_zerocopy_t;
+
+/* TCP streams don't use the reserved handle fields, the state hangs off the
+ * first one when UV_HANDLE_TCP_ZEROCOPY is set.
+ */
+#define uv__stream_zerocopy(stream)                                           \
+  ((uv__stream_zerocopy_t*) (stream)->u.reserved[0])
+
+#define uv__zerocopy_before(a, b) ((int32_t) ((a) - (b)) < 0)
+
+
+static int uv__stream_zerocopy_busy(uv_stream_t* stream) {
+  uv__stream_zerocopy_t* zc;
+
+  if (!(stream->flags & UV_HANDLE_TCP_ZEROCOPY))
+    return 0;
+
+  zc = uv__stream_zerocopy(stream);
+  return !QUEUE_EMPTY(&zc->pending) || zc->done != zc->next;
+}
+
+
+/* Holds back a finished write request while zero-copy sends that precede it
+ * are outstanding. Returns 1 if the request was held back.
+ */
+static int uv__stream_zerocopy_defer(uv_stream_t* stream, uv_write_t* req) {
+  uv__stream_zerocopy_t* zc;
+
+  if (!uv__stream_zerocopy_busy(stream))
+    return 0;
+
+  zc = uv__stream_zerocopy(stream);
+  req->reserved[0] = (void*) (uintptr_t) (uint32_t) (zc->next - 1);
+  QUEUE_INSERT_TAIL(&zc->pending, &req->queue);
+
+  /* The completions raise POLLERR, which epoll only reports for file
+   * descriptors it watches. POLLPRI is the quietest event a TCP socket has,
+   * it only fires for out-of-band data.
+   */
+  uv__io_start(stream->loop, &stream->io_watcher, UV__POLLPRI);
+
+  return 1;
+}
+
+
+#if defined(__linux__)
+/* Moves the requests whose buffers the kernel is done with to the write
+ * completed queue.
+ */
+static void uv__stream_zerocopy_complete(uv_stream_t* stream) {
+  uv__stream_zerocopy_t* zc;
+  uv_write_t* req;
+  QUEUE* q;
+
+  zc = uv__stream_zerocopy(stream);
+
+  while (!QUEUE_EMPTY(&zc->pending)) {
+    q = QUEUE_HEAD(&zc->pending);
+    req = QUEUE_DATA(q, uv_write_t, queue);
+
+    /* reserved[0] holds the last id the request waits for. */
+    if (!uv__zerocopy_before((uint32_t) (uintptr_t) req->reserved[0],
+                             zc->done)) {
+      break;
+    }
+
+    QUEUE_REMOVE(q);
+    QUEUE_INSERT_TAIL(&stream->write_completed_queue, q);
+  }
+
+  if (!uv__stream_zerocopy_busy(stream))
+    uv__io_stop(stream->loop, &stream->io_watcher, UV__POLLPRI);
+}
+
+
+/* Records that the kernel is done with the sends in [lo, hi]. */
+static void uv__stream_zerocopy_ack(uv__stream_zerocopy_t* zc,
+                                    uint32_t lo,
+                                    uint32_t hi) {
+  uv__zerocopy_range_t* ranges;
+  unsigned int i;
+
+  if (lo != zc->done) {
+    if (zc->nranges == zc->maxranges) {
+      ranges = uv__realloc(zc->ranges,
+                           2 * (zc->maxranges + 4) * sizeof(*ranges));
+      if (ranges == NULL)
+        abort();
+      zc->ranges = ranges;
+      zc->maxranges = 2 * (zc->maxranges + 4);
+    }
+
+    zc->ranges[zc->nranges].lo = lo;
+    zc->ranges[zc->nranges].hi = hi;
+    zc->nranges++;
+    return;
+  }
+
+  zc->done = hi + 1;
+
+  /* Pull in the ranges that were reported early and now line up. */
+  i = 0;
+  while (i < zc->nranges) {
+    if (zc->ranges[i].lo != zc->done) {
+      i++;
+      continue;
+    }
+
+    zc->done = zc->ranges[i].hi + 1;
+    zc->ranges[i] = zc->ranges[--zc->nranges];
+    i = 0;
+  }
+}
+
+
+static int uv__stream_zerocopy_want(uv_stream_t* stream, uv_write_t* req) {
+  uv__stream_zerocopy_t* zc;
+  size_t size;
+
+  zc = uv__stream_zerocopy(stream);
+  if (zc->min_size == 0)
+    return 0;
+
+  /* uv_try_write() hands the buffers back to the caller right away. */
+  if (req->cb == uv_try_write_cb)
+    return 0;
+
+  size = uv__write_req_size(req);
+  return size != 0 && size >= zc->min_size;
+}
+
+
+static ssize_t uv__stream_zerocopy_send(uv_stream_t* stream,
+                                        struct iovec* iov,
+                                        int iovcnt) {
+  uv__stream_zerocopy_t* zc;
+  struct msghdr msg;
+  ssize_t n;
+
+  zc = uv__stream_zerocopy(stream);
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = iovcnt;
+
+  do
+    n = sendmsg(uv__stream_fd(stream), &msg, MSG_ZEROCOPY);
+  while (n == -1 && RETRY_ON_WRITE_ERROR(errno));
+
+  if (n > 0)
+    zc->next++;
+
+  /* ENOBUFS means the pages that can be pinned for the socket are used up.
+   * Copy this time rather than wait for the kernel to release some.
+   */
+  if (n == -1 && errno == ENOBUFS)
+    do
+      n = uv__writev(uv__stream_fd(stream), iov, iovcnt);
+    while (n == -1 && RETRY_ON_WRITE_ERROR(errno));
+
+  return n;
+}
+
+
+static void uv__stream_zerocopy_reap(uv_stream_t* stream) {
+  uv__stream_zerocopy_t* zc;
+  struct sock_extended_err* serr;
+  struct cmsghdr* cmsg;
+  struct msghdr msg;
+  union {
+    char data[128];
+    struct cmsghdr alias;
+  } scratch;
+  ssize_t n;
+
+  zc = uv__stream_zerocopy(stream);
+
+  for (;;) {
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = &scratch.alias;
+    msg.msg_controllen = sizeof(scratch.data);
+
+    do
+      n = recvmsg(uv__stream_fd(stream), &msg, MSG_ERRQUEUE);
+    while (n == -1 && errno == EINTR);
+
+    if (n == -1)
+      break;  /* EAGAIN, the error queue is empty. */
+
+    for (cmsg = CMSG_FIRSTHDR(&msg);
+         cmsg != NULL;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+          !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+        continue;
+      }
+
+      serr = (struct sock_extended_err*) CMSG_DATA(cmsg);
+      if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        continue;
+
+      uv__stream_zerocopy_ack(zc, serr->ee_info, serr->ee_data);
+
+      /* The kernel had to copy after all, loopback traffic always is. Stop
+       * paying for the page pinning and the completions.
+       */
+      if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+        zc->min_size = 0;
+    }
+  }
+
+  uv__stream_zerocopy_complete(stream);
+}
+#endif /* defined(__linux__) */
+
+
+int uv__stream_zerocopy_set(uv_stream_t* stream, int enable, size_t min_size) {
+#if defined(__linux__)
+  uv__stream_zerocopy_t* zc;
+  int on;
+
+  if (uv__stream_fd(stream) == -1)
+    return UV_EBADF;
+
+  if (!(stream->flags & UV_HANDLE_TCP_ZEROCOPY)) {
+    if (!enable)
+      return 0;
+
+    on = 1;
+    if (setsockopt(uv__stream_fd(stream),
+                   SOL_SOCKET,
+                   SO_ZEROCOPY,
+                   &on,
+                   sizeof(on))) {
+      if (errno == ENOPROTOOPT || errno == EINVAL)
+        return UV_ENOTSUP;
+      return UV__ERR(errno);
+    }
+
+    zc = uv__calloc(1, sizeof(*zc));
+    if (zc == NULL)
+      return UV_ENOMEM;
+
+    QUEUE_INIT(&zc->pending);
+    stream->u.reserved[0] = zc;
+    stream->flags |= UV_HANDLE_TCP_ZEROCOPY;
+  }
+
+  /* Disabling leaves the state in place until the outstanding sends are
+   * reported, the kernel keeps the socket option.
+   */
+  zc = uv__stream_zerocopy(stream);
+  zc->min_size = enable ? (min_size != 0 ? min_size : 1) : 0;
+
+  return 0;
+#else
+  return UV_ENOTSUP;
+#endif /* defined(__linux__) */
+}
+
+
+/* Cancels the requests that still wait for the kernel and frees the state.
+ * The kernel may go on reading their buffers until the socket is torn down.
+ */
+static void uv__stream_zerocopy_close(uv_stream_t* stream, int error) {
+  uv__stream_zerocopy_t* zc;
+  uv_write_t* req;
+  QUEUE* q;
+
+  if (!(stream->flags & UV_HANDLE_TCP_ZEROCOPY))
+    return;
+
+  zc = uv__stream_zerocopy(stream);
+
+  while (!QUEUE_EMPTY(&zc->pending)) {
+    q = QUEUE_HEAD(&zc->pending);
+    QUEUE_REMOVE(q);
 
-    if (err == 0)
-      stream->flags |= UV_HANDLE_SHUT;
+    req = QUEUE_DATA(q, uv_write_t, queue);
+    req->error = error;
 
-    if (req->cb != NULL)
-      req->cb(req, err);
+    QUEUE_INSERT_TAIL(&stream->write_completed_queue, &req->queue);
   }
-}
 
-
-static ssize_t uv__writev(int fd, struct iovec* vec, size_t n) {
-  if (n == 1)
-    return write(fd, vec->iov_base, vec->iov_len);
-  else
-    return writev(fd, vec, n);
+  uv__free(zc->ranges);
+  uv__free(zc);
+  stream->u.reserved[0] = NULL;
+  stream->flags &= ~UV_HANDLE_TCP_ZEROCOPY;
 }
 
 
@@ -742,6 +1587,7 @@ static int uv__write_req_update(uv_stream_t* stream,
 
   assert(n <= stream->write_queue_size);
   stream->write_queue_size -= n;
+  UV__PROBE2(write__queue, stream, stream->write_queue_size);
 
   buf = req->bufs + req->write_index;
 
@@ -773,10 +1619,15 @@ static void uv__write_req_finish(uv_write_t* req) {
    */
   if (req->error == 0) {
     if (req->bufs != req->bufsml)
-      uv__free(req->bufs);
+      uv__loop_free(stream->loop, req->bufs);
     req->bufs = NULL;
   }
 
+  if ((stream->flags & UV_HANDLE_TCP_ZEROCOPY) &&
+      uv__stream_zerocopy_defer(stream, req)) {
+    return;
+  }
+
   /* Add it to the write_completed_queue where it will have its
    * callback called in the near future.
    */
@@ -785,6 +1636,65 @@ static void uv__write_req_finish(uv_write_t* req) {
 }
 
 
+/* Accounts for |n| bytes written from the front of the write queue, finishing
+ * the requests that were written out completely. Returns 1 if that covers all
+ * the data that was written, or 0 if the write stopped halfway a request.
+ */
+static int uv__write_req_commit(uv_stream_t* stream, size_t n) {
+  uv_write_t* req;
+  size_t size;
+
+  do {
+    req = QUEUE_DATA(QUEUE_HEAD(&stream->write_queue), uv_write_t, queue);
+    size = uv__write_req_size(req);
+
+    if (!uv__write_req_update(stream, req, n < size ? n : size))
+      return 0;
+
+    uv__write_req_finish(req);
+    n -= size;
+  } while (n > 0);
+
+  return 1;
+}
+
+
+/* Collects the buffers of consecutive queued write requests into |iov| so they
+ * can go out with a single writev(). Stops at the first request that sends a
+ * handle because that one needs a sendmsg() of its own. Returns the number of
+ * iovecs filled in.
+ */
+static int uv__write_gather(uv_stream_t* stream, struct iovec* iov, int iovmax) {
+  uv_write_t* req;
+  QUEUE* q;
+  int iovcnt;
+  int n;
+
+  iovcnt = 0;
+
+  for (q = QUEUE_HEAD(&stream->write_queue);
+       q != &stream->write_queue;
+       q = QUEUE_NEXT(q)) {
+    req = QUEUE_DATA(q, uv_write_t, queue);
+
+    if (req->send_handle != NULL)
+      break;
+
+    n = req->nbufs - req->write_index;
+    if (n > iovmax - iovcnt)
+      n = iovmax - iovcnt;
+
+    memcpy(iov + iovcnt, req->bufs + req->write_index, n * sizeof(*iov));
+    iovcnt += n;
+
+    if (iovcnt == iovmax)
+      break;
+  }
+
+  return iovcnt;
+}
+
+
 static int uv__handle_fd(uv_handle_t* handle) {
   switch (handle->type) {
     case UV_NAMED_PIPE:
@@ -800,9 +1710,11 @@ static int uv__handle_fd(uv_handle_t* handle) {
 }
 
 static void uv__write(uv_stream_t* stream) {
+  struct iovec batch[UV__WRITE_BATCH];
   struct iovec* iov;
   QUEUE* q;
   uv_write_t* req;
+  int zerocopy;
   int iovmax;
   int iovcnt;
   ssize_t n;
@@ -833,30 +1745,59 @@ start:
   if (iovcnt > iovmax)
     iovcnt = iovmax;
 
+  zerocopy = 0;
+#if defined(__linux__)
+  if ((stream->flags & UV_HANDLE_TCP_ZEROCOPY) && req->send_handle == NULL)
+    zerocopy = uv__stream_zerocopy_want(stream, req);
+#endif /* defined(__linux__) */
+
+  /* Small writes that are queued back to back go out in one writev(). */
+  if (!zerocopy &&
+      req->send_handle == NULL &&
+      iovcnt < UV__WRITE_BATCH &&
+      iovcnt < iovmax &&
+      QUEUE_NEXT(q) != &stream->write_queue) {
+    iov = batch;
+    iovcnt = uv__write_gather(stream,
+                              batch,
+                              iovmax < UV__WRITE_BATCH ? iovmax
+                                                       : UV__WRITE_BATCH);
+  }
+
   /*
    * Now do the actual writev. Note that we've been updating the pointers
    * inside the iov each time we write. So there is no need to offset it.
    */
 
   if (req->send_handle) {
-    int fd_to_send;
+    uv__write_handles_t* handles;
+    uv_stream_t* send_handle;
+    int fds_to_send[UV__CMSG_FD_COUNT];
+    unsigned int nfds;
+    unsigned int i;
     struct msghdr msg;
     struct cmsghdr *cmsg;
     union {
-      char data[64];
+      char data[CMSG_SPACE(UV__CMSG_FD_SIZE)];
       struct cmsghdr alias;
     } scratch;
 
-    if (uv__is_closing(req->send_handle)) {
-      err = UV_EBADF;
-      goto error;
-    }
+    handles = uv__write_handles(req);
+    nfds = handles != NULL ? handles->count : 1;
+    assert(nfds <= ARRAY_SIZE(fds_to_send));
 
-    fd_to_send = uv__handle_fd((uv_handle_t*) req->send_handle);
+    for (i = 0; i < nfds; i++) {
+      send_handle = handles != NULL ? handles->handles[i] : req->send_handle;
+      if (uv__is_closing(send_handle)) {
+        err = UV_EBADF;
+        goto error;
+      }
 
-    memset(&scratch, 0, sizeof(scratch));
+      fds_to_send[i] = uv__handle_fd((uv_handle_t*) send_handle);
+      assert(fds_to_send[i] >= 0);
+    }
 
-    assert(fd_to_send >= 0);
+    memset(&scratch, 0, sizeof(scratch));
 
     msg.msg_name = NULL;
     msg.msg_namelen = 0;
@@ -865,28 +1806,34 @@ start:
     msg.msg_flags = 0;
 
     msg.msg_control = &scratch.alias;
-    msg.msg_controllen = CMSG_SPACE(sizeof(fd_to_send));
+    msg.msg_controllen = CMSG_SPACE(nfds * sizeof(fds_to_send[0]));
 
     cmsg = CMSG_FIRSTHDR(&msg);
     cmsg->cmsg_level = SOL_SOCKET;
     cmsg->cmsg_type = SCM_RIGHTS;
-    cmsg->cmsg_len = CMSG_LEN(sizeof(fd_to_send));
-
-    /* silence aliasing warning */
-    {
-      void* pv = CMSG_DATA(cmsg);
-      int* pi = pv;
-      *pi = fd_to_send;
-    }
+    cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(fds_to_send[0]));
+    memcpy(CMSG_DATA(cmsg), fds_to_send, nfds * sizeof(fds_to_send[0]));
 
+    uv__trace_syscall(stream->loop, UV__TRACE_WRITE);
     do
       n = sendmsg(uv__stream_fd(stream), &msg, 0);
     while (n == -1 && RETRY_ON_WRITE_ERROR(errno));
 
-    /* Ensure the handle isn't sent again in case this is a partial write. */
-    if (n >= 0)
+    /* Ensure the handles aren't sent again in case this is a partial write. */
+    if (n >= 0) {
       req->send_handle = NULL;
+      if (handles != NULL) {
+        uv__loop_free(stream->loop, handles);
+        req->reserved[1] = NULL;
+      }
+    }
+#if defined(__linux__)
+  } else if (zerocopy) {
+    uv__trace_syscall(stream->loop, UV__TRACE_WRITE);
+    n = uv__stream_zerocopy_send(stream, iov, iovcnt);
+#endif /* defined(__linux__) */
   } else {
+    uv__trace_syscall(stream->loop, UV__TRACE_WRITE);
     do
       n = uv__writev(uv__stream_fd(stream), iov, iovcnt);
     while (n == -1 && RETRY_ON_WRITE_ERROR(errno));
@@ -897,10 +1844,14 @@ start:
     goto error;
   }
 
-  if (n >= 0 && uv__write_req_update(stream, req, n)) {
-    uv__write_req_finish(req);
-    return;  /* TODO(bnoordhuis) Start trying to write the next request. */
-  }
+  if (n >= 0)
+    UV__PROBE2(write, stream, n);
+
+  /* The pending POLLOUT from uv__write_req_finish() picks up the rest of the
+   * write queue.
+   */
+  if (n >= 0 && uv__write_req_commit(stream, n))
+    return;
 
   /* If this is a blocking stream, try again. */
   if (stream->flags & UV_HANDLE_BLOCKING_WRITES)
@@ -943,11 +1894,18 @@ static void uv__write_callbacks(uv_stream_t* stream) {
 
     if (req->bufs != NULL) {
       stream->write_queue_size -= uv__write_req_size(req);
+      UV__PROBE2(write__queue, stream, stream->write_queue_size);
       if (req->bufs != req->bufsml)
-        uv__free(req->bufs);
+        uv__loop_free(stream->loop, req->bufs);
       req->bufs = NULL;
     }
 
+    /* Never went out. */
+    if (uv__write_handles(req) != NULL) {
+      uv__loop_free(stream->loop, uv__write_handles(req));
+      req->reserved[1] = NULL;
+    }
+
     /* NOTE: call callback AFTER freeing the request data. */
     if (req->cb)
       req->cb(req, req->error);
@@ -1016,8 +1974,10 @@ static int uv__stream_queue_fd(uv_stream_t* stream, int fd) {
   queued_fds = stream->queued_fds;
   if (queued_fds == NULL) {
     queue_size = 8;
-    queued_fds = uv__malloc((queue_size - 1) * sizeof(*queued_fds->fds) +
-                            sizeof(*queued_fds));
+    queued_fds = uv__loop_malloc(stream->loop,
+                                 UV_ALLOC_STREAM,
+                                 (queue_size - 1) * sizeof(*queued_fds->fds) +
+                                  sizeof(*queued_fds));
     if (queued_fds == NULL)
       return UV_ENOMEM;
     queued_fds->size = queue_size;
@@ -1027,9 +1987,11 @@ static int uv__stream_queue_fd(uv_stream_t* stream, int fd) {
     /* Grow */
   } else if (queued_fds->size == queued_fds->offset) {
     queue_size = queued_fds->size + 8;
-    queued_fds = uv__realloc(queued_fds,
-                             (queue_size - 1) * sizeof(*queued_fds->fds) +
-                              sizeof(*queued_fds));
+    queued_fds = uv__loop_realloc(stream->loop,
+                                  UV_ALLOC_STREAM,
+                                  queued_fds,
+                                  (queue_size - 1) * sizeof(*queued_fds->fds) +
+                                   sizeof(*queued_fds));
 
     /*
      * Allocation failure, report back.
@@ -1048,10 +2010,6 @@ static int uv__stream_queue_fd(uv_stream_t* stream, int fd) {
 }
 
 
-#define UV__CMSG_FD_COUNT 64
-#define UV__CMSG_FD_SIZE (UV__CMSG_FD_COUNT * sizeof(int))
-
-
 static int uv__stream_recv_cmsg(uv_stream_t* stream, struct msghdr* msg) {
   struct cmsghdr* cmsg;
 
@@ -1113,6 +2071,7 @@ static void uv__read(uv_stream_t* stream) {
   ssize_t nread;
   struct msghdr msg;
   char cmsg_space[CMSG_SPACE(UV__CMSG_FD_SIZE)];
+  size_t size;
   int count;
   int err;
   int is_ipc;
@@ -1134,8 +2093,13 @@ static void uv__read(uv_stream_t* stream) {
       && (count-- > 0)) {
     assert(stream->alloc_cb != NULL);
 
+    /* Past the first read the previous one filled the buffer. */
+    size = uv__read_size_suggest((uv_handle_t*) stream,
+                                 uv__stream_fd(stream),
+                                 count < 31);
+
     buf = uv_buf_init(NULL, 0);
-    stream->alloc_cb((uv_handle_t*)stream, 64 * 1024, &buf);
+    stream->alloc_cb((uv_handle_t*)stream, size, &buf);
     if (buf.base == NULL || buf.len == 0) {
       /* User indicates it can't or won't handle the read. */
       stream->read_cb(stream, UV_ENOBUFS, &buf);
@@ -1145,6 +2109,7 @@ static void uv__read(uv_stream_t* stream) {
     assert(buf.base != NULL);
     assert(uv__stream_fd(stream) >= 0);
 
+    uv__trace_syscall(stream->loop, UV__TRACE_READ);
     if (!is_ipc) {
       do {
         nread = read(uv__stream_fd(stream), buf.base, buf.len);
@@ -1231,6 +2196,8 @@ static void uv__read(uv_stream_t* stream) {
         msg.msg_iov = old;
       }
 #endif
+      uv__read_size_update((uv_handle_t*) stream, nread);
+      UV__PROBE2(read, stream, nread);
       stream->read_cb(stream, nread, &buf);
 
       /* Return if we didn't fill the buffer, there is no more data to read. */
@@ -1238,18 +2205,97 @@ static void uv__read(uv_stream_t* stream) {
         stream->flags |= UV_HANDLE_READ_PARTIAL;
         return;
       }
+
+      /* Leave the rest for the next iteration, the fd stays readable. */
+      if (uv__loop_over_budget(stream->loop))
+        return;
     }
   }
 }
 
 
+int uv_try_read(uv_stream_t* stream,
+                const uv_buf_t bufs[],
+                unsigned int nbufs) {
+  struct msghdr msg;
+  char cmsg_space[CMSG_SPACE(UV__CMSG_FD_SIZE)];
+  ssize_t nread;
+  int iovmax;
+  int is_ipc;
+  int err;
+
+  assert(stream->type == UV_TCP || stream->type == UV_NAMED_PIPE ||
+      stream->type == UV_TTY);
+
+  if (stream->flags & UV_HANDLE_CLOSING)
+    return UV_EBADF;
+
+  if (stream->flags & UV_HANDLE_READ_EOF)
+    return UV_EOF;
+
+  if (!(stream->flags & UV_HANDLE_READABLE))
+    return UV_ENOTCONN;
+
+  /* A zero-length read can't be told apart from EOF. */
+  if (uv__count_bufs(bufs, nbufs) == 0)
+    return UV_EINVAL;
+
+  iovmax = uv__getiovmax();
+  if (nbufs > (unsigned int) iovmax)
+    nbufs = iovmax;
+
+  is_ipc = stream->type == UV_NAMED_PIPE && ((uv_pipe_t*) stream)->ipc;
+
+  uv__trace_syscall(stream->loop, UV__TRACE_READ);
+  if (!is_ipc) {
+    do
+      nread = readv(uv__stream_fd(stream), (const struct iovec*) bufs, nbufs);
+    while (nread < 0 && errno == EINTR);
+  } else {
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec*) bufs;
+    msg.msg_iovlen = nbufs;
+    msg.msg_controllen = sizeof(cmsg_space);
+    msg.msg_control = cmsg_space;
+
+    do
+      nread = uv__recvmsg(uv__stream_fd(stream), &msg, 0);
+    while (nread < 0 && errno == EINTR);
+  }
+
+  if (nread < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return UV_EAGAIN;
+    return UV__ERR(errno);
+  }
+
+  if (nread == 0) {
+    /* Like uv__stream_eof() but the caller hears about it, not read_cb. */
+    stream->flags |= UV_HANDLE_READ_EOF;
+    stream->flags &= ~UV_HANDLE_READING;
+    uv__io_stop(stream->loop, &stream->io_watcher, POLLIN);
+    if (!uv__io_active(&stream->io_watcher, POLLOUT))
+      uv__handle_stop(stream);
+    uv__stream_osx_interrupt_select(stream);
+    return UV_EOF;
+  }
+
+  /* Received handles are picked up with uv_accept() as usual. */
+  if (is_ipc) {
+    err = uv__stream_recv_cmsg(stream, &msg);
+    if (err != 0)
+      return err;
+  }
+
+  UV__PROBE2(read, stream, nread);
+  return nread;
+}
+
+
 #ifdef __clang__
 # pragma clang diagnostic pop
 #endif
 
-#undef UV__CMSG_FD_COUNT
-#undef UV__CMSG_FD_SIZE
-
 
 int uv_shutdown(uv_shutdown_t* req, uv_stream_t* stream, uv_shutdown_cb cb) {
   assert(stream->type == UV_TCP ||
@@ -1283,12 +2329,18 @@ static void uv__stream_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
   uv_stream_t* stream;
 
   stream = container_of(w, uv_stream_t, io_watcher);
+  uv__loop_dispatch_handle(loop, stream);
 
   assert(stream->type == UV_TCP ||
          stream->type == UV_NAMED_PIPE ||
          stream->type == UV_TTY);
   assert(!(stream->flags & UV_HANDLE_CLOSING));
 
+  if (stream->flags & UV_HANDLE_MIGRATING) {
+    uv__stream_migrate_detach(stream);
+    return;
+  }
+
   if (stream->connect_req) {
     uv__stream_connect(stream);
     return;
@@ -1296,6 +2348,12 @@ static void uv__stream_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
 
   assert(uv__stream_fd(stream) >= 0);
 
+#if defined(__linux__)
+  /* Zero-copy completions, the write callbacks run below. */
+  if ((events & POLLERR) && (stream->flags & UV_HANDLE_TCP_ZEROCOPY))
+    uv__stream_zerocopy_reap(stream);
+#endif /* defined(__linux__) */
+
   /* Ignore POLLHUP here. Even if it's set, there may still be data to read. */
   if (events & (POLLIN | POLLERR | POLLHUP))
     uv__read(stream);
@@ -1385,12 +2443,13 @@ static void uv__stream_connect(uv_stream_t* stream) {
 }
 
 
-int uv_write2(uv_write_t* req,
-              uv_stream_t* stream,
-              const uv_buf_t bufs[],
-              unsigned int nbufs,
-              uv_stream_t* send_handle,
-              uv_write_cb cb) {
+static int uv__write2(uv_write_t* req,
+                      uv_stream_t* stream,
+                      const uv_buf_t bufs[],
+                      unsigned int nbufs,
+                      uv_stream_t* send_handle,
+                      uv__write_handles_t* handles,
+                      uv_write_cb cb) {
   int empty_queue;
 
   assert(nbufs > 0);
@@ -1439,11 +2498,14 @@ int uv_write2(uv_write_t* req,
   req->handle = stream;
   req->error = 0;
   req->send_handle = send_handle;
+  req->reserved[1] = handles;
   QUEUE_INIT(&req->queue);
 
   req->bufs = req->bufsml;
   if (nbufs > ARRAY_SIZE(req->bufsml))
-    req->bufs = uv__malloc(nbufs * sizeof(bufs[0]));
+    req->bufs = uv__loop_malloc(stream->loop,
+                                UV_ALLOC_STREAM,
+                                nbufs * sizeof(bufs[0]));
 
   if (req->bufs == NULL)
     return UV_ENOMEM;
@@ -1452,6 +2514,7 @@ int uv_write2(uv_write_t* req,
   req->nbufs = nbufs;
   req->write_index = 0;
   stream->write_queue_size += uv__count_bufs(bufs, nbufs);
+  UV__PROBE2(write__queue, stream, stream->write_queue_size);
 
   /* Append the request to write_queue. */
   QUEUE_INSERT_TAIL(&stream->write_queue, &req->queue);
@@ -1481,6 +2544,61 @@ int uv_write2(uv_write_t* req,
 }
 
 
+int uv_write2(uv_write_t* req,
+              uv_stream_t* stream,
+              const uv_buf_t bufs[],
+              unsigned int nbufs,
+              uv_stream_t* send_handle,
+              uv_write_cb cb) {
+  return uv__write2(req, stream, bufs, nbufs, send_handle, NULL, cb);
+}
+
+
+int uv_write_handles(uv_write_t* req,
+                     uv_stream_t* stream,
+                     const uv_buf_t bufs[],
+                     unsigned int nbufs,
+                     uv_stream_t* send_handles[],
+                     unsigned int nsend_handles,
+                     uv_write_cb cb) {
+  uv__write_handles_t* handles;
+  unsigned int i;
+  int err;
+
+  if (nsend_handles == 0)
+    return uv_write2(req, stream, bufs, nbufs, NULL, cb);
+
+  if (nsend_handles == 1)
+    return uv_write2(req, stream, bufs, nbufs, send_handles[0], cb);
+
+  /* The receiving end doesn't take more in one message. */
+  if (nsend_handles > UV__CMSG_FD_COUNT)
+    return UV_EINVAL;
+
+  for (i = 0; i < nsend_handles; i++)
+    if (uv__handle_fd((uv_handle_t*) send_handles[i]) < 0)
+      return UV_EBADF;
+
+  handles = uv__loop_malloc(stream->loop,
+                            UV_ALLOC_STREAM,
+                            sizeof(*handles) +
+                            (nsend_handles - 1) * sizeof(handles->handles[0]));
+  if (handles == NULL)
+    return UV_ENOMEM;
+
+  handles->count = nsend_handles;
+  memcpy(handles->handles,
+         send_handles,
+         nsend_handles * sizeof(handles->handles[0]));
+
+  err = uv__write2(req, stream, bufs, nbufs, send_handles[0], handles, cb);
+  if (err != 0)
+    uv__loop_free(stream->loop, handles);
+
+  return err;
+}
+
+
 /* The buffers to be written must remain valid until the callback is called.
  * This is not required for the uv_buf_t array.
  */
@@ -1526,12 +2644,13 @@ int uv_try_write(uv_stream_t* stream,
     req_size = 0;
   written -= req_size;
   stream->write_queue_size -= req_size;
+  UV__PROBE2(write__queue, stream, stream->write_queue_size);
 
   /* Unqueue request, regardless of immediateness */
   QUEUE_REMOVE(&req.queue);
   uv__req_unregister(stream->loop, &req);
   if (req.bufs != req.bufsml)
-    uv__free(req.bufs);
+    uv__loop_free(stream->loop, req.bufs);
   req.bufs = NULL;
 
   /* Do not poll for writable, if we wasn't before calling this */
@@ -1626,6 +2745,8 @@ int uv___stream_fd(const uv_stream_t* handle) {
 
 
 void uv__stream_close(uv_stream_t* handle) {
+  uv__loop_internal_fields_t* lfields;
+  uv__stream_admission_t* adm;
   unsigned int i;
   uv__stream_queued_fds_t* queued_fds;
 
@@ -1672,10 +2793,25 @@ void uv__stream_close(uv_stream_t* handle) {
     queued_fds = handle->queued_fds;
     for (i = 0; i < queued_fds->offset; i++)
       uv__close(queued_fds->fds[i]);
-    uv__free(handle->queued_fds);
+    uv__loop_free(handle->loop, handle->queued_fds);
     handle->queued_fds = NULL;
   }
 
+  lfields = uv__get_internal_fields(handle->loop);
+  if (handle->flags & UV_HANDLE_CONNECTION) {
+    handle->flags &= ~UV_HANDLE_CONNECTION;
+    lfields->connections--;
+  }
+
+  if (!QUEUE_EMPTY(&lfields->admissions)) {
+    adm = uv__stream_admission(handle);
+    if (adm != NULL)
+      uv__stream_admission_remove(adm);
+  }
+
+  if (handle->flags & UV_HANDLE_LISTEN_BATCH)
+    uv__stream_batch_remove(uv__stream_batch(handle));
+
   assert(!uv__io_active(&handle->io_watcher, POLLIN | POLLOUT));
 }
 
@@ -1686,3 +2822,242 @@ int uv_stream_set_blocking(uv_stream_t* handle, int blocking) {
    */
   return uv__nonblock(uv__stream_fd(handle), !blocking);
 }
+
+
+static uv__stream_migration_t* uv__stream_migration(uv_stream_t* stream) {
+  uv__loop_internal_fields_t* lfields;
+  uv__stream_migration_t* m;
+  QUEUE* q;
+
+  lfields = uv__get_internal_fields(stream->loop);
+  QUEUE_FOREACH(q, &lfields->stream_migrations) {
+    m = QUEUE_DATA(q, uv__stream_migration_t, queue);
+    if (m->stream == stream)
+      return m;
+  }
+
+  abort();  /* UV_HANDLE_MIGRATING without a pending migration. */
+  return NULL;
+}
+
+
+static void uv__stream_migrate_cancel(uv_stream_t* stream) {
+  uv__stream_migration_t* m;
+  uv_migrate_cb cb;
+
+  m = uv__stream_migration(stream);
+  QUEUE_REMOVE(&m->queue);
+  uv__req_unregister(stream->loop, m);
+  stream->flags &= ~UV_HANDLE_MIGRATING;
+
+  cb = m->cb;
+  uv__free(m);
+
+  if (cb != NULL)
+    cb(stream, UV_ECANCELED);
+}
+
+
+/* Runs on the target loop's thread. Move the write queue buffers into the
+ * target's allocator and resume where the source loop left off.
+ */
+static void uv__stream_migrate_done(struct uv__work* w, int status) {
+  uv__stream_migration_t* m;
+  uv_stream_t* stream;
+  uv_write_t* req;
+  uv_buf_t* bufs;
+  uv_loop_t* loop;
+  uv_migrate_cb cb;
+  size_t size;
+  QUEUE* queues[2];
+  QUEUE* q;
+  int i;
+
+  m = container_of(w, uv__stream_migration_t, work);
+  stream = m->stream;
+  loop = stream->loop;
+  assert(loop == m->target);
+  assert(status == 0);
+
+  queues[0] = &stream->write_queue;
+  queues[1] = &stream->write_completed_queue;
+
+  bufs = m->bufs;
+  for (i = 0; i < 2; i++) {
+    QUEUE_FOREACH(q, queues[i]) {
+      req = QUEUE_DATA(q, uv_write_t, queue);
+      uv__req_register(loop, req);
+
+      if (req->bufs == NULL || req->bufs == req->bufsml)
+        continue;
+
+      size = req->nbufs * sizeof(req->bufs[0]);
+      req->bufs = uv__loop_malloc(loop, UV_ALLOC_STREAM, size);
+      if (req->bufs == NULL)
+        abort();  /* The handle can't go back, the source may be gone. */
+      memcpy(req->bufs, bufs, size);
+      bufs += req->nbufs;
+    }
+  }
+  uv__free(m->bufs);
+
+  QUEUE_INSERT_TAIL(&loop->handle_queue, &stream->handle_queue);
+  if (m->active)
+    uv__handle_start(stream);
+
+  if (m->events & UV__POLLHIGHPRI)
+    uv__get_internal_fields(loop)->high_priority_watchers++;
+
+  if (stream->flags & UV_HANDLE_CONNECTION)
+    uv__get_internal_fields(loop)->connections++;
+
+  if (m->events & ~UV__POLLHIGHPRI)
+    uv__io_start(loop, &stream->io_watcher, m->events);
+
+  if (!QUEUE_EMPTY(&stream->write_completed_queue))
+    uv__io_feed(loop, &stream->io_watcher);
+
+  cb = m->cb;
+  uv__free(m);
+
+  if (cb != NULL)
+    cb(stream, 0);
+}
+
+
+/* Runs on the source loop's thread from uv__stream_io(), outside of any
+ * callback for this stream.
+ */
+static void uv__stream_migrate_detach(uv_stream_t* stream) {
+  uv__stream_migration_t* m;
+  uv_write_t* req;
+  uv_buf_t* bufs;
+  uv_loop_t* loop;
+  uv_migrate_cb cb;
+  size_t nbufs;
+  size_t size;
+  QUEUE* queues[2];
+  QUEUE* q;
+  int i;
+
+  loop = stream->loop;
+  m = uv__stream_migration(stream);
+  QUEUE_REMOVE(&m->queue);
+  uv__req_unregister(loop, m);
+  stream->flags &= ~UV_HANDLE_MIGRATING;
+
+  queues[0] = &stream->write_queue;
+  queues[1] = &stream->write_completed_queue;
+
+  /* The source's allocator is not thread-safe and the target may outlive it.
+   * Copy the loop-allocated buffer lists into one plain allocation for the
+   * trip, and do so before touching any state so failure is harmless.
+   */
+  nbufs = 0;
+  for (i = 0; i < 2; i++) {
+    QUEUE_FOREACH(q, queues[i]) {
+      req = QUEUE_DATA(q, uv_write_t, queue);
+      if (req->bufs != NULL && req->bufs != req->bufsml)
+        nbufs += req->nbufs;
+    }
+  }
+
+  m->bufs = NULL;
+  if (nbufs > 0) {
+    m->bufs = uv__malloc(nbufs * sizeof(*m->bufs));
+    if (m->bufs == NULL) {
+      cb = m->cb;
+      uv__free(m);
+      if (cb != NULL)
+        cb(stream, UV_ENOMEM);
+      return;
+    }
+  }
+
+  bufs = m->bufs;
+  for (i = 0; i < 2; i++) {
+    QUEUE_FOREACH(q, queues[i]) {
+      req = QUEUE_DATA(q, uv_write_t, queue);
+      uv__req_unregister(loop, req);
+
+      if (req->bufs == NULL || req->bufs == req->bufsml)
+        continue;
+
+      size = req->nbufs * sizeof(req->bufs[0]);
+      memcpy(bufs, req->bufs, size);
+      uv__loop_free(loop, req->bufs);
+      req->bufs = bufs;
+      bufs += req->nbufs;
+    }
+  }
+
+  m->events = stream->io_watcher.pevents;
+  uv__io_close(loop, &stream->io_watcher);
+
+  if (m->events & UV__POLLHIGHPRI)
+    uv__get_internal_fields(loop)->high_priority_watchers--;
+
+  if (stream->flags & UV_HANDLE_CONNECTION)
+    uv__get_internal_fields(loop)->connections--;
+
+  m->active = uv__is_active(stream);
+  uv__handle_stop(stream);
+  QUEUE_REMOVE(&stream->handle_queue);
+
+  stream->loop = m->target;
+  uv__work_post_done(m->target, &m->work, uv__stream_migrate_done);
+}
+
+
+int uv_stream_migrate(uv_stream_t* stream, uv_loop_t* loop, uv_migrate_cb cb) {
+  uv__loop_internal_fields_t* lfields;
+  uv__stream_migration_t* m;
+
+  if (loop == stream->loop)
+    return UV_EINVAL;
+
+  if (stream->type != UV_TCP && stream->type != UV_NAMED_PIPE)
+    return UV_EINVAL;
+
+  if (uv__is_closing(stream) || uv__stream_is_listening(stream))
+    return UV_EINVAL;
+
+  if (stream->type == UV_NAMED_PIPE && ((uv_pipe_t*) stream)->ipc)
+    return UV_ENOTSUP;
+
+  if (uv__stream_fd(stream) == -1)
+    return UV_ENOTCONN;
+
+#if defined(__APPLE__)
+  if (stream->select != NULL)
+    return UV_ENOTSUP;
+#endif /* defined(__APPLE__) */
+
+  /* Pooled buffers must go back to the loop they were read on. */
+  if (stream->flags & UV_HANDLE_MIGRATING ||
+      stream->connect_req != NULL ||
+      stream->shutdown_req != NULL ||
+      uv__stream_zerocopy_busy(stream) ||
+      uv__read_pool_reading(stream)) {
+    return UV_EBUSY;
+  }
+
+  m = uv__malloc(sizeof(*m));
+  if (m == NULL)
+    return UV_ENOMEM;
+
+  m->stream = stream;
+  m->target = loop;
+  m->cb = cb;
+
+  /* Detach from uv__stream_io() so that the stream isn't handed over while
+   * the source loop is still inside one of its callbacks.
+   */
+  lfields = uv__get_internal_fields(stream->loop);
+  QUEUE_INSERT_TAIL(&lfields->stream_migrations, &m->queue);
+  uv__req_register(stream->loop, m);
+  stream->flags |= UV_HANDLE_MIGRATING;
+  uv__io_feed(stream->loop, &stream->io_watcher);
+
+  return 0;
+}
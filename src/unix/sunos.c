@@ -112,15 +112,16 @@ int uv__io_fork(uv_loop_t* loop) {
 
 
 void uv__platform_invalidate_fd(uv_loop_t* loop, int fd) {
+  uv__loop_internal_fields_t* lfields;
   struct port_event* events;
   uintptr_t i;
   uintptr_t nfds;
 
-  assert(loop->watchers != NULL);
   assert(fd >= 0);
 
-  events = (struct port_event*) loop->watchers[loop->nwatchers];
-  nfds = (uintptr_t) loop->watchers[loop->nwatchers + 1];
+  lfields = uv__get_internal_fields(loop);
+  events = lfields->poll_events;
+  nfds = lfields->poll_nevents;
   if (events == NULL)
     return;
 
@@ -145,6 +146,7 @@ int uv__io_check_fd(uv_loop_t* loop, int fd) {
 
 
 void uv__io_poll(uv_loop_t* loop, int timeout) {
+  uv__loop_internal_fields_t* lfields;
   struct port_event events[1024];
   struct port_event* pe;
   struct timespec spec;
@@ -163,6 +165,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   int err;
   int fd;
 
+  lfields = uv__get_internal_fields(loop);
+
   if (loop->nfds == 0) {
     assert(QUEUE_EMPTY(&loop->watcher_queue));
     return;
@@ -179,7 +183,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     if (port_associate(loop->backend_fd,
                        PORT_SOURCE_FD,
                        w->fd,
-                       w->pevents,
+                       w->pevents & ~UV__POLLHIGHPRI,
                        0)) {
       perror("(libuv) port_associate()");
       abort();
@@ -214,11 +218,14 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     if (pset != NULL)
       pthread_sigmask(SIG_BLOCK, pset, NULL);
 
+    uv__trace_syscall(loop, UV__TRACE_POLL);
+    uv__epoch_offline(loop);
     err = port_getn(loop->backend_fd,
                     events,
                     ARRAY_SIZE(events),
                     &nfds,
                     timeout == -1 ? NULL : &spec);
+    SAVE_ERRNO(uv__epoch_online(loop));
 
     if (pset != NULL)
       pthread_sigmask(SIG_UNBLOCK, pset, NULL);
@@ -259,9 +266,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     have_signals = 0;
     nevents = 0;
 
-    assert(loop->watchers != NULL);
-    loop->watchers[loop->nwatchers] = (void*) events;
-    loop->watchers[loop->nwatchers + 1] = (void*) (uintptr_t) nfds;
+    lfields->poll_events = events;
+    lfields->poll_nevents = nfds;
     for (i = 0; i < nfds; i++) {
       pe = events + i;
       fd = pe->portev_object;
@@ -271,9 +277,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         continue;
 
       assert(fd >= 0);
-      assert((unsigned) fd < loop->nwatchers);
 
-      w = loop->watchers[fd];
+      w = uv__io_watcher(loop, fd);
 
       /* File descriptor that we've stopped watching, ignore. */
       if (w == NULL)
@@ -282,14 +287,17 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       /* Run signal watchers last.  This also affects child process watchers
        * because those are implemented in terms of signal watchers.
        */
-      if (w == &loop->signal_io_watcher)
+      if (w == &loop->signal_io_watcher) {
         have_signals = 1;
-      else
+      } else {
+        uv__loop_dispatch(loop, NULL, w->cb);
         w->cb(loop, w, pe->portev_events);
+        uv__defer_run(loop);
+      }
 
       nevents++;
 
-      if (w != loop->watchers[fd])
+      if (w != uv__io_watcher(loop, fd))
         continue;  /* Disabled by callback. */
 
       /* Events Ports operates in oneshot mode, rearm timer on next run. */
@@ -297,17 +305,21 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         QUEUE_INSERT_TAIL(&loop->watcher_queue, &w->watcher_queue);
     }
 
-    if (have_signals != 0)
+    if (have_signals != 0) {
+      uv__loop_dispatch(loop, NULL, loop->signal_io_watcher.cb);
       loop->signal_io_watcher.cb(loop, &loop->signal_io_watcher, POLLIN);
+    }
 
-    loop->watchers[loop->nwatchers] = NULL;
-    loop->watchers[loop->nwatchers + 1] = NULL;
+    lfields->poll_events = NULL;
+    lfields->poll_nevents = 0;
 
     if (have_signals != 0)
       return;  /* Event loop should cycle now so don't poll again. */
 
     if (nevents != 0) {
-      if (nfds == ARRAY_SIZE(events) && --count != 0) {
+      if (nfds == ARRAY_SIZE(events) &&
+          --count != 0 &&
+          !uv__loop_over_budget(loop)) {
         /* Poll for more events but don't block this time. */
         timeout = 0;
         continue;
@@ -384,6 +396,12 @@ uint64_t uv_get_constrained_memory(void) {
   return 0;  /* Memory constraints are unknown. */
 }
 
+int uv_cpu_topology(uv_cpu_topology_t** cpus, int* count) {
+  *cpus = NULL;
+  *count = 0;
+  return UV_ENOSYS;
+}
+
 
 void uv_loadavg(double avg[3]) {
   (void) getloadavg(avg, 3);
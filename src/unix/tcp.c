@@ -27,6 +27,13 @@
 #include <assert.h>
 #include <errno.h>
 
+#if defined(__linux__)
+# include <linux/filter.h>
+# ifndef SO_ATTACH_REUSEPORT_CBPF
+#  define SO_ATTACH_REUSEPORT_CBPF 51
+# endif
+#endif
+
 
 static int new_socket(uv_tcp_t* handle, int domain, unsigned long flags) {
   struct sockaddr_storage saddr;
@@ -145,6 +152,33 @@ int uv_tcp_init(uv_loop_t* loop, uv_tcp_t* tcp) {
 }
 
 
+/* Only enabled where the kernel spreads connections over the sockets in the
+ * group. Elsewhere, SO_REUSEPORT lets sockets share the address but hands
+ * all connections to one of them.
+ */
+static int uv__tcp_reuseport(int fd) {
+#if defined(__linux__) && defined(SO_REUSEPORT)
+  int on;
+
+  on = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)))
+    return UV__ERR(errno);
+
+  return 0;
+#elif defined(SO_REUSEPORT_LB)
+  int on;
+
+  on = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT_LB, &on, sizeof(on)))
+    return UV__ERR(errno);
+
+  return 0;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
 int uv__tcp_bind(uv_tcp_t* tcp,
                  const struct sockaddr* addr,
                  unsigned int addrlen,
@@ -164,6 +198,12 @@ int uv__tcp_bind(uv_tcp_t* tcp,
   if (setsockopt(tcp->io_watcher.fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)))
     return UV__ERR(errno);
 
+  if (flags & UV_TCP_REUSEPORT) {
+    err = uv__tcp_reuseport(tcp->io_watcher.fd);
+    if (err)
+      return err;
+  }
+
 #ifndef __OpenBSD__
 #ifdef IPV6_V6ONLY
   if (addr->sa_family == AF_INET6) {
@@ -344,7 +384,7 @@ int uv_tcp_listen(uv_tcp_t* tcp, int backlog, uv_connection_cb cb) {
 
   /* Start listening for connections. */
   tcp->io_watcher.cb = uv__server_io;
-  uv__io_start(tcp->loop, &tcp->io_watcher, POLLIN);
+  uv__server_io_start((uv_stream_t*) tcp);
 
   return 0;
 }
@@ -428,6 +468,69 @@ int uv_tcp_simultaneous_accepts(uv_tcp_t* handle, int enable) {
 }
 
 
+int uv_tcp_reuseport_steer_cpu(uv_tcp_t* handle) {
+#if defined(__linux__)
+  /* A = the CPU that received the packet; return A. The kernel falls back to
+   * hashing when A is not a valid index into the group.
+   */
+  static struct sock_filter code[] = {
+    { BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+    { BPF_RET | BPF_A, 0, 0, 0 },
+  };
+  struct sock_fprog prog;
+
+  if (uv__stream_fd(handle) == -1)
+    return UV_EINVAL;
+
+  prog.len = ARRAY_SIZE(code);
+  prog.filter = code;
+
+  if (setsockopt(uv__stream_fd(handle),
+                 SOL_SOCKET,
+                 SO_ATTACH_REUSEPORT_CBPF,
+                 &prog,
+                 sizeof(prog))) {
+    return UV__ERR(errno);
+  }
+
+  return 0;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
+int uv_tcp_exclusive_accept(uv_tcp_t* handle, int enable) {
+  if (UV__POLLEXCLUSIVE == 0)
+    return UV_ENOTSUP;
+
+  if (enable)
+    handle->flags |= UV_HANDLE_TCP_EXCLUSIVE_ACCEPT;
+  else
+    handle->flags &= ~UV_HANDLE_TCP_EXCLUSIVE_ACCEPT;
+
+  /* The backend only picks up the change when the file descriptor is
+   * registered anew.
+   */
+  if (uv__io_active(&handle->io_watcher, POLLIN)) {
+    uv__io_stop(handle->loop,
+                &handle->io_watcher,
+                POLLIN | UV__POLLEXCLUSIVE);
+    uv__server_io_start((uv_stream_t*) handle);
+  }
+
+  return 0;
+}
+
+
+int uv_tcp_zerocopy(uv_tcp_t* handle, int enable, size_t min_size) {
+  if (uv__is_closing(handle))
+    return UV_EINVAL;
+
+  return uv__stream_zerocopy_set((uv_stream_t*) handle, enable, min_size);
+}
+
+
 void uv__tcp_close(uv_tcp_t* handle) {
   uv__stream_close((uv_stream_t*)handle);
 }
@@ -41,6 +41,10 @@
 #include <gnu/libc-version.h>  /* gnu_get_libc_version() */
 #endif
 
+#ifdef __linux__
+#include <sched.h>  /* sched_setaffinity() */
+#endif
+
 #undef NANOSEC
 #define NANOSEC ((uint64_t) 1e9)
 
@@ -258,6 +262,27 @@ int uv_thread_equal(const uv_thread_t* t1, const uv_thread_t* t2) {
 }
 
 
+int uv__thread_pin_self(int cpu) {
+#if defined(__linux__) && defined(CPU_SET)
+  cpu_set_t set;
+
+  if (cpu < 0 || cpu >= CPU_SETSIZE)
+    return UV_EINVAL;
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+
+  /* Applies to the calling thread only. */
+  if (sched_setaffinity(0, sizeof(set), &set))
+    return UV__ERR(errno);
+
+  return 0;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
 int uv_mutex_init(uv_mutex_t* mutex) {
 #if defined(NDEBUG) || !defined(PTHREAD_MUTEX_ERRORCHECK)
   return UV__ERR(pthread_mutex_init(mutex, NULL));
@@ -107,7 +107,7 @@ static void uv__udp_run_completed(uv_udp_t* handle) {
     handle->send_queue_count--;
 
     if (req->bufs != req->bufsml)
-      uv__free(req->bufs);
+      uv__loop_free(handle->loop, req->bufs);
     req->bufs = NULL;
 
     if (req->send_cb == NULL)
@@ -138,6 +138,7 @@ static void uv__udp_io(uv_loop_t* loop, uv__io_t* w, unsigned int revents) {
 
   handle = container_of(w, uv_udp_t, io_watcher);
   assert(handle->type == UV_UDP);
+  uv__loop_dispatch_handle(loop, handle);
 
   if (revents & POLLIN)
     uv__udp_recvmsg(handle);
@@ -170,7 +171,11 @@ static void uv__udp_recvmsg(uv_udp_t* handle) {
 
   do {
     buf = uv_buf_init(NULL, 0);
-    handle->alloc_cb((uv_handle_t*) handle, 64 * 1024, &buf);
+    handle->alloc_cb((uv_handle_t*) handle,
+                     uv__read_size_suggest((uv_handle_t*) handle,
+                                           handle->io_watcher.fd,
+                                           1),
+                     &buf);
     if (buf.base == NULL || buf.len == 0) {
       handle->recv_cb(handle, UV_ENOBUFS, &buf, NULL, 0);
       return;
@@ -181,6 +186,7 @@ static void uv__udp_recvmsg(uv_udp_t* handle) {
     h.msg_iov = (void*) &buf;
     h.msg_iovlen = 1;
 
+    uv__trace_syscall(handle->loop, UV__TRACE_RECV);
     do {
       nread = recvmsg(handle->io_watcher.fd, &h, 0);
     }
@@ -247,6 +253,7 @@ static void uv__udp_sendmsg(uv_udp_t* handle) {
     h.msg_iov = (struct iovec*) req->bufs;
     h.msg_iovlen = req->nbufs;
 
+    uv__trace_syscall(handle->loop, UV__TRACE_SEND);
     do {
       size = sendmsg(handle->io_watcher.fd, &h, 0);
     } while (size == -1 && errno == EINTR);
@@ -491,7 +498,9 @@ int uv__udp_send(uv_udp_send_t* req,
 
   req->bufs = req->bufsml;
   if (nbufs > ARRAY_SIZE(req->bufsml))
-    req->bufs = uv__malloc(nbufs * sizeof(bufs[0]));
+    req->bufs = uv__loop_malloc(handle->loop,
+                                UV_ALLOC_UDP,
+                                nbufs * sizeof(bufs[0]));
 
   if (req->bufs == NULL) {
     uv__req_unregister(handle->loop, req);
@@ -550,6 +559,7 @@ int uv__udp_try_send(uv_udp_t* handle,
   h.msg_iov = (struct iovec*) bufs;
   h.msg_iovlen = nbufs;
 
+  uv__trace_syscall(handle->loop, UV__TRACE_SEND);
   do {
     size = sendmsg(handle->io_watcher.fd, &h, 0);
   } while (size == -1 && errno == EINTR);
@@ -686,6 +696,7 @@ int uv_udp_init_ex(uv_loop_t* loop, uv_udp_t* handle, unsigned int flags) {
   handle->recv_cb = NULL;
   handle->send_queue_size = 0;
   handle->send_queue_count = 0;
+  uv__read_size_init((uv_handle_t*) handle);
   uv__io_init(&handle->io_watcher, uv__udp_io, fd);
   QUEUE_INIT(&handle->write_queue);
   QUEUE_INIT(&handle->write_completed_queue);
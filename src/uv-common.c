@@ -117,6 +117,296 @@ int uv_replace_allocator(uv_malloc_func malloc_func,
   return 0;
 }
 
+static void* uv__loop_alloc_malloc(uv__loop_alloc_t* alloc, size_t size) {
+  void* ptr;
+
+  if (size == 0)
+    return NULL;
+
+  if (alloc->malloc_func == NULL)
+    ptr = uv__malloc(size);
+  else
+    ptr = alloc->malloc_func(alloc->ctx, size);
+
+  if (ptr != NULL)
+    alloc->count++;
+
+  return ptr;
+}
+
+static void uv__loop_alloc_free(uv__loop_alloc_t* alloc, void* ptr) {
+  int saved_errno;
+
+  if (ptr == NULL)
+    return;
+
+  assert(alloc->count > 0);
+  alloc->count--;
+
+  if (alloc->free_func == NULL) {
+    uv__free(ptr);
+    return;
+  }
+
+  /* Same errno guarantee as uv__free(). */
+  saved_errno = errno;
+  alloc->free_func(alloc->ctx, ptr);
+  errno = saved_errno;
+}
+
+static void* uv__loop_alloc_realloc(uv__loop_alloc_t* alloc,
+                                    void* ptr,
+                                    size_t size) {
+  if (alloc->realloc_func == NULL)
+    return uv__realloc(ptr, size);
+  return alloc->realloc_func(alloc->ctx, ptr, size);
+}
+
+#if defined(UV_ALLOC_STATS)
+/* Precedes every loop allocation so that frees can be attributed. Padded so
+ * the memory that follows it is suitably aligned for any type.
+ */
+typedef union {
+  struct {
+    size_t size;
+    uv_alloc_subsystem subsystem;
+  } s;
+  double align_d;
+  void* align_p;
+  char pad[16];
+} uv__alloc_header_t;
+
+static void uv__alloc_stats_add(uv__loop_internal_fields_t* lfields,
+                                uv_alloc_subsystem subsystem,
+                                size_t size) {
+  uv_alloc_stats_t* stats;
+
+  stats = &lfields->alloc_stats[subsystem];
+  stats->bytes += size;
+  stats->objects++;
+
+  if (stats->peak_bytes < stats->bytes)
+    stats->peak_bytes = stats->bytes;
+  if (stats->peak_objects < stats->objects)
+    stats->peak_objects = stats->objects;
+}
+
+static void uv__alloc_stats_sub(uv__loop_internal_fields_t* lfields,
+                                uv_alloc_subsystem subsystem,
+                                size_t size) {
+  uv_alloc_stats_t* stats;
+
+  stats = &lfields->alloc_stats[subsystem];
+  assert(stats->bytes >= size);
+  assert(stats->objects > 0);
+  stats->bytes -= size;
+  stats->objects--;
+}
+#endif  /* defined(UV_ALLOC_STATS) */
+
+/* Stops accounting for `ptr` and returns the pointer that the allocator
+ * handed out for it.
+ */
+static void* uv__loop_alloc_untrack(uv__loop_internal_fields_t* lfields,
+                                    void* ptr) {
+#if defined(UV_ALLOC_STATS)
+  uv__alloc_header_t* header;
+
+  if (ptr == NULL)
+    return NULL;
+
+  header = (uv__alloc_header_t*) ptr - 1;
+  uv__alloc_stats_sub(lfields, header->s.subsystem, header->s.size);
+  return header;
+#else
+  return ptr;
+#endif
+}
+
+void* uv__loop_malloc(uv_loop_t* loop,
+                      uv_alloc_subsystem subsystem,
+                      size_t size) {
+  uv__loop_internal_fields_t* lfields;
+#if defined(UV_ALLOC_STATS)
+  uv__alloc_header_t* header;
+#endif
+
+  lfields = uv__get_internal_fields(loop);
+
+#if defined(UV_ALLOC_STATS)
+  if (size == 0)
+    return NULL;
+
+  header = uv__loop_alloc_malloc(&lfields->alloc, sizeof(*header) + size);
+  if (header == NULL)
+    return NULL;
+
+  header->s.size = size;
+  header->s.subsystem = subsystem;
+  uv__alloc_stats_add(lfields, subsystem, size);
+
+  return header + 1;
+#else
+  (void) subsystem;
+  return uv__loop_alloc_malloc(&lfields->alloc, size);
+#endif
+}
+
+void* uv__loop_realloc(uv_loop_t* loop,
+                       uv_alloc_subsystem subsystem,
+                       void* ptr,
+                       size_t size) {
+  uv__loop_internal_fields_t* lfields;
+#if defined(UV_ALLOC_STATS)
+  uv__alloc_header_t* header;
+#endif
+
+  if (ptr == NULL)
+    return uv__loop_malloc(loop, subsystem, size);
+
+  if (size == 0) {
+    uv__loop_free(loop, ptr);
+    return NULL;
+  }
+
+  lfields = uv__get_internal_fields(loop);
+
+#if defined(UV_ALLOC_STATS)
+  header = (uv__alloc_header_t*) ptr - 1;
+  header = uv__loop_alloc_realloc(&lfields->alloc,
+                                  header,
+                                  sizeof(*header) + size);
+  if (header == NULL)
+    return NULL;
+
+  uv__alloc_stats_sub(lfields, header->s.subsystem, header->s.size);
+  header->s.size = size;
+  header->s.subsystem = subsystem;
+  uv__alloc_stats_add(lfields, subsystem, size);
+
+  return header + 1;
+#else
+  (void) subsystem;
+  return uv__loop_alloc_realloc(&lfields->alloc, ptr, size);
+#endif
+}
+
+void uv__loop_free(uv_loop_t* loop, void* ptr) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  uv__loop_alloc_free(&lfields->alloc, uv__loop_alloc_untrack(lfields, ptr));
+}
+
+void uv__loop_alloc_release(uv_loop_t* loop,
+                            uv__loop_alloc_t* alloc,
+                            void* ptr) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  uv__loop_alloc_free(alloc, uv__loop_alloc_untrack(lfields, ptr));
+}
+
+#if defined(UV_ALLOC_STATS)
+void uv__loop_alloc_charge(uv_loop_t* loop,
+                           uv_alloc_subsystem subsystem,
+                           size_t size) {
+  if (size != 0)
+    uv__alloc_stats_add(uv__get_internal_fields(loop), subsystem, size);
+}
+
+void uv__loop_alloc_uncharge(uv_loop_t* loop,
+                             uv_alloc_subsystem subsystem,
+                             size_t size) {
+  if (size != 0)
+    uv__alloc_stats_sub(uv__get_internal_fields(loop), subsystem, size);
+}
+#endif
+
+char* uv__loop_strdup(uv_loop_t* loop,
+                      uv_alloc_subsystem subsystem,
+                      const char* s) {
+  size_t len = strlen(s) + 1;
+  char* m = uv__loop_malloc(loop, subsystem, len);
+  if (m == NULL)
+    return NULL;
+  return memcpy(m, s, len);
+}
+
+void uv__loop_alloc_close(uv_loop_t* loop) {
+  uv__loop_alloc_t* alloc;
+
+  alloc = &uv__get_internal_fields(loop)->alloc;
+  if (alloc->close_func != NULL)
+    alloc->close_func(alloc->ctx);
+
+  memset(alloc, 0, sizeof(*alloc));
+}
+
+int uv_loop_replace_allocator(uv_loop_t* loop,
+                              void* ctx,
+                              uv_loop_malloc_func malloc_func,
+                              uv_loop_realloc_func realloc_func,
+                              uv_loop_free_func free_func) {
+  uv__loop_internal_fields_t* lfields;
+  uv__loop_alloc_t prev;
+  size_t nmoved;
+  int err;
+
+  /* Either all or none of the functions must be set. */
+  if ((malloc_func == NULL) != (realloc_func == NULL) ||
+      (malloc_func == NULL) != (free_func == NULL)) {
+    return UV_EINVAL;
+  }
+
+  /* The watcher table is allocated by uv_loop_init() and is moved over.
+   * Anything else can't be returned to the new allocator.
+   */
+  nmoved = 0;
+#ifndef _WIN32
+  nmoved = uv__io_table_allocs(loop);
+#endif
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->alloc.count != nmoved)
+    return UV_EBUSY;
+
+  prev = lfields->alloc;
+  memset(&lfields->alloc, 0, sizeof(lfields->alloc));
+  lfields->alloc.ctx = ctx;
+  lfields->alloc.malloc_func = malloc_func;
+  lfields->alloc.realloc_func = realloc_func;
+  lfields->alloc.free_func = free_func;
+
+  err = 0;
+#ifndef _WIN32
+  err = uv__io_table_move(loop, &prev);
+#endif
+  if (err) {
+    lfields->alloc = prev;
+    return err;
+  }
+
+  if (prev.close_func != NULL)
+    prev.close_func(prev.ctx);
+
+  return 0;
+}
+
+int uv_loop_alloc_stats(const uv_loop_t* loop,
+                        uv_alloc_subsystem subsystem,
+                        uv_alloc_stats_t* stats) {
+#if defined(UV_ALLOC_STATS)
+  if ((unsigned int) subsystem >= UV_ALLOC_SUBSYSTEM_MAX)
+    return UV_EINVAL;
+
+  *stats = uv__get_internal_fields(loop)->alloc_stats[subsystem];
+  return 0;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
 #define XX(uc, lc) case UV_##uc: return sizeof(uv_##lc##_t);
 
 size_t uv_handle_size(uv_handle_type type) {
@@ -138,6 +428,95 @@ size_t uv_req_size(uv_req_type type) {
 #undef XX
 
 
+static uv_alloc_subsystem uv__req_subsystem(uv_req_type type) {
+  switch (type) {
+    case UV_WRITE:
+    case UV_CONNECT:
+    case UV_SHUTDOWN:
+      return UV_ALLOC_STREAM;
+    case UV_UDP_SEND:
+      return UV_ALLOC_UDP;
+    case UV_FS:
+      return UV_ALLOC_FS;
+    case UV_GETADDRINFO:
+    case UV_GETNAMEINFO:
+      return UV_ALLOC_DNS;
+    default:
+      return UV_ALLOC_LOOP;
+  }
+}
+
+
+uv_req_t* uv_req_acquire(uv_loop_t* loop, uv_req_type type) {
+  uv__loop_internal_fields_t* lfields;
+  uv_req_t* req;
+  size_t size;
+
+  size = uv_req_size(type);
+  if (size == (size_t) -1)
+    return NULL;
+
+  lfields = uv__get_internal_fields(loop);
+  req = lfields->req_pools[type].head;
+
+  if (req != NULL) {
+    lfields->req_pools[type].head = req->data;
+    lfields->req_pools[type].count--;
+  } else {
+    /* Zeroed so that releasing a request that was never used is safe. */
+    req = uv__loop_malloc(loop, uv__req_subsystem(type), size);
+    if (req == NULL)
+      return NULL;
+    memset(req, 0, size);
+  }
+
+  req->data = NULL;
+  req->type = type;
+
+  return req;
+}
+
+
+void uv_req_release(uv_loop_t* loop, uv_req_t* req) {
+  uv__loop_internal_fields_t* lfields;
+  uv_req_type type;
+
+  type = req->type;
+  assert(uv_req_size(type) != (size_t) -1);
+
+  if (type == UV_FS)
+    uv_fs_req_cleanup((uv_fs_t*) req);
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->req_pools[type].count == UV__REQ_POOL_MAX) {
+    uv__loop_free(loop, req);
+    return;
+  }
+
+  req->data = lfields->req_pools[type].head;
+  lfields->req_pools[type].head = req;
+  lfields->req_pools[type].count++;
+}
+
+
+static void uv__req_pools_close(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  uv_req_t* req;
+  int type;
+
+  lfields = uv__get_internal_fields(loop);
+
+  for (type = 0; type < UV_REQ_TYPE_MAX; type++) {
+    while (lfields->req_pools[type].head != NULL) {
+      req = lfields->req_pools[type].head;
+      lfields->req_pools[type].head = req->data;
+      uv__loop_free(loop, req);
+    }
+    lfields->req_pools[type].count = 0;
+  }
+}
+
+
 size_t uv_loop_size(void) {
   return sizeof(uv_loop_t);
 }
@@ -705,7 +1084,14 @@ int uv_loop_configure(uv_loop_t* loop, uv_loop_option option, ...) {
 
   va_start(ap, option);
   /* Any platform-agnostic options should be handled here. */
-  err = uv__loop_configure(loop, option, ap);
+  if (option == UV_LOOP_USE_ARENA)
+    err = uv__arena_init(loop);
+  else if (option == UV_LOOP_IDLE_TASK_BUDGET)
+    err = uv__idle_task_budget(loop, va_arg(ap, unsigned int));
+  else if (option == UV_LOOP_READ_POOL)
+    err = uv__read_pool_configure(loop, ap);
+  else
+    err = uv__loop_configure(loop, option, ap);
   va_end(ap);
 
   return err;
@@ -751,7 +1137,7 @@ int uv_loop_close(uv_loop_t* loop) {
   void* saved_data;
 #endif
 
-  if (uv__has_active_reqs(loop))
+  if (uv__has_active_reqs(loop) || uv__has_deferred(loop))
     return UV_EBUSY;
 
   QUEUE_FOREACH(q, &loop->handle_queue) {
@@ -760,6 +1146,12 @@ int uv_loop_close(uv_loop_t* loop) {
       return UV_EBUSY;
   }
 
+  uv__watchdog_loop_close(loop);
+  uv__trace_loop_close(loop);
+  uv__epoch_loop_close(loop);
+  uv__req_pools_close(loop);
+  uv__defer_loop_close(loop);
+  uv__read_pool_loop_close(loop);
   uv__loop_close(loop);
 
 #ifndef NDEBUG
@@ -786,3 +1178,9 @@ void uv_loop_delete(uv_loop_t* loop) {
   if (loop != default_loop)
     uv__free(loop);
 }
+
+
+void uv_free_cpu_topology(uv_cpu_topology_t* cpus, int count) {
+  (void) count;
+  uv__free(cpus);
+}
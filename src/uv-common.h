@@ -57,9 +57,223 @@ extern int snprintf(char*, size_t, const char*, ...);
 #define container_of(ptr, type, member) \
   ((type *) ((char *) (ptr) - offsetof(type, member)))
 
+/* Relaxed loads and stores, and fences to order them, for state that is
+ * written by the loop thread and sampled by other threads.
+ */
+#if defined(__ATOMIC_RELAXED)
+# define uv__atomic_load(type, var) __atomic_load_n(&(var), __ATOMIC_RELAXED)
+# define uv__atomic_store(type, var, val)                                     \
+  __atomic_store_n(&(var), (val), __ATOMIC_RELAXED)
+# define uv__atomic_fence_acquire() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+# define uv__atomic_fence_release() __atomic_thread_fence(__ATOMIC_RELEASE)
+#else
+# define uv__atomic_load(type, var) (*(type volatile*) &(var))
+# define uv__atomic_store(type, var, val) (*(type volatile*) &(var) = (val))
+# if defined(_M_IX86) || defined(_M_X64)
+/* x86 doesn't reorder loads with loads or stores with stores. */
+#  define uv__atomic_fence_acquire() _ReadWriteBarrier()
+#  define uv__atomic_fence_release() _ReadWriteBarrier()
+# elif defined(_WIN32)
+#  define uv__atomic_fence_acquire() MemoryBarrier()
+#  define uv__atomic_fence_release() MemoryBarrier()
+# else
+#  define uv__atomic_fence_acquire() __sync_synchronize()
+#  define uv__atomic_fence_release() __sync_synchronize()
+# endif
+#endif
+
 #define STATIC_ASSERT(expr)                                                   \
   void uv__static_assert(int static_assert_failed[1 - 2 * !(expr)])
 
+typedef struct uv__loop_alloc_s uv__loop_alloc_t;
+typedef struct uv__loop_internal_fields_s uv__loop_internal_fields_t;
+typedef struct uv__read_pool_s uv__read_pool_t;
+typedef void (*uv__watch_cb_t)(void);
+
+struct uv__loop_alloc_s {
+  void* ctx;
+  uv_loop_malloc_func malloc_func;  /* NULL means use uv__malloc(). */
+  uv_loop_realloc_func realloc_func;
+  uv_loop_free_func free_func;
+  void (*close_func)(void* ctx);  /* Set by allocators libuv owns. */
+  size_t count;  /* Outstanding allocations. */
+};
+
+/* Released requests are linked through their data field. */
+#define UV__REQ_POOL_MAX 1024
+
+struct uv__loop_internal_fields_s {
+  QUEUE epoch_records;  /* uv_epoch_t domains this loop participates in. */
+  int epoch_online;  /* Inside uv_run() and not polling. */
+  uv__loop_alloc_t alloc;
+  /* What the loop is running, sampled by the watchdog thread. Written by the
+   * loop thread without locking, see uv__loop_watch(). watch_seq changes on
+   * every dispatch so the watchdog can tell a stuck loop from a busy one and
+   * detect torn reads. The watchdog never dereferences watch_handle, a close
+   * callback may have freed it, so the type is recorded separately.
+   */
+  struct uv__watchdog_s* watchdog;
+  uv_handle_t* watch_handle;
+  uv_handle_type watch_type;
+  uv__watch_cb_t watch_cb;
+  unsigned int watch_seq;
+  int watch_idle;  /* Waiting for events or not running at all. */
+  /* Allocated by the first uv_loop_trace_start() and kept until the loop is
+   * closed because threadpool threads may still be looking at it. Both are
+   * published with uv__atomic_store() after a release fence.
+   */
+  struct uv__trace_s* trace;
+  int tracing;
+  QUEUE idle_tasks;  /* Queued uv_idle_task_t. */
+  unsigned int idle_task_budget;  /* Milliseconds, 0 for the default. */
+  /* Ring of uv_defer() callbacks, `defer_size` is zero or a power of two. */
+  struct uv__defer_s* defer_ring;
+  unsigned int defer_head;
+  unsigned int defer_count;
+  unsigned int defer_size;
+  uv__read_pool_t* read_pool;  /* Created on first use, see read-pool.c. */
+#ifndef _WIN32
+  /* Events uv__io_poll() is dispatching, see uv__platform_invalidate_fd(). */
+  void* poll_events;
+  unsigned int poll_nevents;
+  QUEUE stream_migrations;  /* Pending uv_stream_migrate() requests. */
+  unsigned int high_priority_watchers;  /* Watchers with UV__POLLHIGHPRI. */
+  uint64_t time_budget;  /* UV_LOOP_TIME_BUDGET in nanoseconds, 0 if unset. */
+  uint64_t iter_deadline;  /* uv__hrtime() at which to yield, 0 if never. */
+  /* Events the last uv__io_poll() had no time left to dispatch. */
+  void* poll_carry;
+  unsigned int poll_ncarry;
+  QUEUE admissions;  /* Servers with uv_listen_set_admission() limits. */
+  unsigned int admission_paused;  /* Servers that stopped accepting. */
+  QUEUE accept_batches;  /* Servers started with uv_listen_batch(). */
+  unsigned int connections;  /* Accepted streams that are still open. */
+  uint64_t loop_lag;  /* Milliseconds from the last poll to the next. */
+  uint64_t poll_time;  /* loop->time when uv__io_poll() last returned. */
+#endif
+#if defined(UV_ALLOC_STATS)
+  uv_alloc_stats_t alloc_stats[UV_ALLOC_SUBSYSTEM_MAX];
+#endif
+  struct {
+    uv_req_t* head;
+    unsigned int count;
+  } req_pools[UV_REQ_TYPE_MAX];
+};
+
+#define uv__get_internal_fields(loop)                                         \
+  ((uv__loop_internal_fields_t*) (loop)->internal_fields)
+
+enum uv__loop_phase {
+  UV__LOOP_PHASE_NONE,  /* Not inside uv_run(). */
+  UV__LOOP_PHASE_TIMERS,
+  UV__LOOP_PHASE_PENDING,
+  UV__LOOP_PHASE_IDLE,
+  UV__LOOP_PHASE_PREPARE,
+  UV__LOOP_PHASE_POLL,
+  UV__LOOP_PHASE_CHECK,
+  UV__LOOP_PHASE_CLOSING,
+  UV__LOOP_PHASE_MAX
+};
+
+/* Writer side of the sequence lock that the watchdog thread samples the
+ * watch_* fields through: watch_seq is odd while they're being updated.
+ */
+#define uv__loop_watch(lfields, h, type, fn, idle)                            \
+  do {                                                                        \
+    unsigned int seq_ = (lfields)->watch_seq;                                 \
+    uv__atomic_store(unsigned int, (lfields)->watch_seq, seq_ + 1);           \
+    uv__atomic_fence_release();                                               \
+    uv__atomic_store(uv_handle_t*, (lfields)->watch_handle, (h));             \
+    uv__atomic_store(uv_handle_type, (lfields)->watch_type, (type));          \
+    uv__atomic_store(uv__watch_cb_t, (lfields)->watch_cb, (fn));              \
+    uv__atomic_store(int, (lfields)->watch_idle, (idle));                     \
+    uv__atomic_fence_release();                                               \
+    uv__atomic_store(unsigned int, (lfields)->watch_seq, seq_ + 2);           \
+  }                                                                           \
+  while (0)
+
+#define uv__loop_watch_type(h)                                                \
+  ((h) != NULL ? ((uv_handle_t*) (h))->type : UV_UNKNOWN_HANDLE)
+
+/* uv_run() calls uv__loop_phase() when it moves on to the next phase and
+ * dispatch points call uv__loop_dispatch() right before running a callback.
+ * `h` may be NULL when the dispatch point doesn't know the handle, the
+ * callback can fill it in with uv__loop_dispatch_handle(). Both feed the
+ * watchdog and, when it's on, the trace recorder.
+ */
+#define uv__loop_phase(loop, phase)                                           \
+  do {                                                                        \
+    uv__loop_internal_fields_t* lfields_ = uv__get_internal_fields(loop);     \
+    if (lfields_->tracing)                                                    \
+      uv__trace_phase((loop), (phase));                                       \
+    uv__loop_watch(lfields_,                                                  \
+                   NULL,                                                      \
+                   UV_UNKNOWN_HANDLE,                                         \
+                   NULL,                                                      \
+                   (phase) == UV__LOOP_PHASE_POLL ||                          \
+                   (phase) == UV__LOOP_PHASE_NONE);                           \
+  }                                                                           \
+  while (0)
+
+#define uv__loop_dispatch(loop, h, fn)                                        \
+  do {                                                                        \
+    uv__loop_internal_fields_t* lfields_ = uv__get_internal_fields(loop);     \
+    if (lfields_->tracing)                                                    \
+      uv__trace_dispatch((loop), (uv_handle_t*) (h));                         \
+    uv__loop_watch(lfields_,                                                  \
+                   (uv_handle_t*) (h),                                        \
+                   uv__loop_watch_type(h),                                    \
+                   (uv__watch_cb_t) (fn),                                     \
+                   0);                                                        \
+  }                                                                           \
+  while (0)
+
+#define uv__loop_dispatch_handle(loop, h)                                     \
+  do {                                                                        \
+    uv__loop_internal_fields_t* lfields_ = uv__get_internal_fields(loop);     \
+    if (lfields_->tracing)                                                    \
+      uv__trace_handle((loop), (uv_handle_t*) (h));                           \
+    uv__loop_watch(lfields_,                                                  \
+                   (uv_handle_t*) (h),                                        \
+                   uv__loop_watch_type(h),                                    \
+                   lfields_->watch_cb,                                        \
+                   0);                                                        \
+  }                                                                           \
+  while (0)
+
+/* Syscalls counted by the trace recorder. */
+enum uv__trace_syscall {
+  UV__TRACE_POLL,
+  UV__TRACE_READ,
+  UV__TRACE_WRITE,
+  UV__TRACE_ACCEPT,
+  UV__TRACE_RECV,
+  UV__TRACE_SEND,
+  UV__TRACE_SYSCALL_MAX
+};
+
+#define uv__trace_syscall(loop, what)                                         \
+  do {                                                                        \
+    if (uv__get_internal_fields(loop)->tracing)                               \
+      uv__trace_count((loop), (what));                                        \
+  }                                                                           \
+  while (0)
+
+/* USDT probes for perf, bpftrace and SystemTap, in the "libuv" provider.
+ * Compiled out unless libuv is built with UV_USE_SDT (LIBUV_USE_SDT in CMake,
+ * --enable-sdt in autotools), which needs the <sys/sdt.h> header from
+ * SystemTap. Disabled probes are a single nop.
+ */
+#if defined(UV_USE_SDT)
+# include <sys/sdt.h>
+# define UV__PROBE1(name, a) DTRACE_PROBE1(libuv, name, a)
+# define UV__PROBE2(name, a, b) DTRACE_PROBE2(libuv, name, a, b)
+# define UV__PROBE3(name, a, b, c) DTRACE_PROBE3(libuv, name, a, b, c)
+#else
+# define UV__PROBE1(name, a) do { } while (0)
+# define UV__PROBE2(name, a, b) do { } while (0)
+# define UV__PROBE3(name, a, b, c) do { } while (0)
+#endif
+
 /* Handle flags. Some flags are specific to Windows or UNIX. */
 enum {
   /* Used by all handles. */
@@ -86,13 +300,21 @@ enum {
   UV_HANDLE_READ_PENDING                = 0x00010000,
   UV_HANDLE_SYNC_BYPASS_IOCP            = 0x00020000,
   UV_HANDLE_ZERO_READ                   = 0x00040000,
+#if defined(_WIN32)
   UV_HANDLE_EMULATE_IOCP                = 0x00080000,
+#else
+  /* Servers started with uv_listen_batch(), the bit is only taken on Windows. */
+  UV_HANDLE_LISTEN_BATCH                = 0x00080000,
+#endif
   UV_HANDLE_BLOCKING_WRITES             = 0x00100000,
   UV_HANDLE_CANCELLATION_PENDING        = 0x00200000,
 
   /* Used by uv_tcp_t and uv_udp_t handles */
   UV_HANDLE_IPV6                        = 0x00400000,
 
+  /* Only used by UNIX uv_tcp_t and uv_pipe_t handles. */
+  UV_HANDLE_MIGRATING                   = 0x00800000,
+
   /* Only used by uv_tcp_t handles. */
   UV_HANDLE_TCP_NODELAY                 = 0x01000000,
   UV_HANDLE_TCP_KEEPALIVE               = 0x02000000,
@@ -100,6 +322,7 @@ enum {
   UV_HANDLE_TCP_ACCEPT_STATE_CHANGING   = 0x08000000,
   UV_HANDLE_TCP_SOCKET_CLOSED           = 0x10000000,
   UV_HANDLE_SHARED_TCP_SOCKET           = 0x20000000,
+  UV_HANDLE_TCP_EXCLUSIVE_ACCEPT        = 0x40000000,
 
   /* Only used by uv_udp_t handles. */
   UV_HANDLE_UDP_PROCESSING              = 0x01000000,
@@ -123,6 +346,11 @@ enum {
   UV_HANDLE_POLL_SLOW                   = 0x01000000
 };
 
+/* Only used by UNIX uv_tcp_t handles. The last free bit, it doesn't fit in
+ * the enum because ISO C restricts enumerators to the range of int.
+ */
+#define UV_HANDLE_TCP_ZEROCOPY 0x80000000u
+
 int uv__loop_configure(uv_loop_t* loop, uv_loop_option option, va_list ap);
 
 void uv__loop_close(uv_loop_t* loop);
@@ -188,6 +416,10 @@ void uv__work_submit(uv_loop_t* loop,
 
 void uv__work_done(uv_async_t* handle);
 
+void uv__work_post_done(uv_loop_t* loop,
+                        struct uv__work *w,
+                        void (*done)(struct uv__work *w, int status));
+
 size_t uv__count_bufs(const uv_buf_t bufs[], unsigned int nbufs);
 
 int uv__socket_sockopt(uv_handle_t* handle, int optname, int* value);
@@ -196,6 +428,31 @@ void uv__fs_scandir_cleanup(uv_fs_t* req);
 void uv__fs_readdir_cleanup(uv_fs_t* req);
 uv_dirent_type_t uv__fs_get_dirent_type(uv__dirent_t* dent);
 
+void uv__epoch_offline(uv_loop_t* loop);
+void uv__epoch_online(uv_loop_t* loop);
+void uv__epoch_loop_close(uv_loop_t* loop);
+
+void uv__watchdog_loop_close(uv_loop_t* loop);
+void uv__watchdog_fork(uv_loop_t* loop);
+
+void uv__trace_phase(uv_loop_t* loop, int phase);
+void uv__trace_dispatch(uv_loop_t* loop, uv_handle_t* handle);
+void uv__trace_handle(uv_loop_t* loop, uv_handle_t* handle);
+void uv__trace_count(uv_loop_t* loop, int what);
+void uv__trace_work_submit(struct uv__work* w, int kind);
+void uv__trace_work(struct uv__work* w, uint64_t start, unsigned int worker);
+void uv__trace_loop_close(uv_loop_t* loop);
+
+int uv__idle_task_budget(uv_loop_t* loop, unsigned int budget);
+void uv__defer_drain(uv_loop_t* loop);
+void uv__defer_loop_close(uv_loop_t* loop);
+int uv__read_pool_configure(uv_loop_t* loop, va_list ap);
+void uv__read_pool_loop_close(uv_loop_t* loop);
+int uv__read_pool_reading(const uv_stream_t* stream);
+int uv__idle_tasks_run(uv_loop_t* loop, int timeout);
+
+int uv__thread_pin_self(int cpu);
+
 int uv__next_timeout(const uv_loop_t* loop);
 void uv__run_timers(uv_loop_t* loop);
 void uv__timer_close(uv_timer_t* handle);
@@ -216,6 +473,22 @@ void uv__timer_close(uv_timer_t* handle);
   }                                                                           \
   while (0)
 
+/* Runs the callbacks queued with uv_defer(). Called after every callback the
+ * loop dispatches where that's cheap to do, and after each phase otherwise.
+ */
+#define uv__defer_run(loop)                                                   \
+  do {                                                                        \
+    if (uv__get_internal_fields(loop)->defer_count != 0)                      \
+      uv__defer_drain(loop);                                                  \
+  }                                                                           \
+  while (0)
+
+#define uv__has_deferred(loop)                                                \
+  (uv__get_internal_fields(loop)->defer_count != 0)
+
+#define uv__has_idle_tasks(loop)                                              \
+  (!QUEUE_EMPTY(&uv__get_internal_fields(loop)->idle_tasks))
+
 #define uv__has_active_handles(loop)                                          \
   ((loop)->active_handles > 0)
 
@@ -323,4 +596,46 @@ void* uv__malloc(size_t size);
 void uv__free(void* ptr);
 void* uv__realloc(void* ptr, size_t size);
 
+/* Allocations owned by a loop and only made or released on its thread.
+ * The subsystem is only recorded when libuv is built with UV_ALLOC_STATS.
+ */
+void* uv__loop_malloc(uv_loop_t* loop,
+                      uv_alloc_subsystem subsystem,
+                      size_t size);
+void* uv__loop_realloc(uv_loop_t* loop,
+                       uv_alloc_subsystem subsystem,
+                       void* ptr,
+                       size_t size);
+void uv__loop_free(uv_loop_t* loop, void* ptr);
+void uv__loop_alloc_release(uv_loop_t* loop,
+                            uv__loop_alloc_t* alloc,
+                            void* ptr);
+char* uv__loop_strdup(uv_loop_t* loop,
+                      uv_alloc_subsystem subsystem,
+                      const char* s);
+void uv__loop_alloc_close(uv_loop_t* loop);
+
+/* Accounts for memory that the loop holds on to but that isn't allocated
+ * through it, for example because it may be freed after the loop is closed.
+ * Zero-sized charges are ignored.
+ */
+#if defined(UV_ALLOC_STATS)
+void uv__loop_alloc_charge(uv_loop_t* loop,
+                           uv_alloc_subsystem subsystem,
+                           size_t size);
+void uv__loop_alloc_uncharge(uv_loop_t* loop,
+                             uv_alloc_subsystem subsystem,
+                             size_t size);
+#else
+# define uv__loop_alloc_charge(loop, subsystem, size) do { } while (0)
+# define uv__loop_alloc_uncharge(loop, subsystem, size) do { } while (0)
+#endif
+
+#ifndef _WIN32
+size_t uv__io_table_allocs(const uv_loop_t* loop);
+int uv__io_table_move(uv_loop_t* loop, uv__loop_alloc_t* prev);
+#endif
+
+int uv__arena_init(uv_loop_t* loop);
+
 #endif /* UV_COMMON_H_ */
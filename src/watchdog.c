@@ -0,0 +1,217 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Blocked-loop watchdog.
+ *
+ * The loop thread doesn't take any locks or read the clock for this: the
+ * dispatch points only store what they're about to run and bump a sequence
+ * number, see uv__loop_watch(). The watchdog thread samples that a few
+ * times per timeout and reports when the sequence number hasn't moved for
+ * longer than the timeout while the loop isn't waiting in the kernel.
+ *
+ * The watchdog thread never dereferences the handle: a close callback can
+ * free it and then get stuck.
+ */
+
+#include "uv-common.h"
+
+#include <stdlib.h>
+
+/* How many times per timeout the watchdog samples the loop. A stall is
+ * reported between timeout and timeout * (1 + 1 / UV__WATCHDOG_SAMPLES).
+ */
+#define UV__WATCHDOG_SAMPLES 4
+
+struct uv__watchdog_s {
+  uv_loop_t* loop;
+  uv_thread_t thread;
+  uv_mutex_t mutex;
+  uv_cond_t cond;
+  uint64_t timeout;  /* Nanoseconds. */
+  uv_watchdog_cb cb;
+  void* arg;
+  int stop;  /* Guarded by mutex. */
+};
+
+
+static void uv__watchdog_thread(void* arg) {
+  uv__loop_internal_fields_t* lfields;
+  uv_watchdog_report_t report;
+  struct uv__watchdog_s* wd;
+  unsigned int last_seq;
+  unsigned int seq;
+  uint64_t last_change;
+  uint64_t now;
+  uv_handle_t* handle;
+  uv_handle_type type;
+  uv__watch_cb_t cb;
+  int reported;
+  int idle;
+
+  wd = arg;
+  lfields = uv__get_internal_fields(wd->loop);
+  last_seq = uv__atomic_load(unsigned int, lfields->watch_seq);
+  last_change = uv_hrtime();
+  reported = 0;
+
+  uv_mutex_lock(&wd->mutex);
+
+  while (!wd->stop) {
+    uv_cond_timedwait(&wd->cond,
+                      &wd->mutex,
+                      wd->timeout / UV__WATCHDOG_SAMPLES);
+    if (wd->stop)
+      break;
+
+    now = uv_hrtime();
+    seq = uv__atomic_load(unsigned int, lfields->watch_seq);
+    uv__atomic_fence_acquire();
+    idle = uv__atomic_load(int, lfields->watch_idle);
+    handle = uv__atomic_load(uv_handle_t*, lfields->watch_handle);
+    type = uv__atomic_load(uv_handle_type, lfields->watch_type);
+    cb = uv__atomic_load(uv__watch_cb_t, lfields->watch_cb);
+    uv__atomic_fence_acquire();
+
+    /* An odd or changed sequence number means the loop was updating the
+     * fields while they were read. It's making progress either way.
+     */
+    if ((seq & 1) ||
+        seq != uv__atomic_load(unsigned int, lfields->watch_seq) ||
+        seq != last_seq ||
+        idle) {
+      last_seq = seq;
+      last_change = now;
+      reported = 0;
+      continue;
+    }
+
+    /* One report per stall. */
+    if (reported || now - last_change < wd->timeout)
+      continue;
+
+    reported = 1;
+
+    report.type = type;
+    report.handle = handle;
+    report.cb = cb;
+    report.elapsed = (now - last_change) / 1000000;
+
+    uv_mutex_unlock(&wd->mutex);
+    wd->cb(wd->loop, &report, wd->arg);
+    uv_mutex_lock(&wd->mutex);
+  }
+
+  uv_mutex_unlock(&wd->mutex);
+}
+
+
+int uv_loop_watchdog_start(uv_loop_t* loop,
+                           uint64_t timeout,
+                           uv_watchdog_cb cb,
+                           void* arg) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__watchdog_s* wd;
+  int err;
+
+  if (timeout == 0 || cb == NULL)
+    return UV_EINVAL;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->watchdog != NULL)
+    return UV_EBUSY;
+
+  wd = uv__malloc(sizeof(*wd));
+  if (wd == NULL)
+    return UV_ENOMEM;
+
+  wd->loop = loop;
+  wd->timeout = timeout * 1000000;
+  wd->cb = cb;
+  wd->arg = arg;
+  wd->stop = 0;
+
+  err = uv_mutex_init(&wd->mutex);
+  if (err)
+    goto error_mutex;
+
+  err = uv_cond_init(&wd->cond);
+  if (err)
+    goto error_cond;
+
+  err = uv_thread_create(&wd->thread, uv__watchdog_thread, wd);
+  if (err)
+    goto error_thread;
+
+  lfields->watchdog = wd;
+  return 0;
+
+error_thread:
+  uv_cond_destroy(&wd->cond);
+error_cond:
+  uv_mutex_destroy(&wd->mutex);
+error_mutex:
+  uv__free(wd);
+  return err;
+}
+
+
+int uv_loop_watchdog_stop(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__watchdog_s* wd;
+
+  lfields = uv__get_internal_fields(loop);
+  wd = lfields->watchdog;
+  if (wd == NULL)
+    return 0;
+
+  uv_mutex_lock(&wd->mutex);
+  wd->stop = 1;
+  uv_cond_signal(&wd->cond);
+  uv_mutex_unlock(&wd->mutex);
+
+  if (uv_thread_join(&wd->thread))
+    abort();
+
+  uv_cond_destroy(&wd->cond);
+  uv_mutex_destroy(&wd->mutex);
+  uv__free(wd);
+  lfields->watchdog = NULL;
+
+  return 0;
+}
+
+
+void uv__watchdog_loop_close(uv_loop_t* loop) {
+  uv_loop_watchdog_stop(loop);
+}
+
+
+void uv__watchdog_fork(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+
+  /* The watchdog thread doesn't exist in the child and its mutex may have
+   * been held at the time of the fork. Forget about it, the child can start
+   * a new one.
+   */
+  lfields = uv__get_internal_fields(loop);
+  uv__free(lfields->watchdog);
+  lfields->watchdog = NULL;
+}
@@ -93,6 +93,7 @@ void uv_process_async_wakeup_req(uv_loop_t* loop, uv_async_t* handle,
   if (handle->flags & UV_HANDLE_CLOSING) {
     uv_want_endgame(loop, (uv_handle_t*)handle);
   } else if (handle->async_cb != NULL) {
+    uv__loop_dispatch(loop, handle, handle->async_cb);
     handle->async_cb(handle);
   }
 }
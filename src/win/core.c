@@ -222,6 +222,7 @@ static void uv_init(void) {
 
 
 int uv_loop_init(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
   struct heap* timer_heap;
   int err;
 
@@ -233,6 +234,16 @@ int uv_loop_init(uv_loop_t* loop) {
   if (loop->iocp == NULL)
     return uv_translate_sys_error(GetLastError());
 
+  lfields = (uv__loop_internal_fields_t*) uv__calloc(1, sizeof(*lfields));
+  if (lfields == NULL) {
+    err = UV_ENOMEM;
+    goto fail_fields_alloc;
+  }
+  loop->internal_fields = lfields;
+  QUEUE_INIT(&lfields->epoch_records);
+  QUEUE_INIT(&lfields->idle_tasks);
+  lfields->watch_idle = 1;
+
   /* To prevent uninitialized memory access, loop->time must be initialized
    * to zero before calling uv_update_time for the first time.
    */
@@ -297,6 +308,10 @@ fail_mutex_init:
   loop->timer_heap = NULL;
 
 fail_timers_alloc:
+  uv__free(lfields);
+  loop->internal_fields = NULL;
+
+fail_fields_alloc:
   CloseHandle(loop->iocp);
   loop->iocp = INVALID_HANDLE_VALUE;
 
@@ -342,6 +357,10 @@ void uv__loop_close(uv_loop_t* loop) {
   uv__free(loop->timer_heap);
   loop->timer_heap = NULL;
 
+  uv__loop_alloc_close(loop);
+  uv__free(loop->internal_fields);
+  loop->internal_fields = NULL;
+
   CloseHandle(loop->iocp);
 }
 
@@ -371,6 +390,9 @@ int uv_backend_timeout(const uv_loop_t* loop) {
   if (loop->pending_reqs_tail)
     return 0;
 
+  if (uv__has_deferred(loop))
+    return 0;
+
   if (loop->endgame_handles)
     return 0;
 
@@ -494,6 +516,7 @@ static void uv__poll(uv_loop_t* loop, DWORD timeout) {
 static int uv__loop_alive(const uv_loop_t* loop) {
   return uv__has_active_handles(loop) ||
          uv__has_active_reqs(loop) ||
+         uv__has_deferred(loop) ||
          loop->endgame_handles != NULL;
 }
 
@@ -503,8 +526,10 @@ int uv_loop_alive(const uv_loop_t* loop) {
 }
 
 
-int uv_run(uv_loop_t *loop, uv_run_mode mode) {
+static int uv__run(uv_loop_t* loop, uv_run_mode mode, uint64_t deadline) {
   DWORD timeout;
+  uint64_t now;
+  uint64_t left;
   int r;
   int ran_pending;
 
@@ -512,26 +537,56 @@ int uv_run(uv_loop_t *loop, uv_run_mode mode) {
   if (!r)
     uv_update_time(loop);
 
+  /* Callbacks may hold references to epoch-protected data from here on. */
+  uv__epoch_online(loop);
+
   while (r != 0 && loop->stop_flag == 0) {
     uv_update_time(loop);
+    uv__loop_phase(loop, UV__LOOP_PHASE_TIMERS);
     uv__run_timers(loop);
 
+    uv__loop_phase(loop, UV__LOOP_PHASE_PENDING);
     ran_pending = uv_process_reqs(loop);
+    uv__loop_phase(loop, UV__LOOP_PHASE_IDLE);
     uv_idle_invoke(loop);
+    uv__defer_run(loop);
+    uv__loop_phase(loop, UV__LOOP_PHASE_PREPARE);
     uv_prepare_invoke(loop);
+    uv__defer_run(loop);
 
     timeout = 0;
     if ((mode == UV_RUN_ONCE && !ran_pending) || mode == UV_RUN_DEFAULT)
       timeout = uv_backend_timeout(loop);
 
+    if (deadline != 0 && timeout != 0) {
+      /* Don't sleep past the deadline, rounding up to whole milliseconds. */
+      now = uv_hrtime();
+      left = deadline > now ? (deadline - now + 999999) / 1000000 : 0;
+      if (timeout == INFINITE || timeout > left)
+        timeout = (DWORD) left;
+    }
+
+    if (timeout != 0 && uv__has_idle_tasks(loop))
+      timeout = (DWORD) uv__idle_tasks_run(loop, (int) timeout);
+
+    /* Completions are only dequeued here, callbacks run later from
+     * uv_process_reqs(), so the whole wait counts as a quiescent period.
+     */
+    uv__epoch_offline(loop);
+    uv__loop_phase(loop, UV__LOOP_PHASE_POLL);
     if (pGetQueuedCompletionStatusEx)
       uv__poll(loop, timeout);
     else
       uv__poll_wine(loop, timeout);
+    uv__epoch_online(loop);
 
 
+    uv__loop_phase(loop, UV__LOOP_PHASE_CHECK);
     uv_check_invoke(loop);
+    uv__defer_run(loop);
+    uv__loop_phase(loop, UV__LOOP_PHASE_CLOSING);
     uv_process_endgames(loop);
+    uv__defer_run(loop);
 
     if (mode == UV_RUN_ONCE) {
       /* UV_RUN_ONCE implies forward progress: at least one callback must have
@@ -542,12 +597,16 @@ int uv_run(uv_loop_t *loop, uv_run_mode mode) {
        * UV_RUN_NOWAIT makes no guarantees about progress so it's omitted from
        * the check.
        */
+      uv__loop_phase(loop, UV__LOOP_PHASE_TIMERS);
       uv__run_timers(loop);
     }
 
     r = uv__loop_alive(loop);
     if (mode == UV_RUN_ONCE || mode == UV_RUN_NOWAIT)
       break;
+
+    if (deadline != 0 && uv_hrtime() >= deadline)
+      break;
   }
 
   /* The if statement lets the compiler compile it to a conditional store.
@@ -556,10 +615,26 @@ int uv_run(uv_loop_t *loop, uv_run_mode mode) {
   if (loop->stop_flag != 0)
     loop->stop_flag = 0;
 
+  uv__loop_phase(loop, UV__LOOP_PHASE_NONE);
+  uv__epoch_offline(loop);
+
   return r;
 }
 
 
+int uv_run(uv_loop_t *loop, uv_run_mode mode) {
+  return uv__run(loop, mode, 0);
+}
+
+
+int uv_run_until(uv_loop_t* loop, uint64_t deadline) {
+  if (deadline <= uv_hrtime())
+    return uv__loop_alive(loop);
+
+  return uv__run(loop, UV_RUN_DEFAULT, deadline);
+}
+
+
 int uv_fileno(const uv_handle_t* handle, uv_os_fd_t* fd) {
   uv_os_fd_t fd_out;
 
@@ -650,3 +725,17 @@ int uv__getsockpeername(const uv_handle_t* handle,
 
   return 0;
 }
+
+
+int uv_handle_set_io_priority(uv_handle_t* handle, int priority) {
+  /* Completions are dequeued in the order the kernel posted them. */
+  return UV_ENOTSUP;
+}
+
+
+int uv_handle_set_read_size(uv_handle_t* handle,
+                            size_t min_size,
+                            size_t max_size) {
+  /* Reads are posted up front with a buffer of a fixed size. */
+  return UV_ENOTSUP;
+}
@@ -55,6 +55,7 @@
   do {                                                                        \
     if (cb != NULL) {                                                         \
       uv__req_register(loop, req);                                            \
+      uv__loop_alloc_charge(loop, UV_ALLOC_FS, fs__path_size(req));           \
       uv__work_submit(loop,                                                   \
                       &req->work_req,                                         \
                       UV__WORK_FAST_IO,                                       \
@@ -241,6 +242,38 @@ INLINE static int fs__capture_path(uv_fs_t* req, const char* path,
 
 
 
+#if defined(UV_ALLOC_STATS)
+static size_t fs__path_size(const uv_fs_t* req) {
+  size_t size;
+
+  if (!(req->flags & UV_FS_FREE_PATHS))
+    return 0;
+
+  size = 0;
+  if (req->file.pathw != NULL)
+    size += (wcslen(req->file.pathw) + 1) * sizeof(WCHAR);
+
+  /* Other request types store something else where new_pathw lives. */
+  switch (req->fs_type) {
+    case UV_FS_RENAME:
+    case UV_FS_COPYFILE:
+    case UV_FS_LINK:
+    case UV_FS_SYMLINK:
+      if (req->fs.info.new_pathw != NULL)
+        size += (wcslen(req->fs.info.new_pathw) + 1) * sizeof(WCHAR);
+      break;
+    default:
+      break;
+  }
+
+  if (req->cb != NULL && req->path != NULL)
+    size += strlen(req->path) + 1;
+
+  return size;
+}
+#endif
+
+
 INLINE static void uv_fs_req_init(uv_loop_t* loop, uv_fs_t* req,
     uv_fs_type fs_type, const uv_fs_cb cb) {
   uv__once_init();
@@ -2191,6 +2224,7 @@ static void uv__fs_done(struct uv__work* w, int status) {
 
   req = container_of(w, uv_fs_t, work_req);
   uv__req_unregister(req->loop, req);
+  uv__loop_alloc_uncharge(req->loop, UV_ALLOC_FS, fs__path_size(req));
 
   if (status == UV_ECANCELED) {
     assert(req->result == 0);
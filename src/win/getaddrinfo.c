@@ -115,7 +115,7 @@ static void uv__getaddrinfo_done(struct uv__work* w, int status) {
   req = container_of(w, uv_getaddrinfo_t, work_req);
 
   /* release input parameter memory */
-  uv__free(req->alloc);
+  uv__loop_free(req->loop, req->alloc);
   req->alloc = NULL;
 
   if (status == UV_ECANCELED) {
@@ -275,6 +275,7 @@ int uv_getaddrinfo(uv_loop_t* loop,
   UV_REQ_INIT(req, UV_GETADDRINFO);
   req->getaddrinfo_cb = getaddrinfo_cb;
   req->addrinfo = NULL;
+  req->alloc = NULL;
   req->loop = loop;
   req->retcode = 0;
 
@@ -313,7 +314,9 @@ int uv_getaddrinfo(uv_loop_t* loop,
   }
 
   /* allocate memory for inputs, and partition it as needed */
-  alloc_ptr = (char*)uv__malloc(nodesize + servicesize + hintssize);
+  alloc_ptr = (char*)uv__loop_malloc(loop,
+                                     UV_ALLOC_DNS,
+                                     nodesize + servicesize + hintssize);
   if (!alloc_ptr) {
     err = WSAENOBUFS;
     goto error;
@@ -390,7 +393,7 @@ int uv_getaddrinfo(uv_loop_t* loop,
 
 error:
   if (req != NULL) {
-    uv__free(req->alloc);
+    uv__loop_free(loop, req->alloc);
     req->alloc = NULL;
   }
   return uv_translate_sys_error(err);
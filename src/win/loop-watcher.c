@@ -113,6 +113,7 @@ void uv_loop_watcher_endgame(uv_loop_t* loop, uv_handle_t* handle) {
       handle = (loop)->next_##name##_handle;                                  \
       (loop)->next_##name##_handle = handle->name##_next;                     \
                                                                               \
+      uv__loop_dispatch(loop, handle, handle->name##_cb);                     \
       handle->name##_cb(handle);                                              \
     }                                                                         \
   }
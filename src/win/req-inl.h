@@ -213,6 +213,8 @@ INLINE static int uv_process_reqs(uv_loop_t* loop) {
       default:
         assert(0);
     }
+
+    uv__defer_run(loop);
   }
 
   return 1;
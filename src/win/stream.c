@@ -173,6 +173,26 @@ int uv_write2(uv_write_t* req,
 }
 
 
+int uv_write_handles(uv_write_t* req,
+                     uv_stream_t* handle,
+                     const uv_buf_t bufs[],
+                     unsigned int nbufs,
+                     uv_stream_t* send_handles[],
+                     unsigned int nsend_handles,
+                     uv_write_cb cb) {
+  if (nsend_handles == 0)
+    return uv_write2(req, handle, bufs, nbufs, NULL, cb);
+
+  if (nsend_handles == 1)
+    return uv_write2(req, handle, bufs, nbufs, send_handles[0], cb);
+
+  /* Each handle goes out in a frame of its own with its own header, there is
+   * nothing to gain from sending several at once.
+   */
+  return UV_ENOTSUP;
+}
+
+
 int uv_try_write(uv_stream_t* stream,
                  const uv_buf_t bufs[],
                  unsigned int nbufs) {
@@ -195,6 +215,31 @@ int uv_try_write(uv_stream_t* stream,
 }
 
 
+int uv_try_read(uv_stream_t* stream,
+                const uv_buf_t bufs[],
+                unsigned int nbufs) {
+  if (stream->flags & UV_HANDLE_CLOSING)
+    return UV_EBADF;
+  if (stream->flags & UV_HANDLE_READ_EOF)
+    return UV_EOF;
+  if (!(stream->flags & UV_HANDLE_READABLE))
+    return UV_ENOTCONN;
+  if (uv__count_bufs(bufs, nbufs) == 0)
+    return UV_EINVAL;
+
+  switch (stream->type) {
+    case UV_TCP:
+      return uv__tcp_try_read((uv_tcp_t*) stream, bufs, nbufs);
+    case UV_TTY:
+    case UV_NAMED_PIPE:
+      return UV_EAGAIN;
+    default:
+      assert(0);
+      return UV_ENOSYS;
+  }
+}
+
+
 int uv_shutdown(uv_shutdown_t* req, uv_stream_t* handle, uv_shutdown_cb cb) {
   uv_loop_t* loop = handle->loop;
 
@@ -238,3 +283,32 @@ int uv_stream_set_blocking(uv_stream_t* handle, int blocking) {
 
   return 0;
 }
+
+
+int uv_stream_migrate(uv_stream_t* handle, uv_loop_t* loop, uv_migrate_cb cb) {
+  /* A socket or pipe stays associated with the completion port it was first
+   * bound to, so it can't be moved to another loop.
+   */
+  return UV_ENOTSUP;
+}
+
+
+int uv_listen_batch(uv_stream_t* stream,
+                    int backlog,
+                    unsigned int max_batch,
+                    uv_connection_batch_cb cb) {
+  /* Accepts are posted to the completion port ahead of time. */
+  return UV_ENOTSUP;
+}
+
+
+int uv_listen_set_admission(uv_stream_t* server,
+                            const uv_admission_t* limits) {
+  /* Accepts are posted to the completion port ahead of time. */
+  return UV_ENOTSUP;
+}
+
+
+int uv_listen_is_paused(const uv_stream_t* server) {
+  return 0;
+}
@@ -298,6 +298,10 @@ static int uv_tcp_try_bind(uv_tcp_t* handle,
   DWORD err;
   int r;
 
+  /* Windows doesn't balance connections over sockets sharing a port. */
+  if (flags & UV_TCP_REUSEPORT)
+    return ERROR_NOT_SUPPORTED;
+
   if (handle->socket == INVALID_SOCKET) {
     SOCKET sock;
 
@@ -921,6 +925,38 @@ int uv__tcp_try_write(uv_tcp_t* handle,
 }
 
 
+int uv__tcp_try_read(uv_tcp_t* handle,
+                     const uv_buf_t bufs[],
+                     unsigned int nbufs) {
+  int result;
+  DWORD bytes, flags;
+
+  /* A read posted with a buffer of its own gets the data first. */
+  if ((handle->flags & UV_HANDLE_READ_PENDING) &&
+      !(handle->flags & UV_HANDLE_ZERO_READ))
+    return UV_EAGAIN;
+
+  flags = 0;
+  result = WSARecv(handle->socket,
+                   (WSABUF*) bufs,
+                   nbufs,
+                   &bytes,
+                   &flags,
+                   NULL,
+                   NULL);
+
+  if (result == SOCKET_ERROR)
+    return uv_translate_sys_error(WSAGetLastError());
+
+  if (bytes == 0) {
+    handle->flags |= UV_HANDLE_READ_EOF;
+    return UV_EOF;
+  }
+
+  return bytes;
+}
+
+
 void uv_process_tcp_read_req(uv_loop_t* loop, uv_tcp_t* handle,
     uv_req_t* req) {
   DWORD bytes, flags, err;
@@ -1318,6 +1354,22 @@ int uv_tcp_simultaneous_accepts(uv_tcp_t* handle, int enable) {
 }
 
 
+int uv_tcp_reuseport_steer_cpu(uv_tcp_t* handle) {
+  return UV_ENOTSUP;
+}
+
+
+int uv_tcp_exclusive_accept(uv_tcp_t* handle, int enable) {
+  /* Completion ports already hand each accept to a single thread. */
+  return UV_ENOTSUP;
+}
+
+
+int uv_tcp_zerocopy(uv_tcp_t* handle, int enable, size_t min_size) {
+  return UV_ENOTSUP;
+}
+
+
 static int uv_tcp_try_cancel_io(uv_tcp_t* tcp) {
   SOCKET socket = tcp->socket;
   int non_ifs_lsp;
@@ -204,6 +204,17 @@ int uv_thread_equal(const uv_thread_t* t1, const uv_thread_t* t2) {
 }
 
 
+int uv__thread_pin_self(int cpu) {
+  if (cpu < 0 || cpu >= (int) (8 * sizeof(DWORD_PTR)))
+    return UV_EINVAL;
+
+  if (SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << cpu) == 0)
+    return uv_translate_sys_error(GetLastError());
+
+  return 0;
+}
+
+
 int uv_mutex_init(uv_mutex_t* mutex) {
   InitializeCriticalSection(mutex);
   return 0;
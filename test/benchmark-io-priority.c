@@ -0,0 +1,189 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+# include <sys/socket.h>
+# include <unistd.h>
+#endif
+
+#define NUM_BULK      256
+#define NUM_PINGS     500
+#define WORK_PER_CB   1024
+
+#ifndef _WIN32
+
+/* The bulk watchers never drain their sockets so they're ready in every poll
+ * batch, each callback burning a bit of CPU like a busy data connection. A
+ * timer writes a timestamped ping to the control connection once per loop
+ * iteration and the benchmark reports how long it waits for its callback.
+ */
+static uv_poll_t bulk[NUM_BULK];
+static int bulk_fds[NUM_BULK][2];
+static uv_pipe_t control;
+static int control_fds[2];
+static uv_timer_t timer;
+static uint64_t latencies[NUM_PINGS];
+static unsigned int npings;
+static int ping_pending;
+static volatile uint32_t sink;
+
+
+static void bulk_cb(uv_poll_t* handle, int status, int events) {
+  uint32_t x;
+  int i;
+
+  /* xorshift32, enough to keep the CPU busy. */
+  x = (uint32_t) (uintptr_t) handle | 1;
+  for (i = 0; i < WORK_PER_CB; i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+  }
+  sink = x;
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  static uint64_t slab[64];
+
+  buf->base = (char*) slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void close_all(void) {
+  int i;
+
+  for (i = 0; i < NUM_BULK; i++)
+    uv_close((uv_handle_t*) &bulk[i], NULL);
+  uv_close((uv_handle_t*) &control, NULL);
+  uv_close((uv_handle_t*) &timer, NULL);
+}
+
+
+static void control_read_cb(uv_stream_t* handle,
+                            ssize_t nread,
+                            const uv_buf_t* buf) {
+  uint64_t sent;
+
+  if (nread == 0)
+    return;
+
+  ASSERT(nread == sizeof(sent));
+  memcpy(&sent, buf->base, sizeof(sent));
+  latencies[npings++] = uv_hrtime() - sent;
+  ping_pending = 0;
+
+  if (npings == NUM_PINGS)
+    close_all();
+}
+
+
+static void timer_cb(uv_timer_t* handle) {
+  uint64_t now;
+
+  if (ping_pending)
+    return;
+
+  now = uv_hrtime();
+  ASSERT(sizeof(now) == write(control_fds[1], &now, sizeof(now)));
+  ping_pending = 1;
+}
+
+
+static int cmp(const void* a, const void* b) {
+  uint64_t x;
+  uint64_t y;
+
+  x = *(const uint64_t*) a;
+  y = *(const uint64_t*) b;
+  return (x > y) - (x < y);
+}
+
+
+static void run(int priority) {
+  uv_loop_t* loop;
+  uint64_t total;
+  unsigned int i;
+
+  loop = uv_default_loop();
+  npings = 0;
+  ping_pending = 0;
+
+  for (i = 0; i < NUM_BULK; i++) {
+    ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, bulk_fds[i]));
+    ASSERT(1 == write(bulk_fds[i][1], "b", 1));
+    ASSERT(0 == uv_poll_init(loop, &bulk[i], bulk_fds[i][0]));
+    ASSERT(0 == uv_poll_start(&bulk[i], UV_READABLE, bulk_cb));
+  }
+
+  ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, control_fds));
+  ASSERT(0 == uv_pipe_init(loop, &control, 0));
+  ASSERT(0 == uv_pipe_open(&control, control_fds[0]));
+  ASSERT(0 == uv_handle_set_io_priority((uv_handle_t*) &control, priority));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &control,
+                            alloc_cb,
+                            control_read_cb));
+
+  ASSERT(0 == uv_timer_init(loop, &timer));
+  ASSERT(0 == uv_timer_start(&timer, timer_cb, 0, 1));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  for (i = 0; i < NUM_BULK; i++) {
+    ASSERT(0 == close(bulk_fds[i][0]));
+    ASSERT(0 == close(bulk_fds[i][1]));
+  }
+  ASSERT(0 == close(control_fds[1]));
+
+  total = 0;
+  for (i = 0; i < NUM_PINGS; i++)
+    total += latencies[i];
+  qsort(latencies, NUM_PINGS, sizeof(latencies[0]), cmp);
+
+  printf("io_priority: %s control connection: "
+         "mean %.1f us, p99 %.1f us\n",
+         priority == UV_IO_PRIORITY_HIGH ? "high priority" : "normal",
+         total / 1e3 / NUM_PINGS,
+         latencies[NUM_PINGS * 99 / 100] / 1e3);
+  fflush(stdout);
+}
+
+#endif  /* !_WIN32 */
+
+
+BENCHMARK_IMPL(io_priority) {
+#ifdef _WIN32
+  RETURN_SKIP("Not supported on Windows.");
+#else
+  run(UV_IO_PRIORITY_NORMAL);
+  run(UV_IO_PRIORITY_HIGH);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
@@ -24,6 +24,8 @@ BENCHMARK_DECLARE (loop_count)
 BENCHMARK_DECLARE (loop_count_timed)
 BENCHMARK_DECLARE (ping_pongs)
 BENCHMARK_DECLARE (tcp_write_batch)
+BENCHMARK_DECLARE (tcp_write_small_batch)
+BENCHMARK_DECLARE (tcp_zerocopy)
 BENCHMARK_DECLARE (tcp4_pound_100)
 BENCHMARK_DECLARE (tcp4_pound_1000)
 BENCHMARK_DECLARE (pipe_pound_100)
@@ -36,6 +38,9 @@ BENCHMARK_DECLARE (pipe_pump1_client)
 BENCHMARK_DECLARE (tcp_multi_accept2)
 BENCHMARK_DECLARE (tcp_multi_accept4)
 BENCHMARK_DECLARE (tcp_multi_accept8)
+BENCHMARK_DECLARE (tcp_multi_accept_exclusive2)
+BENCHMARK_DECLARE (tcp_multi_accept_exclusive4)
+BENCHMARK_DECLARE (tcp_multi_accept_exclusive8)
 
 /* Run until X packets have been sent/received. */
 BENCHMARK_DECLARE (udp_pummel_1v1)
@@ -63,6 +68,9 @@ BENCHMARK_DECLARE (udp_timed_pummel_1000v1000)
 
 BENCHMARK_DECLARE (getaddrinfo)
 BENCHMARK_DECLARE (fs_stat)
+BENCHMARK_DECLARE (req_pool)
+BENCHMARK_DECLARE (loop_group_scaling)
+BENCHMARK_DECLARE (io_priority)
 BENCHMARK_DECLARE (async1)
 BENCHMARK_DECLARE (async2)
 BENCHMARK_DECLARE (async4)
@@ -93,6 +101,12 @@ TASK_LIST_START
   BENCHMARK_ENTRY  (tcp_write_batch)
   BENCHMARK_HELPER (tcp_write_batch, tcp4_blackhole_server)
 
+  BENCHMARK_ENTRY  (tcp_write_small_batch)
+  BENCHMARK_HELPER (tcp_write_small_batch, tcp4_blackhole_server)
+
+  BENCHMARK_ENTRY  (tcp_zerocopy)
+  BENCHMARK_HELPER (tcp_zerocopy, tcp4_blackhole_server)
+
   BENCHMARK_ENTRY  (tcp_pump100_client)
   BENCHMARK_HELPER (tcp_pump100_client, tcp_pump_server)
 
@@ -120,6 +134,9 @@ TASK_LIST_START
   BENCHMARK_ENTRY  (tcp_multi_accept2)
   BENCHMARK_ENTRY  (tcp_multi_accept4)
   BENCHMARK_ENTRY  (tcp_multi_accept8)
+  BENCHMARK_ENTRY  (tcp_multi_accept_exclusive2)
+  BENCHMARK_ENTRY  (tcp_multi_accept_exclusive4)
+  BENCHMARK_ENTRY  (tcp_multi_accept_exclusive8)
 
   BENCHMARK_ENTRY  (udp_pummel_1v1)
   BENCHMARK_ENTRY  (udp_pummel_1v10)
@@ -146,6 +163,9 @@ TASK_LIST_START
   BENCHMARK_ENTRY  (getaddrinfo)
 
   BENCHMARK_ENTRY  (fs_stat)
+  BENCHMARK_ENTRY  (req_pool)
+  BENCHMARK_ENTRY  (loop_group_scaling)
+  BENCHMARK_ENTRY  (io_priority)
 
   BENCHMARK_ENTRY  (async1)
   BENCHMARK_ENTRY  (async2)
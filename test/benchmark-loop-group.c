@@ -0,0 +1,143 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_HOPS          (64 * 1024)
+#define TOKENS_PER_LOOP   4
+#define WORK_PER_HOP      4096
+
+/* A token carries a unit of CPU-bound work from loop to loop. Every hop is a
+ * cross-thread uv_loop_group_post() so the benchmark measures both how well
+ * the work spreads over the loops and what the wake-ups cost.
+ */
+typedef struct {
+  unsigned int index;
+  unsigned int hops;
+  uint32_t state;
+} token_t;
+
+static uv_loop_group_t group;
+static uv_mutex_t mutex;
+static uv_sem_t done;
+static unsigned int tokens_left;
+static volatile uint32_t sink;
+
+
+static void hop_cb(uv_loop_t* loop, void* arg) {
+  token_t* token;
+  uint32_t x;
+  int i;
+
+  token = arg;
+
+  /* xorshift32, enough to keep the CPU busy. */
+  x = token->state;
+  for (i = 0; i < WORK_PER_HOP; i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+  }
+  token->state = x;
+  sink = x;
+
+  if (--token->hops == 0) {
+    uv_mutex_lock(&mutex);
+    if (--tokens_left == 0)
+      uv_sem_post(&done);
+    uv_mutex_unlock(&mutex);
+    return;
+  }
+
+  token->index = (token->index + 1) % uv_loop_group_size(&group);
+  ASSERT(0 == uv_loop_group_post(&group, token->index, hop_cb, token));
+}
+
+
+static double run(unsigned int nloops) {
+  token_t* tokens;
+  unsigned int ntokens;
+  unsigned int i;
+  uint64_t before;
+  uint64_t after;
+
+  ASSERT(0 == uv_loop_group_init(&group, nloops, UV_LOOP_GROUP_PIN));
+
+  ntokens = nloops * TOKENS_PER_LOOP;
+  tokens = calloc(ntokens, sizeof(*tokens));
+  ASSERT(tokens != NULL);
+  tokens_left = ntokens;
+
+  before = uv_hrtime();
+
+  for (i = 0; i < ntokens; i++) {
+    tokens[i].index = i % nloops;
+    tokens[i].hops = NUM_HOPS / ntokens;
+    tokens[i].state = i + 1;
+    ASSERT(0 == uv_loop_group_post(&group,
+                                   tokens[i].index,
+                                   hop_cb,
+                                   tokens + i));
+  }
+
+  uv_sem_wait(&done);
+  after = uv_hrtime();
+
+  uv_loop_group_stop(&group);
+  ASSERT(0 == uv_loop_group_join(&group));
+  free(tokens);
+
+  return NUM_HOPS / ((after - before) / 1e9);
+}
+
+
+BENCHMARK_IMPL(loop_group_scaling) {
+  unsigned int nloops;
+  double base;
+  double rate;
+
+  ASSERT(0 == uv_mutex_init(&mutex));
+  ASSERT(0 == uv_sem_init(&done, 0));
+
+  base = 0;
+  for (nloops = 1; nloops <= 8; nloops *= 2) {
+    rate = run(nloops);
+    if (nloops == 1)
+      base = rate;
+
+    printf("loop_group_scaling: %u loop%s: %s hops/s (%.2fx)\n",
+           nloops,
+           nloops == 1 ? "" : "s",
+           fmt(rate),
+           rate / base);
+    fflush(stdout);
+  }
+
+  uv_sem_destroy(&done);
+  uv_mutex_destroy(&mutex);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -70,6 +70,16 @@ struct server_ctx {
   uv_async_t async_handle;
   uv_thread_t thread_id;
   uv_sem_t semaphore;
+  int exclusive;
+  /* A wake-up is wasted when the loop comes out of the poll phase without
+   * accepting or reading anything, i.e. another loop got the connection.
+   */
+  uv_prepare_t prepare_handle;
+  uv_check_t check_handle;
+  unsigned int num_callbacks;
+  unsigned int prepare_callbacks;
+  unsigned int num_wakeups;
+  unsigned int num_wasted;
 };
 
 struct client_ctx {
@@ -91,6 +101,8 @@ static void ipc_alloc_cb(uv_handle_t* handle,
                          uv_buf_t* buf);
 
 static void sv_async_cb(uv_async_t* handle);
+static void sv_prepare_cb(uv_prepare_t* handle);
+static void sv_check_cb(uv_check_t* handle);
 static void sv_connection_cb(uv_stream_t* server_handle, int status);
 static void sv_read_cb(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf);
 static void sv_alloc_cb(uv_handle_t* handle,
@@ -265,6 +277,16 @@ static void server_cb(void *arg) {
   get_listen_handle(&loop, (uv_stream_t*) &ctx->server_handle);
   uv_sem_post(&ctx->semaphore);
 
+  if (ctx->exclusive)
+    ASSERT(0 == uv_tcp_exclusive_accept((uv_tcp_t*) &ctx->server_handle, 1));
+
+  ASSERT(0 == uv_prepare_init(&loop, &ctx->prepare_handle));
+  ASSERT(0 == uv_prepare_start(&ctx->prepare_handle, sv_prepare_cb));
+  uv_unref((uv_handle_t*) &ctx->prepare_handle);
+  ASSERT(0 == uv_check_init(&loop, &ctx->check_handle));
+  ASSERT(0 == uv_check_start(&ctx->check_handle, sv_check_cb));
+  uv_unref((uv_handle_t*) &ctx->check_handle);
+
   /* Now start the actual benchmark. */
   ASSERT(0 == uv_listen((uv_stream_t*) &ctx->server_handle,
                         128,
@@ -280,6 +302,24 @@ static void sv_async_cb(uv_async_t* handle) {
   ctx = container_of(handle, struct server_ctx, async_handle);
   uv_close((uv_handle_t*) &ctx->server_handle, NULL);
   uv_close((uv_handle_t*) &ctx->async_handle, NULL);
+  uv_close((uv_handle_t*) &ctx->prepare_handle, NULL);
+  uv_close((uv_handle_t*) &ctx->check_handle, NULL);
+}
+
+
+static void sv_prepare_cb(uv_prepare_t* handle) {
+  struct server_ctx* ctx;
+  ctx = container_of(handle, struct server_ctx, prepare_handle);
+  ctx->prepare_callbacks = ctx->num_callbacks;
+}
+
+
+static void sv_check_cb(uv_check_t* handle) {
+  struct server_ctx* ctx;
+  ctx = container_of(handle, struct server_ctx, check_handle);
+  ctx->num_wakeups++;
+  if (ctx->num_callbacks == ctx->prepare_callbacks)
+    ctx->num_wasted++;
 }
 
 
@@ -300,9 +340,11 @@ static void sv_connection_cb(uv_stream_t* server_handle, int status) {
   else
     ASSERT(0);
 
+  ((uv_handle_t*) storage)->data = ctx;
   ASSERT(0 == uv_accept(server_handle, (uv_stream_t*) storage));
   ASSERT(0 == uv_read_start((uv_stream_t*) storage, sv_alloc_cb, sv_read_cb));
   ctx->num_connects++;
+  ctx->num_callbacks++;
 }
 
 
@@ -318,6 +360,10 @@ static void sv_alloc_cb(uv_handle_t* handle,
 static void sv_read_cb(uv_stream_t* handle,
                        ssize_t nread,
                        const uv_buf_t* buf) {
+  struct server_ctx* ctx;
+
+  ctx = handle->data;
+  ctx->num_callbacks++;
   ASSERT(nread == UV_EOF);
   uv_close((uv_handle_t*) handle, (uv_close_cb) free);
 }
@@ -355,17 +401,32 @@ static void cl_close_cb(uv_handle_t* handle) {
 }
 
 
-static int test_tcp(unsigned int num_servers, unsigned int num_clients) {
+static int test_tcp(unsigned int num_servers,
+                    unsigned int num_clients,
+                    int exclusive) {
   struct server_ctx* servers;
   struct client_ctx* clients;
   uv_loop_t* loop;
   uv_tcp_t* handle;
+  uv_tcp_t probe;
   unsigned int i;
   double time;
 
   ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &listen_addr));
   loop = uv_default_loop();
 
+  if (exclusive) {
+    ASSERT(0 == uv_tcp_init(loop, &probe));
+    if (uv_tcp_exclusive_accept(&probe, 1) == UV_ENOTSUP) {
+      uv_close((uv_handle_t*) &probe, NULL);
+      ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+      MAKE_VALGRIND_HAPPY();
+      RETURN_SKIP("Exclusive accept is not supported on this platform");
+    }
+    uv_close((uv_handle_t*) &probe, NULL);
+    ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  }
+
   servers = calloc(num_servers, sizeof(servers[0]));
   clients = calloc(num_clients, sizeof(clients[0]));
   ASSERT(servers != NULL);
@@ -377,6 +438,7 @@ static int test_tcp(unsigned int num_servers, unsigned int num_clients) {
    */
   for (i = 0; i < num_servers; i++) {
     struct server_ctx* ctx = servers + i;
+    ctx->exclusive = exclusive;
     ASSERT(0 == uv_sem_init(&ctx->semaphore, 0));
     ASSERT(0 == uv_thread_create(&ctx->thread_id, server_cb, ctx));
   }
@@ -410,18 +472,26 @@ static int test_tcp(unsigned int num_servers, unsigned int num_clients) {
     uv_sem_destroy(&ctx->semaphore);
   }
 
-  printf("accept%u: %.0f accepts/sec (%u total)\n",
+  printf("accept%u%s: %.0f accepts/sec (%u total)\n",
          num_servers,
+         exclusive ? "_exclusive" : "",
          NUM_CONNECTS / time,
          NUM_CONNECTS);
 
   for (i = 0; i < num_servers; i++) {
     struct server_ctx* ctx = servers + i;
-    printf("  thread #%u: %.0f accepts/sec (%u total, %.1f%%)\n",
+    double wasted = 0;
+    if (ctx->num_wakeups > 0)
+      wasted = ctx->num_wasted * 100.0 / ctx->num_wakeups;
+    printf("  thread #%u: %.0f accepts/sec (%u total, %.1f%%), "
+           "%u of %u wake-ups wasted (%.1f%%)\n",
            i,
            ctx->num_connects / time,
            ctx->num_connects,
-           ctx->num_connects * 100.0 / NUM_CONNECTS);
+           ctx->num_connects * 100.0 / NUM_CONNECTS,
+           ctx->num_wasted,
+           ctx->num_wakeups,
+           wasted);
   }
 
   free(clients);
@@ -433,15 +503,30 @@ static int test_tcp(unsigned int num_servers, unsigned int num_clients) {
 
 
 BENCHMARK_IMPL(tcp_multi_accept2) {
-  return test_tcp(2, 40);
+  return test_tcp(2, 40, 0);
 }
 
 
 BENCHMARK_IMPL(tcp_multi_accept4) {
-  return test_tcp(4, 40);
+  return test_tcp(4, 40, 0);
 }
 
 
 BENCHMARK_IMPL(tcp_multi_accept8) {
-  return test_tcp(8, 40);
+  return test_tcp(8, 40, 0);
+}
+
+
+BENCHMARK_IMPL(tcp_multi_accept_exclusive2) {
+  return test_tcp(2, 40, 1);
+}
+
+
+BENCHMARK_IMPL(tcp_multi_accept_exclusive4) {
+  return test_tcp(4, 40, 1);
+}
+
+
+BENCHMARK_IMPL(tcp_multi_accept_exclusive8) {
+  return test_tcp(8, 40, 1);
 }
@@ -0,0 +1,238 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_WARMUP_OPS        1000
+#define NUM_OPS               (100 * 1000)
+#define MAX_CONCURRENT_REQS   16
+
+typedef struct {
+  const char* name;
+  int pooled;
+  int target;
+  int started;
+  int completed;
+} bench_t;
+
+static uv_loop_t loop;
+static uv_udp_t sender;
+static uv_udp_t receiver;
+static struct sockaddr_in addr;
+static char recv_storage[64];
+static char payload[] = "PING";
+static bench_t* bench;
+
+/* Calls into the global allocator plus request allocations made by the
+ * benchmark itself when it doesn't use the pool.
+ */
+static uint64_t allocs;
+
+
+static void* counting_malloc(size_t size) {
+  allocs++;
+  return malloc(size);
+}
+
+
+static void* counting_realloc(void* ptr, size_t size) {
+  allocs++;
+  return realloc(ptr, size);
+}
+
+
+static void* counting_calloc(size_t count, size_t size) {
+  allocs++;
+  return calloc(count, size);
+}
+
+
+static uv_req_t* req_new(uv_req_type type) {
+  if (bench->pooled)
+    return uv_req_acquire(&loop, type);
+
+  allocs++;
+  return malloc(uv_req_size(type));
+}
+
+
+static void req_free(uv_req_t* req) {
+  if (bench->pooled)
+    uv_req_release(&loop, req);
+  else
+    free(req);
+}
+
+
+static void alloc_cb(uv_handle_t* handle,
+                     size_t suggested_size,
+                     uv_buf_t* buf) {
+  buf->base = recv_storage;
+  buf->len = sizeof(recv_storage);
+}
+
+
+static void recv_cb(uv_udp_t* handle,
+                    ssize_t nread,
+                    const uv_buf_t* buf,
+                    const struct sockaddr* peer,
+                    unsigned flags) {
+  ASSERT(nread >= 0);
+}
+
+
+static void send_cb(uv_udp_send_t* req, int status);
+
+
+static void send_next(void) {
+  uv_udp_send_t* req;
+  uv_buf_t buf;
+
+  req = (uv_udp_send_t*) req_new(UV_UDP_SEND);
+  ASSERT(req != NULL);
+
+  buf = uv_buf_init(payload, sizeof(payload) - 1);
+  ASSERT(0 == uv_udp_send(req,
+                          &sender,
+                          &buf,
+                          1,
+                          (const struct sockaddr*) &addr,
+                          send_cb));
+  bench->started++;
+}
+
+
+static void send_cb(uv_udp_send_t* req, int status) {
+  ASSERT(status == 0);
+  req_free((uv_req_t*) req);
+  bench->completed++;
+
+  if (bench->started < bench->target)
+    send_next();
+}
+
+
+static void stat_cb(uv_fs_t* req);
+
+
+static void stat_next(void) {
+  uv_fs_t* req;
+
+  req = (uv_fs_t*) req_new(UV_FS);
+  ASSERT(req != NULL);
+  ASSERT(0 == uv_fs_stat(&loop, req, ".", stat_cb));
+  bench->started++;
+}
+
+
+static void stat_cb(uv_fs_t* req) {
+  ASSERT(req->result == 0);
+
+  /* uv_req_release() does this for pooled requests. */
+  if (!bench->pooled)
+    uv_fs_req_cleanup(req);
+
+  req_free((uv_req_t*) req);
+  bench->completed++;
+
+  if (bench->started < bench->target)
+    stat_next();
+}
+
+
+static void run(bench_t* b, void (*start)(void)) {
+  uint64_t before;
+  uint64_t after;
+  int i;
+
+  bench = b;
+
+  /* Fill the pool and the loop's arena before measuring. */
+  b->target = NUM_WARMUP_OPS;
+  b->started = 0;
+  b->completed = 0;
+  for (i = 0; i < MAX_CONCURRENT_REQS; i++)
+    start();
+  while (b->completed < b->target)
+    ASSERT(0 <= uv_run(&loop, UV_RUN_ONCE));
+
+  b->target = NUM_OPS;
+  b->started = 0;
+  b->completed = 0;
+  allocs = 0;
+
+  before = uv_hrtime();
+  for (i = 0; i < MAX_CONCURRENT_REQS; i++)
+    start();
+  while (b->completed < b->target)
+    ASSERT(0 <= uv_run(&loop, UV_RUN_ONCE));
+  after = uv_hrtime();
+
+  printf("%s: %.2f allocs/op, %s ops/s\n",
+         b->name,
+         (double) allocs / NUM_OPS,
+         fmt(NUM_OPS / ((after - before) / 1e9)));
+  fflush(stdout);
+}
+
+
+/* Compares requests that are malloc'd and freed for every operation with
+ * requests taken from the loop's pool. The loop uses an arena so that the
+ * path copies made by fs requests don't show up in the count either.
+ */
+BENCHMARK_IMPL(req_pool) {
+  bench_t benches[] = {
+    { "udp sends (malloc)", 0 },
+    { "udp sends (pooled)", 1 },
+    { "fs stats (malloc)", 0 },
+    { "fs stats (pooled)", 1 },
+  };
+
+  ASSERT(0 == uv_replace_allocator(counting_malloc,
+                                   counting_realloc,
+                                   counting_calloc,
+                                   free));
+
+  ASSERT(0 == uv_loop_init(&loop));
+  ASSERT(0 == uv_loop_configure(&loop, UV_LOOP_USE_ARENA));
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_udp_init(&loop, &receiver));
+  ASSERT(0 == uv_udp_bind(&receiver, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_udp_recv_start(&receiver, alloc_cb, recv_cb));
+  ASSERT(0 == uv_udp_init(&loop, &sender));
+
+  run(&benches[0], send_next);
+  run(&benches[1], send_next);
+  run(&benches[2], stat_next);
+  run(&benches[3], stat_next);
+
+  uv_close((uv_handle_t*) &sender, NULL);
+  uv_close((uv_handle_t*) &receiver, NULL);
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT(0 == uv_loop_close(&loop));
+
+  return 0;
+}
@@ -0,0 +1,154 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Bytes written per run and writes kept in flight. */
+#define TOTAL_BYTES (256 * 1024 * 1024)
+#define WINDOW 8
+
+static uv_tcp_t tcp_client;
+static uv_connect_t connect_req;
+static uv_shutdown_t shutdown_req;
+static uv_write_t write_reqs[WINDOW];
+static char* write_buf;
+static size_t write_size;
+static size_t bytes_queued;
+static size_t bytes_written;
+static int zerocopy;
+static int zerocopy_err;
+
+
+static void write_cb(uv_write_t* req, int status);
+
+
+static void send_one(uv_write_t* req) {
+  uv_buf_t buf;
+
+  buf = uv_buf_init(write_buf, write_size);
+  ASSERT(0 == uv_write(req, (uv_stream_t*) &tcp_client, &buf, 1, write_cb));
+  bytes_queued += write_size;
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+}
+
+
+static void shutdown_cb(uv_shutdown_t* req, int status) {
+  ASSERT(status == 0);
+  uv_close((uv_handle_t*) &tcp_client, close_cb);
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+  bytes_written += write_size;
+
+  if (bytes_queued < TOTAL_BYTES)
+    send_one(req);
+  else if (bytes_written == TOTAL_BYTES)
+    ASSERT(0 == uv_shutdown(&shutdown_req,
+                            (uv_stream_t*) &tcp_client,
+                            shutdown_cb));
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  int i;
+
+  ASSERT(status == 0);
+
+  if (zerocopy) {
+    zerocopy_err = uv_tcp_zerocopy(&tcp_client, 1, 0);
+    if (zerocopy_err != 0) {
+      uv_close((uv_handle_t*) &tcp_client, close_cb);
+      return;
+    }
+  }
+
+  for (i = 0; i < WINDOW; i++)
+    send_one(&write_reqs[i]);
+}
+
+
+static double run(uv_loop_t* loop, const struct sockaddr* addr) {
+  uint64_t start;
+
+  bytes_queued = 0;
+  bytes_written = 0;
+  ASSERT(0 == uv_tcp_init(loop, &tcp_client));
+  ASSERT(0 == uv_tcp_connect(&connect_req, &tcp_client, addr, connect_cb));
+
+  start = uv_hrtime();
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  return (uv_hrtime() - start) / 1e9;
+}
+
+
+BENCHMARK_IMPL(tcp_zerocopy) {
+  static const size_t sizes[] = { 16384, 65536, 262144, 1048576 };
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  double copy_secs;
+  double zerocopy_secs;
+  size_t i;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+
+  write_buf = malloc(sizes[ARRAY_SIZE(sizes) - 1]);
+  ASSERT(write_buf != NULL);
+  memset(write_buf, 'x', sizes[ARRAY_SIZE(sizes) - 1]);
+
+  for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+    write_size = sizes[i];
+
+    zerocopy = 0;
+    copy_secs = run(loop, (const struct sockaddr*) &addr);
+
+    zerocopy = 1;
+    zerocopy_secs = run(loop, (const struct sockaddr*) &addr);
+
+    if (zerocopy_err != 0) {
+      fprintf(stderr, "zero-copy writes: %s\n", uv_strerror(zerocopy_err));
+      break;
+    }
+
+    fprintf(stderr,
+            "%7lu byte writes: copy %.0f MB/s, zerocopy %.0f MB/s\n",
+            (unsigned long) write_size,
+            TOTAL_BYTES / copy_secs / (1024 * 1024),
+            TOTAL_BYTES / zerocopy_secs / (1024 * 1024));
+    fflush(stderr);
+  }
+
+  free(write_buf);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,71 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+TEST_IMPL(cpu_topology) {
+  uv_cpu_topology_t* cpus;
+  int allowed;
+  int count;
+  int err;
+  int i;
+
+  err = uv_cpu_topology(&cpus, &count);
+#if !defined(__linux__)
+  ASSERT(err == UV_ENOSYS);
+  ASSERT(cpus == NULL);
+  ASSERT(count == 0);
+  RETURN_SKIP("uv_cpu_topology() is not implemented on this platform");
+#endif
+  ASSERT(err == 0);
+  ASSERT(count > 0);
+
+  allowed = 0;
+  for (i = 0; i < count; i++) {
+    printf("cpu=%d core=%d package=%d cache=%d node=%d allowed=%d\n",
+           cpus[i].cpu,
+           cpus[i].core,
+           cpus[i].package,
+           cpus[i].cache,
+           cpus[i].node,
+           cpus[i].allowed);
+
+    if (i > 0)
+      ASSERT(cpus[i].cpu > cpus[i - 1].cpu);
+
+    /* Cores and caches are named after their lowest-numbered CPU. */
+    ASSERT(cpus[i].core <= cpus[i].cpu);
+    ASSERT(cpus[i].cache <= cpus[i].cpu);
+    ASSERT(cpus[i].package >= -1);
+    ASSERT(cpus[i].node >= -1);
+
+    if (cpus[i].allowed)
+      allowed++;
+  }
+
+  /* We're running on at least one of them. */
+  ASSERT(allowed > 0);
+
+  uv_free_cpu_topology(cpus, count);
+
+  return 0;
+}
@@ -0,0 +1,117 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#define NUM_DEFERRED 40
+
+static uv_timer_t timers[2];
+static int order[NUM_DEFERRED];
+static int ndeferred;
+static int nested_cb_called;
+static int close_cb_called;
+
+
+static void record_cb(void* data) {
+  order[ndeferred++] = (int) (intptr_t) data;
+}
+
+
+static void nested_cb(void* data) {
+  ASSERT(data == &nested_cb_called);
+  nested_cb_called++;
+}
+
+
+static void outer_cb(void* data) {
+  /* Runs in the same drain, before the loop moves on. */
+  ASSERT(0 == uv_defer(uv_default_loop(), nested_cb, data));
+}
+
+
+static void timer1_cb(uv_timer_t* handle) {
+  int i;
+
+  /* Moves the head of the ring along so the next batch wraps around. */
+  for (i = 0; i < 10; i++)
+    ASSERT(0 == uv_defer(handle->loop, record_cb, (void*) (intptr_t) i));
+  ASSERT(0 == uv_defer(handle->loop, outer_cb, &nested_cb_called));
+  ASSERT(0 == ndeferred);
+}
+
+
+static void timer2_cb(uv_timer_t* handle) {
+  int i;
+
+  /* Both timers were due in the same iteration, yet everything the first
+   * one deferred has run.
+   */
+  ASSERT(10 == ndeferred);
+  ASSERT(1 == nested_cb_called);
+
+  ndeferred = 0;
+  for (i = 0; i < NUM_DEFERRED; i++)
+    ASSERT(0 == uv_defer(handle->loop, record_cb, (void*) (intptr_t) i));
+  ASSERT(0 == uv_backend_timeout(handle->loop));
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+  ASSERT(0 == uv_defer(handle->loop, nested_cb, &nested_cb_called));
+}
+
+
+TEST_IMPL(defer) {
+  uv_loop_t* loop;
+  int i;
+
+  loop = uv_default_loop();
+  ASSERT(UV_EINVAL == uv_defer(loop, NULL, NULL));
+
+  /* A deferred callback keeps the loop alive on its own. */
+  ASSERT(0 == uv_defer(loop, nested_cb, &nested_cb_called));
+  ASSERT(1 == uv_loop_alive(loop));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(1 == nested_cb_called);
+  nested_cb_called = 0;
+
+  ASSERT(0 == uv_timer_init(loop, &timers[0]));
+  ASSERT(0 == uv_timer_init(loop, &timers[1]));
+  ASSERT(0 == uv_timer_start(&timers[0], timer1_cb, 1, 0));
+  ASSERT(0 == uv_timer_start(&timers[1], timer2_cb, 1, 0));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(NUM_DEFERRED == ndeferred);
+  for (i = 0; i < NUM_DEFERRED; i++)
+    ASSERT(i == order[i]);
+
+  /* So do ones deferred from a close callback. */
+  uv_close((uv_handle_t*) &timers[0], close_cb);
+  uv_close((uv_handle_t*) &timers[1], close_cb);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(2 == close_cb_called);
+  ASSERT(3 == nested_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
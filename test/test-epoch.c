@@ -0,0 +1,246 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdlib.h>
+
+#define NUM_READERS 3
+#define NUM_UPDATES 100
+
+typedef struct {
+  int alive;
+  int version;
+} config_t;
+
+typedef struct {
+  uv_thread_t thread;
+  uv_loop_t loop;
+  uv_idle_t idle;
+  uv_async_t stop;
+  uv_sem_t ready;
+  int busy;
+  int reads;
+} reader_t;
+
+static uv_epoch_t epoch;
+static void* shared_config;
+static int deferred_cb_called;
+
+
+static void deferred_cb(void* arg) {
+  ASSERT(arg == &epoch);
+  deferred_cb_called++;
+}
+
+
+static void timer_cb(uv_timer_t* handle) {
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(epoch_defer) {
+  uv_timer_t timer;
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_epoch_init(&epoch));
+  ASSERT(0 == uv_epoch_register(&epoch, loop));
+  ASSERT(UV_EEXIST == uv_epoch_register(&epoch, loop));
+  ASSERT(UV_EINVAL == uv_epoch_defer(&epoch, NULL, NULL));
+
+  ASSERT(0 == uv_epoch_defer(&epoch, deferred_cb, &epoch));
+  ASSERT(0 == deferred_cb_called);
+
+  /* The loop passes a quiescent state on its way through the poll phase. */
+  ASSERT(0 == uv_timer_init(loop, &timer));
+  ASSERT(0 == uv_timer_start(&timer, timer_cb, 1, 0));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(1 == deferred_cb_called);
+
+  ASSERT(0 == uv_epoch_unregister(&epoch, loop));
+  ASSERT(UV_ENOENT == uv_epoch_unregister(&epoch, loop));
+
+  /* Pending callbacks run when the domain is destroyed. */
+  ASSERT(0 == uv_epoch_defer(&epoch, deferred_cb, &epoch));
+  ASSERT(1 == deferred_cb_called);
+  uv_epoch_destroy(&epoch);
+  ASSERT(2 == deferred_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void reader_idle_cb(uv_idle_t* handle) {
+  reader_t* reader;
+  config_t* config;
+
+  reader = container_of(handle, reader_t, idle);
+  config = uv_epoch_read(&shared_config);
+  ASSERT(config != NULL);
+  ASSERT(config->alive == 1);
+  reader->reads++;
+}
+
+
+static void reader_stop_cb(uv_async_t* handle) {
+  reader_t* reader;
+
+  reader = container_of(handle, reader_t, stop);
+  uv_close((uv_handle_t*) &reader->stop, NULL);
+  if (reader->busy)
+    uv_close((uv_handle_t*) &reader->idle, NULL);
+}
+
+
+static void reader_thread(void* arg) {
+  reader_t* reader;
+
+  reader = arg;
+  ASSERT(0 == uv_loop_init(&reader->loop));
+  ASSERT(0 == uv_epoch_register(&epoch, &reader->loop));
+  ASSERT(0 == uv_async_init(&reader->loop, &reader->stop, reader_stop_cb));
+
+  /* A reader without an idle handle stays blocked in the kernel and must not
+   * hold up writers.
+   */
+  if (reader->busy) {
+    ASSERT(0 == uv_idle_init(&reader->loop, &reader->idle));
+    ASSERT(0 == uv_idle_start(&reader->idle, reader_idle_cb));
+  }
+
+  uv_sem_post(&reader->ready);
+  ASSERT(0 == uv_run(&reader->loop, UV_RUN_DEFAULT));
+
+  ASSERT(0 == uv_epoch_unregister(&epoch, &reader->loop));
+  ASSERT(0 == uv_loop_close(&reader->loop));
+}
+
+
+static config_t* config_new(int version) {
+  config_t* config;
+
+  config = malloc(sizeof(*config));
+  ASSERT(config != NULL);
+  config->alive = 1;
+  config->version = version;
+
+  return config;
+}
+
+
+static void config_free(void* arg) {
+  config_t* config;
+
+  config = arg;
+  config->alive = 0;
+  free(config);
+}
+
+
+TEST_IMPL(epoch_synchronize) {
+  reader_t readers[NUM_READERS];
+  config_t* old;
+  int i;
+
+  ASSERT(0 == uv_epoch_init(&epoch));
+  shared_config = config_new(0);
+
+  for (i = 0; i < NUM_READERS; i++) {
+    readers[i].busy = (i != 0);
+    readers[i].reads = 0;
+    ASSERT(0 == uv_sem_init(&readers[i].ready, 0));
+    ASSERT(0 == uv_thread_create(&readers[i].thread,
+                                 reader_thread,
+                                 &readers[i]));
+    uv_sem_wait(&readers[i].ready);
+  }
+
+  for (i = 1; i <= NUM_UPDATES; i++) {
+    old = uv_epoch_publish(&shared_config, config_new(i));
+    ASSERT(old->version == i - 1);
+
+    if (i % 2) {
+      uv_epoch_synchronize(&epoch);
+      old->alive = 0;
+      free(old);
+    } else {
+      ASSERT(0 == uv_epoch_defer(&epoch, config_free, old));
+    }
+  }
+
+  /* Waits for the deferred frees as well. */
+  uv_epoch_synchronize(&epoch);
+
+  for (i = 0; i < NUM_READERS; i++) {
+    ASSERT(0 == uv_async_send(&readers[i].stop));
+    ASSERT(0 == uv_thread_join(&readers[i].thread));
+    uv_sem_destroy(&readers[i].ready);
+    ASSERT(readers[i].busy == (readers[i].reads > 0));
+  }
+
+  uv_epoch_destroy(&epoch);
+  config_free(shared_config);
+
+  return 0;
+}
+
+
+static void nowait_timer_cb(uv_timer_t* handle) {
+  ASSERT(0 && "should not have been called");
+}
+
+
+TEST_IMPL(epoch_offline) {
+  uv_timer_t timer;
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_epoch_init(&epoch));
+  ASSERT(0 == uv_epoch_register(&epoch, loop));
+
+  /* A loop that hasn't been run yet can't hold references. */
+  uv_epoch_synchronize(&epoch);
+
+  /* Nor can one that is between UV_RUN_NOWAIT iterations. */
+  ASSERT(0 == uv_timer_init(loop, &timer));
+  ASSERT(0 == uv_timer_start(&timer, nowait_timer_cb, 10000, 0));
+  ASSERT(1 == uv_run(loop, UV_RUN_NOWAIT));
+  uv_epoch_synchronize(&epoch);
+
+  /* Or one that uv_run() has returned from. */
+  uv_close((uv_handle_t*) &timer, NULL);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  uv_epoch_synchronize(&epoch);
+
+  /* uv_epoch_quiescent() doesn't bring it back online. */
+  uv_epoch_quiescent(loop);
+  uv_epoch_synchronize(&epoch);
+
+  ASSERT(0 == uv_epoch_unregister(&epoch, loop));
+  uv_epoch_destroy(&epoch);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,161 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#define NUM_SPINS 10
+#define BUDGET_MS 5
+
+static uv_idle_task_t tasks[3];
+static uv_idle_t idle;
+static uv_check_t check;
+static uv_timer_t timer;
+static int idle_cb_called;
+static int check_cb_called;
+static int task_cb_called;
+static int task_iteration[2];
+static uint64_t task_deadline[2];
+
+
+static void idle_cb(uv_idle_t* handle) {
+  /* Tasks don't run while the loop is kept busy. */
+  ASSERT(0 == task_cb_called);
+  if (++idle_cb_called == NUM_SPINS)
+    uv_idle_stop(handle);
+}
+
+
+static void task_cb(uv_idle_task_t* task, uint64_t deadline) {
+  ASSERT(NUM_SPINS == idle_cb_called);
+  ASSERT(task == &tasks[task_cb_called]);
+  ASSERT(deadline > uv_hrtime());
+  task_cb_called++;
+
+  /* Cancelling a task that's running or has run is an error. */
+  ASSERT(UV_EINVAL == uv_idle_task_cancel(task));
+}
+
+
+TEST_IMPL(idle_task) {
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+
+  ASSERT(UV_EINVAL == uv_idle_task_post(loop, &tasks[0], NULL));
+
+  ASSERT(0 == uv_idle_task_post(loop, &tasks[0], task_cb));
+  ASSERT(0 == uv_idle_task_post(loop, &tasks[2], task_cb));
+  ASSERT(0 == uv_idle_task_post(loop, &tasks[1], task_cb));
+  ASSERT(0 == uv_idle_task_cancel(&tasks[2]));
+  ASSERT(1 == uv_loop_alive(loop));
+
+  ASSERT(0 == uv_idle_init(loop, &idle));
+  ASSERT(0 == uv_idle_start(&idle, idle_cb));
+
+  /* Queued tasks keep the loop alive until they've run. */
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(NUM_SPINS == idle_cb_called);
+  ASSERT(2 == task_cb_called);
+
+  /* Nothing else to do, but UV_RUN_NOWAIT never blocks. */
+  ASSERT(0 == uv_idle_task_post(loop, &tasks[0], task_cb));
+  ASSERT(1 == uv_run(loop, UV_RUN_NOWAIT));
+  ASSERT(2 == task_cb_called);
+  ASSERT(0 == uv_idle_task_cancel(&tasks[0]));
+  ASSERT(0 == uv_loop_alive(loop));
+
+  uv_close((uv_handle_t*) &idle, NULL);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void check_cb(uv_check_t* handle) {
+  check_cb_called++;
+}
+
+
+static void timer_close_cb(uv_timer_t* handle) {
+  ASSERT(3 == task_cb_called);
+  uv_close((uv_handle_t*) &check, NULL);
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static void timer_task_cb(uv_idle_task_t* task, uint64_t deadline) {
+  /* The timer comes before the budget. */
+  ASSERT(deadline <= uv_hrtime() + 10 * 1000000);
+  task_cb_called++;
+}
+
+
+static void timer_cb(uv_timer_t* handle) {
+  /* Both tasks ran before the timer was due. */
+  ASSERT(2 == task_cb_called);
+
+  ASSERT(0 == uv_loop_configure(handle->loop, UV_LOOP_IDLE_TASK_BUDGET, 1000));
+  ASSERT(0 == uv_idle_task_post(handle->loop, &tasks[2], timer_task_cb));
+  ASSERT(0 == uv_timer_start(handle, timer_close_cb, 10, 0));
+}
+
+
+static void slow_task_cb(uv_idle_task_t* task, uint64_t deadline) {
+  int i;
+
+  ASSERT(deadline <= uv_hrtime() + BUDGET_MS * 1000000);
+  i = task_cb_called++;
+  task_iteration[i] = check_cb_called;
+  task_deadline[i] = deadline;
+
+  /* Use up the whole idle period. */
+  while (uv_hrtime() < deadline);
+}
+
+
+TEST_IMPL(idle_task_deadline) {
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  ASSERT(UV_EINVAL == uv_loop_configure(loop, UV_LOOP_IDLE_TASK_BUDGET, 0));
+  ASSERT(0 == uv_loop_configure(loop, UV_LOOP_IDLE_TASK_BUDGET, BUDGET_MS));
+
+  ASSERT(0 == uv_check_init(loop, &check));
+  ASSERT(0 == uv_check_start(&check, check_cb));
+  ASSERT(0 == uv_timer_init(loop, &timer));
+  ASSERT(0 == uv_timer_start(&timer, timer_cb, 100, 0));
+  ASSERT(0 == uv_idle_task_post(loop, &tasks[0], slow_task_cb));
+  ASSERT(0 == uv_idle_task_post(loop, &tasks[1], slow_task_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(3 == task_cb_called);
+
+  /* Each task got its own idle period, with a non-blocking poll and the
+   * check phase in between.
+   */
+  ASSERT(task_iteration[1] > task_iteration[0]);
+  ASSERT(task_deadline[1] > task_deadline[0]);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,129 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#ifndef _WIN32
+# include <sys/socket.h>
+# include <unistd.h>
+#endif
+
+#define NUM_BULK 16
+
+static uv_poll_t bulk[NUM_BULK];
+static int bulk_fds[NUM_BULK][2];
+static uv_pipe_t control;
+static int control_fds[2];
+static char slab[16];
+static int calls;
+static int control_call;
+
+
+static void close_cb(uv_handle_t* handle) {
+  calls++;
+}
+
+
+static void bulk_cb(uv_poll_t* handle, int status, int events) {
+  ASSERT(status == 0);
+  ASSERT(events & UV_READABLE);
+  calls++;
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  buf->base = slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void control_read_cb(uv_stream_t* handle,
+                            ssize_t nread,
+                            const uv_buf_t* buf) {
+  ASSERT(nread == 1);
+  control_call = calls++;
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(io_priority) {
+#ifdef _WIN32
+  RETURN_SKIP("Not supported on Windows.");
+#else
+  uv_timer_t timer;
+  uv_loop_t* loop;
+  int i;
+
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_timer_init(loop, &timer));
+  ASSERT(UV_EINVAL == uv_handle_set_io_priority((uv_handle_t*) &timer,
+                                                UV_IO_PRIORITY_HIGH));
+  uv_close((uv_handle_t*) &timer, NULL);
+
+  /* Every watcher is readable by the time the loop first polls. The control
+   * handle is started last, so without a priority it would come last in the
+   * batch as well.
+   */
+  for (i = 0; i < NUM_BULK; i++) {
+    ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, bulk_fds[i]));
+    ASSERT(1 == write(bulk_fds[i][1], "b", 1));
+    ASSERT(0 == uv_poll_init(loop, &bulk[i], bulk_fds[i][0]));
+    ASSERT(0 == uv_poll_start(&bulk[i], UV_READABLE, bulk_cb));
+  }
+
+  ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, control_fds));
+  ASSERT(1 == write(control_fds[1], "c", 1));
+  ASSERT(0 == uv_pipe_init(loop, &control, 0));
+  ASSERT(0 == uv_pipe_open(&control, control_fds[0]));
+  ASSERT(UV_EINVAL == uv_handle_set_io_priority((uv_handle_t*) &control, 2));
+  ASSERT(0 == uv_handle_set_io_priority((uv_handle_t*) &control,
+                                        UV_IO_PRIORITY_HIGH));
+  ASSERT(0 == uv_handle_set_io_priority((uv_handle_t*) &control,
+                                        UV_IO_PRIORITY_HIGH));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &control,
+                            alloc_cb,
+                            control_read_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(calls == NUM_BULK + 1);
+  ASSERT(control_call == 0);
+
+  for (i = 0; i < NUM_BULK; i++) {
+    ASSERT(0 == close(bulk_fds[i][0]));
+    ASSERT(0 == close(bulk_fds[i][1]));
+  }
+  ASSERT(0 == close(control_fds[1]));
+
+  /* Priority is reset when the handle is closed. */
+  ASSERT(0 == uv_pipe_init(loop, &control, 0));
+  ASSERT(0 == uv_handle_set_io_priority((uv_handle_t*) &control,
+                                        UV_IO_PRIORITY_HIGH));
+  uv_close((uv_handle_t*) &control, close_cb);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(calls == NUM_BULK + 2);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
@@ -0,0 +1,161 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#ifndef _WIN32
+# include <sys/socket.h>
+# include <unistd.h>
+#endif
+
+#define NUM_HANDLES 5
+
+static uv_pipe_t sender;
+static uv_pipe_t receiver;
+static uv_tcp_t sent[NUM_HANDLES];
+static uv_tcp_t received[NUM_HANDLES];
+static uv_write_t write_req;
+static char slab[64];
+static int write_cb_called;
+static int read_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+}
+
+
+static void alloc_cb(uv_handle_t* handle,
+                     size_t suggested_size,
+                     uv_buf_t* buf) {
+  buf->base = slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+  write_cb_called++;
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  uv_os_fd_t fds[NUM_HANDLES];
+  int i;
+  int j;
+
+  if (nread == 0)
+    return;
+
+  ASSERT(nread == 5);
+  ASSERT(0 == memcmp(buf->base, "hello", 5));
+  read_cb_called++;
+
+  /* All of them came with the one message. */
+  for (i = 0; i < NUM_HANDLES; i++) {
+    ASSERT(NUM_HANDLES - i == uv_pipe_pending_count(&receiver));
+    ASSERT(UV_TCP == uv_pipe_pending_type(&receiver));
+    ASSERT(0 == uv_tcp_init(stream->loop, &received[i]));
+    ASSERT(0 == uv_accept(stream, (uv_stream_t*) &received[i]));
+    ASSERT(0 == uv_fileno((uv_handle_t*) &received[i], &fds[i]));
+    for (j = 0; j < i; j++)
+      ASSERT(fds[i] != fds[j]);
+  }
+  ASSERT(0 == uv_pipe_pending_count(&receiver));
+
+  uv_close((uv_handle_t*) &sender, close_cb);
+  uv_close((uv_handle_t*) &receiver, close_cb);
+  for (i = 0; i < NUM_HANDLES; i++) {
+    uv_close((uv_handle_t*) &sent[i], close_cb);
+    uv_close((uv_handle_t*) &received[i], close_cb);
+  }
+}
+
+
+TEST_IMPL(ipc_send_handles) {
+#ifdef _WIN32
+  RETURN_SKIP("Only one handle per write is supported on Windows.");
+#else
+  uv_stream_t* handles[NUM_HANDLES];
+  uv_stream_t* too_many[65];
+  uv_loop_t* loop;
+  uv_pipe_t plain;
+  uv_buf_t buf;
+  int fds[2];
+  int i;
+
+  loop = uv_default_loop();
+
+  ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  ASSERT(0 == uv_pipe_init(loop, &sender, 1));
+  ASSERT(0 == uv_pipe_open(&sender, fds[0]));
+  ASSERT(0 == uv_pipe_init(loop, &receiver, 1));
+  ASSERT(0 == uv_pipe_open(&receiver, fds[1]));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &receiver, alloc_cb, read_cb));
+
+  for (i = 0; i < NUM_HANDLES; i++) {
+    ASSERT(0 == uv_tcp_init_ex(loop, &sent[i], AF_INET));
+    handles[i] = (uv_stream_t*) &sent[i];
+  }
+
+  for (i = 0; i < (int) ARRAY_SIZE(too_many); i++)
+    too_many[i] = handles[0];
+
+  buf = uv_buf_init("hello", 5);
+  ASSERT(UV_EINVAL == uv_write_handles(&write_req,
+                                       (uv_stream_t*) &sender,
+                                       &buf,
+                                       1,
+                                       too_many,
+                                       ARRAY_SIZE(too_many),
+                                       write_cb));
+
+  /* Not an IPC pipe. */
+  ASSERT(0 == uv_pipe_init(loop, &plain, 0));
+  ASSERT(0 == uv_pipe_open(&plain, dup(fds[0])));
+  ASSERT(UV_EINVAL == uv_write_handles(&write_req,
+                                       (uv_stream_t*) &plain,
+                                       &buf,
+                                       1,
+                                       handles,
+                                       NUM_HANDLES,
+                                       write_cb));
+  uv_close((uv_handle_t*) &plain, close_cb);
+
+  ASSERT(0 == uv_write_handles(&write_req,
+                               (uv_stream_t*) &sender,
+                               &buf,
+                               1,
+                               handles,
+                               NUM_HANDLES,
+                               write_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(write_cb_called == 1);
+  ASSERT(read_cb_called == 1);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
@@ -32,8 +32,21 @@ TEST_DECLARE   (loop_instant_close)
 TEST_DECLARE   (loop_stop)
 TEST_DECLARE   (loop_update_time)
 TEST_DECLARE   (loop_backend_timeout)
+TEST_DECLARE   (loop_time_budget)
+TEST_DECLARE   (loop_run_until)
+TEST_DECLARE   (loop_watchdog)
+TEST_DECLARE   (loop_trace)
 TEST_DECLARE   (loop_configure)
+TEST_DECLARE   (loop_replace_allocator)
+TEST_DECLARE   (loop_arena)
+TEST_DECLARE   (loop_close_fs_req_cleanup)
+TEST_DECLARE   (loop_alloc_stats)
 TEST_DECLARE   (default_loop_close)
+TEST_DECLARE   (defer)
+TEST_DECLARE   (read_pool_tcp)
+TEST_DECLARE   (read_pool_udp)
+TEST_DECLARE   (read_size_stream)
+TEST_DECLARE   (read_size_udp)
 TEST_DECLARE   (barrier_1)
 TEST_DECLARE   (barrier_2)
 TEST_DECLARE   (barrier_3)
@@ -66,6 +79,7 @@ TEST_DECLARE   (ipc_heavy_traffic_deadlock_bug)
 TEST_DECLARE   (ipc_listen_before_write)
 TEST_DECLARE   (ipc_listen_after_write)
 #ifndef _WIN32
+TEST_DECLARE   (ipc_send_handles)
 TEST_DECLARE   (ipc_send_recv_pipe)
 TEST_DECLARE   (ipc_send_recv_pipe_inprocess)
 #endif
@@ -91,6 +105,8 @@ TEST_DECLARE   (tcp_write_after_connect)
 TEST_DECLARE   (tcp_writealot)
 TEST_DECLARE   (tcp_write_fail)
 TEST_DECLARE   (tcp_try_write)
+TEST_DECLARE   (try_read_tcp)
+TEST_DECLARE   (try_read_ipc)
 TEST_DECLARE   (tcp_write_queue_order)
 TEST_DECLARE   (tcp_open)
 TEST_DECLARE   (tcp_open_twice)
@@ -120,6 +136,16 @@ TEST_DECLARE   (tcp_close_accept)
 TEST_DECLARE   (tcp_oob)
 #endif
 TEST_DECLARE   (tcp_flags)
+TEST_DECLARE   (tcp_exclusive_accept)
+TEST_DECLARE   (tcp_admission_connections)
+TEST_DECLARE   (tcp_admission_loop_lag)
+TEST_DECLARE   (tcp_admission_fds)
+TEST_DECLARE   (tcp_listen_batch)
+TEST_DECLARE   (tcp_listen_batch_relisten_error)
+TEST_DECLARE   (tcp_zerocopy)
+TEST_DECLARE   (tcp_reuseport)
+TEST_DECLARE   (tcp_migrate)
+TEST_DECLARE   (tcp_migrate_close)
 TEST_DECLARE   (tcp_write_to_half_open_connection)
 TEST_DECLARE   (tcp_unexpected_read)
 TEST_DECLARE   (tcp_read_stop)
@@ -181,6 +207,11 @@ TEST_DECLARE   (shutdown_eof)
 TEST_DECLARE   (shutdown_twice)
 TEST_DECLARE   (callback_stack)
 TEST_DECLARE   (env_vars)
+TEST_DECLARE   (epoch_defer)
+TEST_DECLARE   (epoch_synchronize)
+TEST_DECLARE   (epoch_offline)
+TEST_DECLARE   (loop_group)
+TEST_DECLARE   (watcher_table_sparse)
 TEST_DECLARE   (error_message)
 TEST_DECLARE   (sys_error)
 TEST_DECLARE   (timer)
@@ -195,6 +226,8 @@ TEST_DECLARE   (timer_from_check)
 TEST_DECLARE   (timer_null_callback)
 TEST_DECLARE   (timer_early_check)
 TEST_DECLARE   (idle_starvation)
+TEST_DECLARE   (idle_task)
+TEST_DECLARE   (idle_task_deadline)
 TEST_DECLARE   (loop_handles)
 TEST_DECLARE   (get_loadavg)
 TEST_DECLARE   (walk_handles)
@@ -239,6 +272,7 @@ TEST_DECLARE   (process_title)
 TEST_DECLARE   (process_title_threadsafe)
 TEST_DECLARE   (cwd_and_chdir)
 TEST_DECLARE   (get_memory)
+TEST_DECLARE   (cpu_topology)
 TEST_DECLARE   (get_passwd)
 TEST_DECLARE   (handle_fileno)
 TEST_DECLARE   (homedir)
@@ -400,6 +434,7 @@ TEST_DECLARE   (poll_duplex)
 TEST_DECLARE   (poll_unidirectional)
 TEST_DECLARE   (poll_close)
 TEST_DECLARE   (poll_bad_fdtype)
+TEST_DECLARE   (io_priority)
 #ifdef __linux__
 TEST_DECLARE   (poll_nested_epoll)
 #endif
@@ -449,6 +484,7 @@ TEST_DECLARE   (queue_foreach_delete)
 
 TEST_DECLARE   (handle_type_name)
 TEST_DECLARE   (req_type_name)
+TEST_DECLARE   (req_pool)
 TEST_DECLARE   (getters_setters)
 
 #ifndef _WIN32
@@ -488,8 +524,21 @@ TASK_LIST_START
   TEST_ENTRY  (loop_stop)
   TEST_ENTRY  (loop_update_time)
   TEST_ENTRY  (loop_backend_timeout)
+  TEST_ENTRY  (loop_time_budget)
+  TEST_ENTRY  (loop_run_until)
+  TEST_ENTRY  (loop_watchdog)
+  TEST_ENTRY  (loop_trace)
   TEST_ENTRY  (loop_configure)
+  TEST_ENTRY  (loop_replace_allocator)
+  TEST_ENTRY  (loop_arena)
+  TEST_ENTRY  (loop_close_fs_req_cleanup)
+  TEST_ENTRY  (loop_alloc_stats)
   TEST_ENTRY  (default_loop_close)
+  TEST_ENTRY  (defer)
+  TEST_ENTRY  (read_pool_tcp)
+  TEST_ENTRY  (read_pool_udp)
+  TEST_ENTRY  (read_size_stream)
+  TEST_ENTRY  (read_size_udp)
   TEST_ENTRY  (barrier_1)
   TEST_ENTRY  (barrier_2)
   TEST_ENTRY  (barrier_3)
@@ -533,6 +582,7 @@ TASK_LIST_START
   TEST_ENTRY  (ipc_listen_before_write)
   TEST_ENTRY  (ipc_listen_after_write)
 #ifndef _WIN32
+  TEST_ENTRY  (ipc_send_handles)
   TEST_ENTRY  (ipc_send_recv_pipe)
   TEST_ENTRY  (ipc_send_recv_pipe_inprocess)
 #endif
@@ -582,6 +632,8 @@ TASK_LIST_START
   TEST_HELPER (tcp_write_fail, tcp4_echo_server)
 
   TEST_ENTRY  (tcp_try_write)
+  TEST_ENTRY  (try_read_tcp)
+  TEST_ENTRY  (try_read_ipc)
 
   TEST_ENTRY  (tcp_write_queue_order)
 
@@ -620,6 +672,16 @@ TASK_LIST_START
   TEST_ENTRY  (tcp_oob)
 #endif
   TEST_ENTRY  (tcp_flags)
+  TEST_ENTRY  (tcp_exclusive_accept)
+  TEST_ENTRY  (tcp_admission_connections)
+  TEST_ENTRY  (tcp_admission_loop_lag)
+  TEST_ENTRY  (tcp_admission_fds)
+  TEST_ENTRY  (tcp_listen_batch)
+  TEST_ENTRY  (tcp_listen_batch_relisten_error)
+  TEST_ENTRY  (tcp_zerocopy)
+  TEST_ENTRY  (tcp_reuseport)
+  TEST_ENTRY  (tcp_migrate)
+  TEST_ENTRY  (tcp_migrate_close)
   TEST_ENTRY  (tcp_write_to_half_open_connection)
   TEST_ENTRY  (tcp_unexpected_read)
 
@@ -696,6 +758,12 @@ TASK_LIST_START
 
   TEST_ENTRY  (env_vars)
 
+  TEST_ENTRY  (epoch_defer)
+  TEST_ENTRY  (epoch_synchronize)
+  TEST_ENTRY  (epoch_offline)
+  TEST_ENTRY  (loop_group)
+  TEST_ENTRY  (watcher_table_sparse)
+
   TEST_ENTRY  (error_message)
   TEST_ENTRY  (sys_error)
 
@@ -712,6 +780,8 @@ TASK_LIST_START
   TEST_ENTRY  (timer_early_check)
 
   TEST_ENTRY  (idle_starvation)
+  TEST_ENTRY  (idle_task)
+  TEST_ENTRY  (idle_task_deadline)
 
   TEST_ENTRY  (ref)
   TEST_ENTRY  (idle_ref)
@@ -765,6 +835,7 @@ TASK_LIST_START
   TEST_ENTRY  (cwd_and_chdir)
 
   TEST_ENTRY  (get_memory)
+  TEST_ENTRY  (cpu_topology)
 
   TEST_ENTRY  (get_passwd)
 
@@ -800,6 +871,7 @@ TASK_LIST_START
   TEST_ENTRY  (poll_unidirectional)
   TEST_ENTRY  (poll_close)
   TEST_ENTRY  (poll_bad_fdtype)
+  TEST_ENTRY  (io_priority)
 #if (defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))) && \
     !defined(__sun)
   TEST_ENTRY  (poll_oob)
@@ -986,6 +1058,7 @@ TASK_LIST_START
 
   TEST_ENTRY  (handle_type_name)
   TEST_ENTRY  (req_type_name)
+  TEST_ENTRY  (req_pool)
   TEST_ENTRY  (getters_setters)
 
 #ifndef _WIN32
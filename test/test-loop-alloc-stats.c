@@ -0,0 +1,125 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+/* Windows keeps a UTF-16 copy of the path next to the original. */
+#ifdef _WIN32
+# define FS_PATH_SIZE (sizeof(".") + sizeof(L"."))
+#else
+# define FS_PATH_SIZE sizeof(".")
+#endif
+
+static uv_loop_t loop;
+
+
+static void get_stats(uv_alloc_subsystem subsystem, uv_alloc_stats_t* stats) {
+  ASSERT(0 == uv_loop_alloc_stats(&loop, subsystem, stats));
+  ASSERT(stats->bytes <= stats->peak_bytes);
+  ASSERT(stats->objects <= stats->peak_objects);
+}
+
+
+static void stat_cb(uv_fs_t* req) {
+  uv_alloc_stats_t stats;
+
+  ASSERT(req->result == 0);
+
+  /* The path is only accounted for while the request is in flight. */
+  get_stats(UV_ALLOC_FS, &stats);
+  ASSERT(stats.objects == 0);
+  ASSERT(stats.bytes == 0);
+  uv_fs_req_cleanup(req);
+}
+
+
+static void getaddrinfo_cb(uv_getaddrinfo_t* req,
+                           int status,
+                           struct addrinfo* res) {
+  uv_freeaddrinfo(res);
+}
+
+
+TEST_IMPL(loop_alloc_stats) {
+  uv_getaddrinfo_t getaddrinfo_req;
+  uv_alloc_stats_t stats;
+  uv_fs_t stat_req;
+  uv_req_t* req;
+  int err;
+
+  ASSERT(0 == uv_loop_init(&loop));
+
+  err = uv_loop_alloc_stats(&loop, UV_ALLOC_LOOP, &stats);
+  if (err == UV_ENOTSUP) {
+    ASSERT(0 == uv_loop_close(&loop));
+    RETURN_SKIP("libuv was built without UV_ALLOC_STATS");
+  }
+
+  ASSERT(err == 0);
+  ASSERT(UV_EINVAL == uv_loop_alloc_stats(&loop,
+                                          UV_ALLOC_SUBSYSTEM_MAX,
+                                          &stats));
+
+  /* Asynchronous fs requests copy their path. */
+  ASSERT(0 == uv_fs_stat(&loop, &stat_req, ".", stat_cb));
+  get_stats(UV_ALLOC_FS, &stats);
+  ASSERT(stats.objects == 1);
+  ASSERT(stats.bytes == FS_PATH_SIZE);
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  get_stats(UV_ALLOC_FS, &stats);
+  ASSERT(stats.peak_objects == 1);
+  ASSERT(stats.peak_bytes == FS_PATH_SIZE);
+
+  /* So do getaddrinfo requests. */
+  ASSERT(0 == uv_getaddrinfo(&loop,
+                             &getaddrinfo_req,
+                             getaddrinfo_cb,
+                             "localhost",
+                             NULL,
+                             NULL));
+  get_stats(UV_ALLOC_DNS, &stats);
+  ASSERT(stats.objects == 1);
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  get_stats(UV_ALLOC_DNS, &stats);
+  ASSERT(stats.objects == 0);
+  ASSERT(stats.bytes == 0);
+
+  /* Pooled requests are charged to the subsystem that uses them. */
+  req = uv_req_acquire(&loop, UV_UDP_SEND);
+  ASSERT(req != NULL);
+  get_stats(UV_ALLOC_UDP, &stats);
+  ASSERT(stats.objects == 1);
+  ASSERT(stats.bytes == uv_req_size(UV_UDP_SEND));
+  uv_req_release(&loop, req);
+
+#ifndef _WIN32
+  /* The watcher table: the chunk directory and the chunk that holds the
+   * signal pipe watcher.
+   */
+  get_stats(UV_ALLOC_LOOP, &stats);
+  ASSERT(stats.objects == 2);
+#endif
+
+  ASSERT(0 == uv_loop_close(&loop));
+
+  return 0;
+}
@@ -0,0 +1,250 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_SENDS 100
+#define NUM_BUFS 6
+
+typedef struct {
+  int mallocs;
+  int frees;
+  int live;
+} counters_t;
+
+static counters_t counters;
+static uv_udp_t udp;
+static uv_udp_send_t send_req;
+static struct sockaddr_in addr;
+static char payload[NUM_BUFS][4];
+static uv_buf_t bufs[NUM_BUFS];
+static char recv_storage[64];
+static int sends;
+static int recvs;
+static int stat_cb_called;
+
+
+static void* counting_malloc(void* ctx, size_t size) {
+  ASSERT(ctx == &counters);
+  counters.mallocs++;
+  counters.live++;
+  return malloc(size);
+}
+
+
+static void* counting_realloc(void* ctx, void* ptr, size_t size) {
+  ASSERT(ctx == &counters);
+  ASSERT(ptr != NULL);
+  ASSERT(size != 0);
+  return realloc(ptr, size);
+}
+
+
+static void counting_free(void* ctx, void* ptr) {
+  ASSERT(ctx == &counters);
+  ASSERT(ptr != NULL);
+  counters.frees++;
+  counters.live--;
+  free(ptr);
+}
+
+
+static void stat_cb(uv_fs_t* req) {
+  ASSERT(req->result == 0);
+  uv_fs_req_cleanup(req);
+  stat_cb_called++;
+}
+
+
+static void getaddrinfo_cb(uv_getaddrinfo_t* req,
+                           int status,
+                           struct addrinfo* res) {
+  uv_freeaddrinfo(res);
+}
+
+
+static void stat_no_cleanup_cb(uv_fs_t* req) {
+  ASSERT(req->result == 0);
+  stat_cb_called++;
+}
+
+
+static void alloc_cb(uv_handle_t* handle,
+                     size_t suggested_size,
+                     uv_buf_t* buf) {
+  buf->base = recv_storage;
+  buf->len = sizeof(recv_storage);
+}
+
+
+static void send_cb(uv_udp_send_t* req, int status);
+
+
+static void send_next(void) {
+  ASSERT(0 == uv_udp_send(&send_req,
+                          &udp,
+                          bufs,
+                          NUM_BUFS,
+                          (const struct sockaddr*) &addr,
+                          send_cb));
+}
+
+
+static void send_cb(uv_udp_send_t* req, int status) {
+  ASSERT(status == 0);
+  if (++sends < NUM_SENDS)
+    send_next();
+}
+
+
+static void recv_cb(uv_udp_t* handle,
+                    ssize_t nread,
+                    const uv_buf_t* buf,
+                    const struct sockaddr* peer,
+                    unsigned flags) {
+  if (nread == 0)
+    return;
+
+  ASSERT(nread == (ssize_t) sizeof(payload));
+  ASSERT(0 == memcmp(buf->base, payload, nread));
+
+  if (++recvs == NUM_SENDS)
+    uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static void run_workload(uv_loop_t* loop) {
+  uv_fs_t stat_reqs[4];
+  int i;
+
+  for (i = 0; i < NUM_BUFS; i++) {
+    memset(payload[i], 'a' + i, sizeof(payload[i]));
+    bufs[i] = uv_buf_init(payload[i], sizeof(payload[i]));
+  }
+
+  sends = 0;
+  recvs = 0;
+  stat_cb_called = 0;
+
+  /* Asynchronous requests copy their path, with the global allocator. */
+  for (i = 0; i < (int) ARRAY_SIZE(stat_reqs); i++)
+    ASSERT(0 == uv_fs_stat(loop, &stat_reqs[i], ".", stat_cb));
+
+  /* Sends with more than four buffers copy the buffer array. */
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_udp_init(loop, &udp));
+  ASSERT(0 == uv_udp_bind(&udp, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_udp_recv_start(&udp, alloc_cb, recv_cb));
+  send_next();
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(stat_cb_called == (int) ARRAY_SIZE(stat_reqs));
+  ASSERT(sends == NUM_SENDS);
+  ASSERT(recvs == NUM_SENDS);
+}
+
+
+TEST_IMPL(loop_replace_allocator) {
+  uv_getaddrinfo_t getaddrinfo_req;
+  uv_loop_t loop;
+
+  ASSERT(0 == uv_loop_init(&loop));
+
+  ASSERT(UV_EINVAL == uv_loop_replace_allocator(&loop,
+                                                &counters,
+                                                counting_malloc,
+                                                NULL,
+                                                counting_free));
+  ASSERT(0 == uv_loop_replace_allocator(&loop,
+                                        &counters,
+                                        counting_malloc,
+                                        counting_realloc,
+                                        counting_free));
+
+  run_workload(&loop);
+
+#ifndef _WIN32
+  ASSERT(counters.mallocs >= NUM_SENDS);
+  ASSERT(counters.live > 0);  /* The watcher table. */
+#endif
+
+  /* Can't switch while a request holds memory from the current allocator. */
+  ASSERT(0 == uv_getaddrinfo(&loop,
+                             &getaddrinfo_req,
+                             getaddrinfo_cb,
+                             "localhost",
+                             NULL,
+                             NULL));
+#ifndef _WIN32
+  ASSERT(UV_EBUSY == uv_loop_replace_allocator(&loop, NULL, NULL, NULL, NULL));
+#endif
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+
+  /* The watcher table moves back to the global allocator. */
+  ASSERT(0 == uv_loop_replace_allocator(&loop, NULL, NULL, NULL, NULL));
+  ASSERT(counters.live == 0);
+  ASSERT(counters.mallocs == counters.frees);
+
+  ASSERT(0 == uv_loop_close(&loop));
+
+  return 0;
+}
+
+
+TEST_IMPL(loop_arena) {
+  uv_loop_t loop;
+
+  ASSERT(0 == uv_loop_init(&loop));
+  ASSERT(0 == uv_loop_configure(&loop, UV_LOOP_USE_ARENA));
+
+  run_workload(&loop);
+
+  /* Releases the arena, which valgrind verifies. */
+  ASSERT(0 == uv_loop_close(&loop));
+
+  return 0;
+}
+
+
+TEST_IMPL(loop_close_fs_req_cleanup) {
+  uv_fs_t stat_req;
+  uv_loop_t loop;
+
+  ASSERT(0 == uv_loop_init(&loop));
+  ASSERT(0 == uv_loop_configure(&loop, UV_LOOP_USE_ARENA));
+
+  stat_cb_called = 0;
+  ASSERT(0 == uv_fs_stat(&loop, &stat_req, ".", stat_no_cleanup_cb));
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT(stat_cb_called == 1);
+  ASSERT(0 == uv_loop_close(&loop));
+
+  /* Must not touch the loop or its arena. */
+  memset(&loop, 0, sizeof(loop));
+  uv_fs_req_cleanup(&stat_req);
+  ASSERT(stat_req.path == NULL);
+
+  return 0;
+}
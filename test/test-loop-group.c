@@ -0,0 +1,122 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#define NUM_LOOPS 3
+#define NUM_HOPS 100
+
+static uv_loop_group_t group;
+static uv_loop_t* loops[NUM_LOOPS];
+static uv_timer_t timers[NUM_LOOPS];
+static uv_thread_t main_thread;
+static uv_sem_t done;
+static int hops;
+
+
+static void setup_cb(uv_loop_t* loop, void* arg) {
+  unsigned int index;
+  uv_thread_t self;
+
+  self = uv_thread_self();
+  ASSERT(!uv_thread_equal(&main_thread, &self));
+
+  index = (unsigned int) (uintptr_t) arg;
+  loops[index] = loop;
+
+  /* Never closed by the test, the loop group cleans it up. */
+  ASSERT(0 == uv_timer_init(loop, &timers[index]));
+
+  uv_sem_post(&done);
+}
+
+
+static void hop_cb(uv_loop_t* loop, void* arg) {
+  unsigned int index;
+
+  index = (unsigned int) (uintptr_t) arg;
+  ASSERT(loop == loops[index]);
+
+  if (++hops == NUM_HOPS) {
+    uv_sem_post(&done);
+    return;
+  }
+
+  /* Only one callback is in flight at a time, no need to lock `hops`. */
+  index = (index + 1) % NUM_LOOPS;
+  ASSERT(0 == uv_loop_group_post(&group,
+                                 index,
+                                 hop_cb,
+                                 (void*) (uintptr_t) index));
+}
+
+
+static void noop_cb(uv_loop_t* loop, void* arg) {
+  ASSERT(0);
+}
+
+
+TEST_IMPL(loop_group) {
+  uv_loop_group_t other;
+  unsigned int i;
+
+  main_thread = uv_thread_self();
+  ASSERT(0 == uv_sem_init(&done, 0));
+
+  ASSERT(UV_EINVAL == uv_loop_group_init(&group, 1, 42));
+
+  ASSERT(0 == uv_loop_group_init(&group, NUM_LOOPS, UV_LOOP_GROUP_PIN));
+  ASSERT(NUM_LOOPS == uv_loop_group_size(&group));
+  ASSERT(UV_EINVAL == uv_loop_group_post(&group, NUM_LOOPS, noop_cb, NULL));
+  ASSERT(UV_EINVAL == uv_loop_group_post(&group, 0, NULL, NULL));
+
+  for (i = 0; i < NUM_LOOPS; i++) {
+    ASSERT(0 == uv_loop_group_post(&group,
+                                   i,
+                                   setup_cb,
+                                   (void*) (uintptr_t) i));
+    uv_sem_wait(&done);
+  }
+
+  ASSERT(loops[0] != loops[1]);
+  ASSERT(loops[1] != loops[2]);
+
+  ASSERT(0 == uv_loop_group_post(&group, 0, hop_cb, (void*) (uintptr_t) 0));
+  uv_sem_wait(&done);
+  ASSERT(NUM_HOPS == hops);
+
+  uv_loop_group_stop(&group);
+  uv_loop_group_stop(&group);
+  ASSERT(UV_ECANCELED == uv_loop_group_post(&group, 0, noop_cb, NULL));
+  ASSERT(0 == uv_loop_group_join(&group));
+  ASSERT(0 == uv_loop_group_size(&group));
+
+  /* Sized from the CPU count. */
+  ASSERT(0 == uv_loop_group_init(&other, 0, 0));
+  ASSERT(uv_loop_group_size(&other) >= 1);
+  uv_loop_group_stop(&other);
+  ASSERT(0 == uv_loop_group_join(&other));
+
+  uv_sem_destroy(&done);
+
+  return 0;
+}
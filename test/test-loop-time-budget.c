@@ -0,0 +1,168 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#ifndef _WIN32
+# include <sys/socket.h>
+# include <unistd.h>
+#endif
+
+#define NUM_WATCHERS 64
+#define BUDGET_MS 5
+#define MAX_ITERATIONS 100
+
+static uv_poll_t watchers[NUM_WATCHERS];
+static int fds[NUM_WATCHERS][2];
+static int calls[NUM_WATCHERS];
+static uv_check_t check;
+static int iteration_calls;
+static int max_iteration_calls;
+static int iterations;
+static int timer_cb_called;
+
+
+static void close_all(void) {
+  int i;
+
+  for (i = 0; i < NUM_WATCHERS; i++)
+    uv_close((uv_handle_t*) &watchers[i], NULL);
+  uv_close((uv_handle_t*) &check, NULL);
+}
+
+
+static void poll_cb(uv_poll_t* handle, int status, int events) {
+  uint64_t until;
+
+  ASSERT(status == 0);
+  calls[handle - watchers]++;
+  iteration_calls++;
+
+  /* Burn a millisecond, the socket is never drained so it stays ready. */
+  until = uv_hrtime() + 1000000;
+  while (uv_hrtime() < until);
+}
+
+
+static void check_cb(uv_check_t* handle) {
+  int i;
+
+  if (iteration_calls > max_iteration_calls)
+    max_iteration_calls = iteration_calls;
+  iteration_calls = 0;
+  iterations++;
+
+  for (i = 0; i < NUM_WATCHERS; i++)
+    if (calls[i] == 0)
+      break;
+
+  /* Everyone got a turn. */
+  if (i == NUM_WATCHERS || iterations == MAX_ITERATIONS)
+    close_all();
+}
+
+
+TEST_IMPL(loop_time_budget) {
+#ifdef _WIN32
+  RETURN_SKIP("Not supported on Windows.");
+#else
+  uv_loop_t* loop;
+  int i;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_loop_configure(loop, UV_LOOP_TIME_BUDGET, BUDGET_MS));
+
+  for (i = 0; i < NUM_WATCHERS; i++) {
+    ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]));
+    ASSERT(1 == write(fds[i][1], "x", 1));
+    ASSERT(0 == uv_poll_init(loop, &watchers[i], fds[i][0]));
+    ASSERT(0 == uv_poll_start(&watchers[i], UV_READABLE, poll_cb));
+  }
+
+  ASSERT(0 == uv_check_init(loop, &check));
+  ASSERT(0 == uv_check_start(&check, check_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  /* Each iteration stops dispatching once the budget is spent, and the next
+   * one picks up where it left off instead of starting the batch over.
+   */
+  ASSERT(iterations < MAX_ITERATIONS);
+  ASSERT(iterations >= NUM_WATCHERS / (BUDGET_MS + 1));
+  ASSERT(max_iteration_calls <= BUDGET_MS + 1);
+  for (i = 0; i < NUM_WATCHERS; i++) {
+    ASSERT(calls[i] > 0);
+    ASSERT(0 == close(fds[i][0]));
+    ASSERT(0 == close(fds[i][1]));
+  }
+
+  ASSERT(0 == uv_loop_configure(loop, UV_LOOP_TIME_BUDGET, 0));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
+
+
+static void timer_cb(uv_timer_t* handle) {
+  timer_cb_called++;
+}
+
+
+TEST_IMPL(loop_run_until) {
+  uv_timer_t timer;
+  uv_loop_t* loop;
+  uint64_t start;
+  uint64_t elapsed;
+
+  loop = uv_default_loop();
+
+  /* Nothing to do. */
+  ASSERT(0 == uv_run_until(loop, uv_hrtime() + 1000000000));
+
+  /* Returns at the deadline even though the loop has nothing to do before
+   * the timer expires.
+   */
+  ASSERT(0 == uv_timer_init(loop, &timer));
+  ASSERT(0 == uv_timer_start(&timer, timer_cb, 10000, 0));
+
+  start = uv_hrtime();
+  ASSERT(0 != uv_run_until(loop, start + 20000000));
+  elapsed = uv_hrtime() - start;
+  ASSERT(elapsed >= 20000000);
+  ASSERT(elapsed < 2000000000);
+  ASSERT(0 == timer_cb_called);
+
+  /* A deadline that has passed already returns right away. */
+  ASSERT(0 != uv_run_until(loop, start));
+
+  /* Runs to completion when the work finishes before the deadline. */
+  ASSERT(0 == uv_timer_start(&timer, timer_cb, 1, 0));
+  ASSERT(0 == uv_run_until(loop, uv_hrtime() + (uint64_t) 10 * 1000000000));
+  ASSERT(1 == timer_cb_called);
+
+  uv_close((uv_handle_t*) &timer, NULL);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
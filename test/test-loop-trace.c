@@ -0,0 +1,157 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uv_timer_t timer;
+static uv_fs_t fs_req;
+static int timer_cb_called;
+static int fs_cb_called;
+
+
+static void fs_cb(uv_fs_t* req) {
+  ASSERT(req->result == 0);
+  uv_fs_req_cleanup(req);
+  fs_cb_called++;
+}
+
+
+static void timer_cb(uv_timer_t* handle) {
+  timer_cb_called++;
+  ASSERT(0 == uv_fs_stat(handle->loop, &fs_req, ".", fs_cb));
+}
+
+
+/* Dumps the trace and returns it as a string. */
+static char* dump(uv_loop_t* loop) {
+  FILE* stream;
+  char* buf;
+  long size;
+
+  stream = tmpfile();
+  ASSERT(stream != NULL);
+  ASSERT(0 == uv_loop_trace_dump(loop, stream));
+
+  size = ftell(stream);
+  ASSERT(size > 0);
+  buf = malloc(size + 1);
+  ASSERT(buf != NULL);
+
+  rewind(stream);
+  ASSERT((size_t) size == fread(buf, 1, size, stream));
+  buf[size] = '\0';
+  fclose(stream);
+
+  return buf;
+}
+
+
+static unsigned int count(const char* haystack, const char* needle) {
+  unsigned int n;
+
+  n = 0;
+  while ((haystack = strstr(haystack, needle)) != NULL) {
+    haystack++;
+    n++;
+  }
+
+  return n;
+}
+
+
+TEST_IMPL(loop_trace) {
+  uv_loop_t* loop;
+  char* trace;
+
+  loop = uv_default_loop();
+
+  ASSERT(UV_EINVAL == uv_loop_trace_dump(loop, stdout));
+  ASSERT(UV_EINVAL == uv_loop_trace_start(loop, 0));
+  ASSERT(0 == uv_loop_trace_stop(loop));
+
+  ASSERT(0 == uv_loop_trace_start(loop, 4096));
+  ASSERT(UV_EBUSY == uv_loop_trace_start(loop, 4096));
+
+  ASSERT(0 == uv_timer_init(loop, &timer));
+  ASSERT(0 == uv_timer_start(&timer, timer_cb, 1, 0));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(1 == timer_cb_called);
+  ASSERT(1 == fs_cb_called);
+
+  ASSERT(0 == uv_loop_trace_stop(loop));
+  ASSERT(0 == uv_loop_trace_stop(loop));
+
+  trace = dump(loop);
+  ASSERT(trace == strstr(trace, "{\"traceEvents\":["));
+  ASSERT(NULL != strstr(trace, "\"displayTimeUnit\":\"ns\"}\n"));
+
+  /* Every phase of an iteration. */
+  ASSERT(NULL != strstr(trace, "{\"name\":\"timers\",\"cat\":\"phase\""));
+  ASSERT(NULL != strstr(trace, "{\"name\":\"pending\",\"cat\":\"phase\""));
+  ASSERT(NULL != strstr(trace, "{\"name\":\"idle\",\"cat\":\"phase\""));
+  ASSERT(NULL != strstr(trace, "{\"name\":\"prepare\",\"cat\":\"phase\""));
+  ASSERT(NULL != strstr(trace, "{\"name\":\"poll\",\"cat\":\"phase\""));
+  ASSERT(NULL != strstr(trace, "{\"name\":\"check\",\"cat\":\"phase\""));
+  ASSERT(NULL != strstr(trace, "{\"name\":\"closing\",\"cat\":\"phase\""));
+
+  /* The timer callback and the stat request, queued by the loop and run on
+   * the threadpool.
+   */
+  ASSERT(1 == count(trace, "{\"name\":\"timer\",\"cat\":\"callback\""));
+  ASSERT(1 == count(trace, "{\"name\":\"fs\",\"cat\":\"threadpool\","
+                           "\"ph\":\"i\""));
+  ASSERT(1 == count(trace, "{\"name\":\"fs\",\"cat\":\"threadpool\","
+                           "\"ph\":\"X\""));
+  ASSERT(1 == count(trace, "\"queued_us\":"));
+  ASSERT(1 == count(trace, "\"args\":{\"name\":\"event loop\"}"));
+
+#ifndef _WIN32
+  ASSERT(NULL != strstr(trace, "{\"name\":\"syscalls\",\"cat\":\"syscalls\","
+                               "\"ph\":\"C\""));
+#endif
+  free(trace);
+
+  /* The ring keeps the newest events. */
+  ASSERT(0 == uv_loop_trace_start(loop, 4));
+  ASSERT(0 == uv_timer_start(&timer, timer_cb, 1, 0));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(0 == uv_loop_trace_stop(loop));
+
+  trace = dump(loop);
+  /* Four loop events, the stat request and two thread names. */
+  ASSERT(4 + 1 + 2 == count(trace, "\"ph\":"));
+  ASSERT(0 == count(trace, "{\"name\":\"timer\","));
+  /* Its submission fell out of the ring so it can't be named. */
+  ASSERT(1 == count(trace, "{\"name\":\"work\",\"cat\":\"threadpool\","
+                           "\"ph\":\"X\""));
+  free(trace);
+
+  uv_close((uv_handle_t*) &timer, NULL);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
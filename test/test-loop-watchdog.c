@@ -0,0 +1,145 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdlib.h>
+
+#define TIMEOUT 20
+
+static uv_sem_t reported;
+static uv_watchdog_report_t last_report;
+static int reports;
+static uv_timer_t idle_timer;
+static uv_timer_t stall_timer;
+static uv_async_t stall_async;
+
+
+static void watchdog_cb(uv_loop_t* loop,
+                        const uv_watchdog_report_t* report,
+                        void* arg) {
+  ASSERT(loop == uv_default_loop());
+  ASSERT(arg == &reported);
+  last_report = *report;
+  reports++;
+  uv_sem_post(&reported);
+}
+
+
+/* Blocks the loop until the watchdog has noticed. */
+static void stall_timer_cb(uv_timer_t* handle) {
+  ASSERT(0 == reports);
+  uv_sem_wait(&reported);
+  ASSERT(1 == reports);
+}
+
+
+static void stall_async_cb(uv_async_t* handle) {
+  uv_sem_wait(&reported);
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+/* Frees the handle before getting stuck, the watchdog mustn't touch it. */
+static void stall_close_cb(uv_handle_t* handle) {
+  free(handle);
+  uv_sem_wait(&reported);
+}
+
+
+static void idle_timer_cb(uv_timer_t* handle) {
+  /* Waiting for the timer in the kernel doesn't count as stuck. */
+  ASSERT(0 == reports);
+  ASSERT(0 == uv_timer_start(&stall_timer, stall_timer_cb, 0, 0));
+}
+
+
+TEST_IMPL(loop_watchdog) {
+  uv_timer_t* timer;
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_sem_init(&reported, 0));
+
+  ASSERT(UV_EINVAL == uv_loop_watchdog_start(loop, 0, watchdog_cb, NULL));
+  ASSERT(UV_EINVAL == uv_loop_watchdog_start(loop, TIMEOUT, NULL, NULL));
+  ASSERT(0 == uv_loop_watchdog_stop(loop));
+
+  ASSERT(0 == uv_loop_watchdog_start(loop, TIMEOUT, watchdog_cb, &reported));
+  ASSERT(UV_EBUSY == uv_loop_watchdog_start(loop,
+                                            TIMEOUT,
+                                            watchdog_cb,
+                                            &reported));
+
+  /* Neither is a loop that hasn't been run yet. */
+  uv_sleep(4 * TIMEOUT);
+  ASSERT(0 == reports);
+
+  ASSERT(0 == uv_timer_init(loop, &idle_timer));
+  ASSERT(0 == uv_timer_init(loop, &stall_timer));
+  ASSERT(0 == uv_timer_start(&idle_timer, idle_timer_cb, 10 * TIMEOUT, 0));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(1 == reports);
+  ASSERT(UV_TIMER == last_report.type);
+  ASSERT((uv_handle_t*) &stall_timer == last_report.handle);
+  ASSERT((void (*)(void)) stall_timer_cb == last_report.cb);
+  ASSERT(last_report.elapsed >= TIMEOUT);
+
+  /* Or one that uv_run() has returned from. */
+  uv_sleep(4 * TIMEOUT);
+  ASSERT(1 == reports);
+
+  /* Callbacks of handles without an fd of their own are attributed too. */
+  ASSERT(0 == uv_async_init(loop, &stall_async, stall_async_cb));
+  ASSERT(0 == uv_async_send(&stall_async));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(2 == reports);
+  ASSERT(UV_ASYNC == last_report.type);
+  ASSERT((uv_handle_t*) &stall_async == last_report.handle);
+  ASSERT((void (*)(void)) stall_async_cb == last_report.cb);
+
+#ifndef _WIN32
+  /* Close callbacks are dispatch points too. */
+  timer = malloc(sizeof(*timer));
+  ASSERT(timer != NULL);
+  ASSERT(0 == uv_timer_init(loop, timer));
+  uv_close((uv_handle_t*) timer, stall_close_cb);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(3 == reports);
+  ASSERT(UV_TIMER == last_report.type);
+  ASSERT((void (*)(void)) stall_close_cb == last_report.cb);
+#endif
+
+  ASSERT(0 == uv_loop_watchdog_stop(loop));
+  ASSERT(0 == uv_loop_watchdog_stop(loop));
+
+  uv_close((uv_handle_t*) &idle_timer, NULL);
+  uv_close((uv_handle_t*) &stall_timer, NULL);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  uv_sem_destroy(&reported);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
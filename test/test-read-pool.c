@@ -0,0 +1,187 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+static uv_tcp_t server;
+static uv_tcp_t client;
+static uv_tcp_t conn;
+static uv_connect_t connect_req;
+static uv_write_t write_req;
+static uv_udp_t udp_server;
+static uv_udp_t udp_client;
+static uv_udp_send_t send_req;
+static char* first_block;
+static int read_cb_called;
+static int recv_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  read_cb_called++;
+
+  if (nread > 0) {
+    /* The block size is rounded up to a multiple of 64. */
+    ASSERT(buf->len == 1024);
+    ASSERT(nread == 4);
+    ASSERT(0 == memcmp(buf->base, "ping", 4));
+    first_block = buf->base;
+  } else {
+    ASSERT(nread == UV_EOF);
+    /* The released block was handed out again. */
+    ASSERT(buf->base == first_block);
+    uv_close((uv_handle_t*) stream, close_cb);
+    uv_close((uv_handle_t*) &server, close_cb);
+  }
+
+  uv_read_pool_release(stream->loop, buf);
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+  uv_close((uv_handle_t*) &client, close_cb);
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  uv_buf_t buf;
+
+  ASSERT(status == 0);
+  buf = uv_buf_init("ping", 4);
+  ASSERT(0 == uv_write(&write_req, req->handle, &buf, 1, write_cb));
+}
+
+
+static void connection_cb(uv_stream_t* handle, int status) {
+  ASSERT(status == 0);
+  ASSERT(0 == uv_tcp_init(handle->loop, &conn));
+  ASSERT(0 == uv_accept(handle, (uv_stream_t*) &conn));
+  ASSERT(0 == uv_read_start_pooled((uv_stream_t*) &conn, read_cb));
+}
+
+
+TEST_IMPL(read_pool_tcp) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+
+  ASSERT(UV_EINVAL == uv_loop_configure(loop,
+                                        UV_LOOP_READ_POOL,
+                                        (size_t) 0,
+                                        0u));
+  ASSERT(UV_EINVAL == uv_loop_configure(loop,
+                                        UV_LOOP_READ_POOL,
+                                        (size_t) 1000,
+                                        ~0u));
+  ASSERT(0 == uv_loop_configure(loop,
+                                UV_LOOP_READ_POOL,
+                                (size_t) 1000,
+                                (unsigned int) UV_READ_POOL_HUGEPAGES));
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_tcp_init(loop, &server));
+  ASSERT(0 == uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_listen((uv_stream_t*) &server, 1, connection_cb));
+  ASSERT(0 == uv_tcp_init(loop, &client));
+  ASSERT(0 == uv_tcp_connect(&connect_req,
+                             &client,
+                             (const struct sockaddr*) &addr,
+                             connect_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(read_cb_called == 2);
+
+  /* Blocks of the old size are out there. */
+  ASSERT(UV_EBUSY == uv_loop_configure(loop,
+                                       UV_LOOP_READ_POOL,
+                                       (size_t) 4096,
+                                       0u));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void send_cb(uv_udp_send_t* req, int status) {
+  ASSERT(status == 0);
+  uv_close((uv_handle_t*) req->handle, close_cb);
+}
+
+
+static void recv_cb(uv_udp_t* handle,
+                    ssize_t nread,
+                    const uv_buf_t* buf,
+                    const struct sockaddr* addr,
+                    unsigned flags) {
+  /* Released on every call, like a buffer from an alloc_cb is freed. */
+  ASSERT(buf->base != NULL);
+  ASSERT(buf->len == 64 * 1024);
+
+  if (nread == 0) {
+    uv_read_pool_release(handle->loop, buf);
+    return;
+  }
+
+  recv_cb_called++;
+  ASSERT(nread == 4);
+  ASSERT(addr != NULL);
+  ASSERT(0 == memcmp(buf->base, "pong", 4));
+  uv_read_pool_release(handle->loop, buf);
+
+  uv_close((uv_handle_t*) handle, close_cb);
+}
+
+
+TEST_IMPL(read_pool_udp) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  uv_buf_t buf;
+
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_udp_init(loop, &udp_server));
+  ASSERT(0 == uv_udp_bind(&udp_server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_udp_recv_start_pooled(&udp_server, recv_cb));
+
+  ASSERT(0 == uv_udp_init(loop, &udp_client));
+  buf = uv_buf_init("pong", 4);
+  ASSERT(0 == uv_udp_send(&send_req,
+                          &udp_client,
+                          &buf,
+                          1,
+                          (const struct sockaddr*) &addr,
+                          send_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(recv_cb_called == 1);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
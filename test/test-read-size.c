@@ -0,0 +1,226 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#ifndef _WIN32
+# include <sys/socket.h>
+# include <unistd.h>
+#endif
+
+static uv_pipe_t pipe_handle;
+static uv_udp_t udp_server;
+static uv_udp_t udp_client;
+static uv_udp_send_t send_req;
+static uv_timer_t timer;
+static char slab[64 * 1024];
+static size_t suggested[64];
+static unsigned int nsuggested;
+static size_t nread_total;
+static int read_cb_called;
+static int recv_cb_called;
+
+
+static void alloc_cb(uv_handle_t* handle,
+                     size_t suggested_size,
+                     uv_buf_t* buf) {
+  ASSERT(suggested_size <= sizeof(slab));
+  ASSERT(nsuggested < ARRAY_SIZE(suggested));
+  suggested[nsuggested++] = suggested_size;
+  buf->base = slab;
+  buf->len = suggested_size;
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  ASSERT(nread >= 0);
+  if (nread > 0) {
+    read_cb_called++;
+    nread_total += nread;
+  }
+}
+
+
+#ifndef _WIN32
+static void write_and_read(int fd, size_t size, int nreads) {
+  static char data[32 * 1024];
+
+  ASSERT(size <= sizeof(data));
+  ASSERT((ssize_t) size == write(fd, data, size));
+
+  read_cb_called = 0;
+  nread_total = 0;
+  nsuggested = 0;
+  while (nread_total < size)
+    ASSERT(0 <= uv_run(uv_default_loop(), UV_RUN_ONCE));
+
+  ASSERT(nread_total == size);
+  ASSERT(read_cb_called == nreads);
+}
+#endif
+
+
+TEST_IMPL(read_size_stream) {
+#ifdef _WIN32
+  RETURN_SKIP("Adaptive read sizing is not supported on this platform.");
+#else
+  static const size_t small[] = { 4096, 2048, 1024, 512, 256, 256 };
+  uv_loop_t* loop;
+  unsigned int i;
+  int fds[2];
+
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_timer_init(loop, &timer));
+  ASSERT(UV_EINVAL == uv_handle_set_read_size((uv_handle_t*) &timer, 1, 1));
+
+  ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  ASSERT(0 == uv_pipe_init(loop, &pipe_handle, 0));
+  ASSERT(0 == uv_pipe_open(&pipe_handle, fds[0]));
+  ASSERT(UV_EINVAL == uv_handle_set_read_size((uv_handle_t*) &pipe_handle,
+                                              0,
+                                              1024));
+  ASSERT(UV_EINVAL == uv_handle_set_read_size((uv_handle_t*) &pipe_handle,
+                                              2048,
+                                              1024));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &pipe_handle, alloc_cb, read_cb));
+
+  /* Small messages shrink the suggestion down to the minimum, by halves. */
+  for (i = 0; i < ARRAY_SIZE(small); i++) {
+    write_and_read(fds[1], 200, 1);
+    ASSERT(nsuggested == 1);
+    ASSERT(suggested[0] == small[i]);
+  }
+
+  /* A read that fills the buffer is followed by one sized to what's left. */
+  write_and_read(fds[1], 20000, 2);
+  ASSERT(nsuggested >= 2);
+  ASSERT(suggested[0] == 256);
+  ASSERT(suggested[1] == 20000 - 256);
+
+  /* And the next one starts out large enough. */
+  write_and_read(fds[1], 200, 1);
+  ASSERT(suggested[0] == 32 * 1024);
+
+  ASSERT(0 == uv_handle_set_read_size((uv_handle_t*) &pipe_handle,
+                                      1000,
+                                      1000));
+  write_and_read(fds[1], 200, 1);
+  ASSERT(suggested[0] == 1000);
+  write_and_read(fds[1], 3000, 3);
+  ASSERT(suggested[0] == 1000);
+  ASSERT(suggested[1] == 1000);
+  ASSERT(suggested[2] == 1000);
+
+  ASSERT(0 == close(fds[1]));
+  uv_close((uv_handle_t*) &pipe_handle, NULL);
+  uv_close((uv_handle_t*) &timer, NULL);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
+
+
+static void send_cb(uv_udp_send_t* req, int status) {
+  ASSERT(status == 0);
+}
+
+
+static void recv_cb(uv_udp_t* handle,
+                    ssize_t nread,
+                    const uv_buf_t* buf,
+                    const struct sockaddr* addr,
+                    unsigned flags) {
+  if (nread == 0)
+    return;
+
+  ASSERT(nread == 1000);
+  ASSERT(flags == 0);
+  recv_cb_called++;
+
+  if (recv_cb_called == 1) {
+    /* Datagrams can't be read in pieces, the default stays put. */
+    ASSERT(suggested[nsuggested - 1] == 64 * 1024);
+    return;
+  }
+
+  /* The pending datagram decides, within the bounds. */
+  ASSERT(suggested[nsuggested - 1] >= 1000);
+  ASSERT(suggested[nsuggested - 1] <= 4096);
+  uv_close((uv_handle_t*) handle, NULL);
+  uv_close((uv_handle_t*) &udp_client, NULL);
+}
+
+
+TEST_IMPL(read_size_udp) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  uv_buf_t buf;
+  int r;
+
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_udp_init(loop, &udp_server));
+  r = uv_handle_set_read_size((uv_handle_t*) &udp_server, 512, 4096);
+  if (r == UV_ENOTSUP) {
+    uv_close((uv_handle_t*) &udp_server, NULL);
+    ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+    RETURN_SKIP("Adaptive read sizing is not supported on this platform.");
+  }
+  ASSERT(r == 0);
+  ASSERT(0 == uv_handle_set_read_size((uv_handle_t*) &udp_server,
+                                      64 * 1024,
+                                      64 * 1024));
+
+  ASSERT(0 == uv_udp_bind(&udp_server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_udp_recv_start(&udp_server, alloc_cb, recv_cb));
+  ASSERT(0 == uv_udp_init(loop, &udp_client));
+
+  buf = uv_buf_init(slab, 1000);
+  ASSERT(0 == uv_udp_send(&send_req,
+                          &udp_client,
+                          &buf,
+                          1,
+                          (const struct sockaddr*) &addr,
+                          send_cb));
+  while (recv_cb_called == 0)
+    ASSERT(0 <= uv_run(loop, UV_RUN_ONCE));
+
+  ASSERT(0 == uv_handle_set_read_size((uv_handle_t*) &udp_server, 512, 4096));
+  ASSERT(0 == uv_udp_send(&send_req,
+                          &udp_client,
+                          &buf,
+                          1,
+                          (const struct sockaddr*) &addr,
+                          send_cb));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(recv_cb_called == 2);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,78 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+static uv_fs_t* last_fs_req;
+static int stat_cb_called;
+
+
+static void stat_cb(uv_fs_t* req) {
+  ASSERT(req->result == 0);
+  ASSERT(req->fs_type == UV_FS_STAT);
+  last_fs_req = req;
+  stat_cb_called++;
+  uv_req_release(req->loop, (uv_req_t*) req);
+}
+
+
+TEST_IMPL(req_pool) {
+  uv_loop_t* loop;
+  uv_req_t* req;
+  uv_req_t* write_req;
+  uv_fs_t* fs_req;
+  int i;
+
+  loop = uv_default_loop();
+
+  ASSERT(NULL == uv_req_acquire(loop, UV_UNKNOWN_REQ));
+  ASSERT(NULL == uv_req_acquire(loop, UV_REQ_TYPE_MAX));
+
+  /* A request that was never started can be released. */
+  write_req = uv_req_acquire(loop, UV_WRITE);
+  ASSERT(write_req != NULL);
+  ASSERT(write_req->type == UV_WRITE);
+  ASSERT(write_req->data == NULL);
+  uv_req_release(loop, write_req);
+
+  /* Released requests are reused for the same type only. */
+  req = uv_req_acquire(loop, UV_WRITE);
+  ASSERT(req == write_req);
+  uv_req_release(loop, req);
+
+  for (i = 0; i < 3; i++) {
+    fs_req = (uv_fs_t*) uv_req_acquire(loop, UV_FS);
+    ASSERT(fs_req != NULL);
+    ASSERT((uv_req_t*) fs_req != write_req);
+    if (i > 0)
+      ASSERT(fs_req == last_fs_req);
+
+    /* uv_req_release() takes care of uv_fs_req_cleanup(). */
+    ASSERT(0 == uv_fs_stat(loop, fs_req, ".", stat_cb));
+    ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+    ASSERT(stat_cb_called == i + 1);
+  }
+
+  /* The pools are freed when the loop is closed. */
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,255 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#define NUM_CLIENTS 4
+
+static uv_tcp_t server;
+static uv_tcp_t clients[NUM_CLIENTS];
+static uv_tcp_t conns[NUM_CLIENTS];
+static uv_connect_t connect_reqs[NUM_CLIENTS];
+static uv_timer_t timer;
+static struct sockaddr_in addr;
+static int connection_cb_called;
+static int connect_cb_called;
+static int timer_cb_called;
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT(status == 0);
+  connect_cb_called++;
+  uv_close((uv_handle_t*) req->handle, NULL);
+}
+
+
+static void start_client(int i) {
+  ASSERT(0 == uv_tcp_init(server.loop, &clients[i]));
+  ASSERT(0 == uv_tcp_connect(&connect_reqs[i],
+                             &clients[i],
+                             (const struct sockaddr*) &addr,
+                             connect_cb));
+}
+
+
+static void accept_one(void) {
+  uv_tcp_t* conn;
+
+  conn = &conns[connection_cb_called++];
+  ASSERT(0 == uv_tcp_init(server.loop, conn));
+  ASSERT(0 == uv_accept((uv_stream_t*) &server, (uv_stream_t*) conn));
+}
+
+
+static int start_server(const uv_admission_t* limits, uv_connection_cb cb) {
+  uv_loop_t* loop;
+  int err;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_tcp_init(loop, &server));
+  ASSERT(0 == uv_timer_init(loop, &timer));
+
+  err = uv_listen_set_admission((uv_stream_t*) &server, limits);
+  if (err == UV_ENOTSUP) {
+    uv_close((uv_handle_t*) &server, NULL);
+    uv_close((uv_handle_t*) &timer, NULL);
+    ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+    return err;
+  }
+
+  ASSERT(err == 0);
+  ASSERT(0 == uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_listen((uv_stream_t*) &server, 128, cb));
+  return 0;
+}
+
+
+static void close_all(void) {
+  int i;
+
+  for (i = 0; i < connection_cb_called; i++)
+    if (!uv_is_closing((uv_handle_t*) &conns[i]))
+      uv_close((uv_handle_t*) &conns[i], NULL);
+
+  uv_close((uv_handle_t*) &server, NULL);
+  uv_close((uv_handle_t*) &timer, NULL);
+}
+
+
+static void connections_connection_cb(uv_stream_t* handle, int status) {
+  ASSERT(status == 0);
+  accept_one();
+
+  if (connection_cb_called == NUM_CLIENTS)
+    close_all();
+}
+
+
+static void connections_timer_cb(uv_timer_t* handle) {
+  /* Two accepted, two waiting in the backlog. */
+  ASSERT(2 == connection_cb_called);
+  ASSERT(NUM_CLIENTS == connect_cb_called);
+  ASSERT(1 == uv_listen_is_paused((uv_stream_t*) &server));
+
+  /* Half the limit is not low enough with 50% hysteresis, none is. */
+  if (timer_cb_called++ == 0) {
+    uv_close((uv_handle_t*) &conns[0], NULL);
+  } else {
+    uv_close((uv_handle_t*) &conns[1], NULL);
+    uv_timer_stop(handle);
+  }
+}
+
+
+TEST_IMPL(tcp_admission_connections) {
+  uv_admission_t limits;
+  int i;
+
+  memset(&limits, 0, sizeof(limits));
+  limits.max_connections = 2;
+  limits.hysteresis = 50;
+
+  if (start_server(&limits, connections_connection_cb) == UV_ENOTSUP) {
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("Admission control is not supported on this platform");
+  }
+
+  limits.hysteresis = 101;
+  ASSERT(UV_EINVAL == uv_listen_set_admission((uv_stream_t*) &server,
+                                              &limits));
+
+  for (i = 0; i < NUM_CLIENTS; i++)
+    start_client(i);
+
+  ASSERT(0 == uv_timer_start(&timer, connections_timer_cb, 50, 50));
+  ASSERT(0 == uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  ASSERT(2 == timer_cb_called);
+  ASSERT(NUM_CLIENTS == connection_cb_called);
+  ASSERT(NUM_CLIENTS == connect_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void loop_lag_connect_cb(uv_connect_t* req, int status) {
+  /* The slow timer callback made the loop stop accepting. */
+  ASSERT(1 == uv_listen_is_paused((uv_stream_t*) &server));
+  connect_cb(req, status);
+}
+
+
+static void loop_lag_connection_cb(uv_stream_t* handle, int status) {
+  /* And it started again once an iteration went by quickly. */
+  ASSERT(status == 0);
+  ASSERT(1 == connect_cb_called);
+  ASSERT(0 == uv_listen_is_paused(handle));
+  accept_one();
+  close_all();
+}
+
+
+static void loop_lag_timer_cb(uv_timer_t* handle) {
+  uint64_t until;
+
+  until = uv_hrtime() + 50 * 1000000;
+  while (uv_hrtime() < until);
+
+  ASSERT(0 == uv_tcp_init(server.loop, &clients[0]));
+  ASSERT(0 == uv_tcp_connect(&connect_reqs[0],
+                             &clients[0],
+                             (const struct sockaddr*) &addr,
+                             loop_lag_connect_cb));
+}
+
+
+TEST_IMPL(tcp_admission_loop_lag) {
+  uv_admission_t limits;
+
+  memset(&limits, 0, sizeof(limits));
+  limits.max_loop_lag = 20;
+  limits.hysteresis = 50;
+
+  if (start_server(&limits, loop_lag_connection_cb) == UV_ENOTSUP) {
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("Admission control is not supported on this platform");
+  }
+
+  ASSERT(0 == uv_timer_start(&timer, loop_lag_timer_cb, 1, 0));
+  ASSERT(0 == uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  ASSERT(1 == connection_cb_called);
+  ASSERT(1 == connect_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void fds_connection_cb(uv_stream_t* handle, int status) {
+  ASSERT(status == 0);
+  ASSERT(1 == timer_cb_called);
+  ASSERT(0 == uv_listen_is_paused(handle));
+  accept_one();
+  close_all();
+}
+
+
+static void fds_timer_cb(uv_timer_t* handle) {
+  timer_cb_called++;
+  ASSERT(1 == connect_cb_called);
+  ASSERT(0 == connection_cb_called);
+  ASSERT(1 == uv_listen_is_paused((uv_stream_t*) &server));
+
+  /* Lifting the limits accepts right away. */
+  ASSERT(0 == uv_listen_set_admission((uv_stream_t*) &server, NULL));
+  ASSERT(0 == uv_listen_is_paused((uv_stream_t*) &server));
+}
+
+
+TEST_IMPL(tcp_admission_fds) {
+  uv_admission_t limits;
+
+  /* More free file descriptors than any process can have. */
+  memset(&limits, 0, sizeof(limits));
+  limits.min_free_fds = (unsigned int) -1;
+
+  if (start_server(&limits, fds_connection_cb) == UV_ENOTSUP) {
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("Admission control is not supported on this platform");
+  }
+
+  start_client(0);
+  ASSERT(0 == uv_timer_start(&timer, fds_timer_cb, 50, 0));
+  ASSERT(0 == uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  ASSERT(1 == timer_cb_called);
+  ASSERT(1 == connection_cb_called);
+  ASSERT(1 == connect_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
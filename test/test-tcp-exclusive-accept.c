@@ -0,0 +1,113 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#define NUM_CLIENTS 2
+
+static uv_tcp_t server;
+static uv_tcp_t clients[NUM_CLIENTS];
+static uv_tcp_t conns[NUM_CLIENTS];
+static uv_connect_t connect_reqs[NUM_CLIENTS];
+static uv_timer_t timer;
+static struct sockaddr_in addr;
+static int connection_cb_called;
+static int connect_cb_called;
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT(status == 0);
+  connect_cb_called++;
+  uv_close((uv_handle_t*) req->handle, NULL);
+}
+
+
+static void start_client(int i) {
+  ASSERT(0 == uv_tcp_init(server.loop, &clients[i]));
+  ASSERT(0 == uv_tcp_connect(&connect_reqs[i],
+                             &clients[i],
+                             (const struct sockaddr*) &addr,
+                             connect_cb));
+}
+
+
+static void timer_cb(uv_timer_t* handle) {
+  /* Accepting the pending connection registers the listener anew. */
+  ASSERT(0 == uv_tcp_init(server.loop, &conns[0]));
+  ASSERT(0 == uv_accept((uv_stream_t*) &server, (uv_stream_t*) &conns[0]));
+  uv_close((uv_handle_t*) &conns[0], NULL);
+  uv_close((uv_handle_t*) handle, NULL);
+  start_client(1);
+}
+
+
+static void connection_cb(uv_stream_t* handle, int status) {
+  ASSERT(status == 0);
+  ASSERT(handle == (uv_stream_t*) &server);
+
+  if (connection_cb_called++ == 0) {
+    /* Toggle the setting while listening and defer the accept, both make the
+     * listener go through the backend again.
+     */
+    ASSERT(0 == uv_tcp_exclusive_accept(&server, 0));
+    ASSERT(0 == uv_tcp_exclusive_accept(&server, 1));
+    ASSERT(0 == uv_timer_init(handle->loop, &timer));
+    ASSERT(0 == uv_timer_start(&timer, timer_cb, 1, 0));
+    return;
+  }
+
+  ASSERT(0 == uv_tcp_init(handle->loop, &conns[1]));
+  ASSERT(0 == uv_accept(handle, (uv_stream_t*) &conns[1]));
+  uv_close((uv_handle_t*) &conns[1], NULL);
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(tcp_exclusive_accept) {
+  uv_loop_t* loop;
+  int err;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_tcp_init(loop, &server));
+
+  err = uv_tcp_exclusive_accept(&server, 1);
+  if (err == UV_ENOTSUP) {
+    uv_close((uv_handle_t*) &server, NULL);
+    ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("Exclusive accept is not supported on this platform");
+  }
+
+  ASSERT(err == 0);
+  ASSERT(0 == uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_listen((uv_stream_t*) &server, 128, connection_cb));
+
+  start_client(0);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(NUM_CLIENTS == connection_cb_called);
+  ASSERT(NUM_CLIENTS == connect_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,241 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "uv.h"
+#include "task.h"
+
+#ifndef _WIN32
+# include <unistd.h>
+#endif
+
+#define NUM_CLIENTS 10
+#define MAX_BATCH 4
+
+static uv_tcp_t server;
+static uv_tcp_t clients[NUM_CLIENTS];
+static uv_tcp_t conns[NUM_CLIENTS];
+static uv_connect_t connect_reqs[NUM_CLIENTS];
+static uv_idle_t idle;
+static unsigned int accepted;
+static unsigned int held_back;
+static unsigned int largest_batch;
+static int batch_cb_called;
+static int connect_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+}
+
+
+static void accept_one(uv_stream_t* server) {
+  ASSERT(accepted < NUM_CLIENTS);
+  ASSERT(0 == uv_tcp_init(server->loop, &conns[accepted]));
+  ASSERT(0 == uv_accept(server, (uv_stream_t*) &conns[accepted]));
+  accepted++;
+}
+
+
+static void close_all(void) {
+  unsigned int i;
+
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    uv_close((uv_handle_t*) &clients[i], close_cb);
+    uv_close((uv_handle_t*) &conns[i], close_cb);
+  }
+  uv_close((uv_handle_t*) &server, close_cb);
+  uv_close((uv_handle_t*) &idle, close_cb);
+}
+
+
+static void idle_cb(uv_idle_t* handle) {
+  /* The server doesn't accept more while some are still waiting. */
+  ASSERT(batch_cb_called == 1);
+
+  while (held_back > 0) {
+    accept_one((uv_stream_t*) &server);
+    held_back--;
+  }
+
+  uv_idle_stop(handle);
+  if (accepted == NUM_CLIENTS)
+    close_all();
+}
+
+
+static void batch_cb(uv_stream_t* server, int status, unsigned int count) {
+  ASSERT(status == 0);
+  ASSERT(count > 0);
+  ASSERT(count <= MAX_BATCH);
+  ASSERT(held_back == 0);
+  batch_cb_called++;
+
+  if (count > largest_batch)
+    largest_batch = count;
+
+  if (batch_cb_called == 1) {
+    /* Leave all but one of the first batch for later. */
+    accept_one(server);
+    held_back = count - 1;
+    if (held_back > 0)
+      ASSERT(0 == uv_idle_start(&idle, idle_cb));
+  } else {
+    while (count-- > 0)
+      accept_one(server);
+  }
+
+  if (accepted == NUM_CLIENTS)
+    close_all();
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT(status == 0);
+  connect_cb_called++;
+}
+
+
+TEST_IMPL(tcp_listen_batch) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  unsigned int i;
+  int r;
+
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_tcp_init(loop, &server));
+  ASSERT(0 == uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+
+  r = uv_listen_batch((uv_stream_t*) &server, NUM_CLIENTS, MAX_BATCH, batch_cb);
+  if (r == UV_ENOTSUP) {
+    uv_close((uv_handle_t*) &server, close_cb);
+    ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+    RETURN_SKIP("Batched accepts are not supported on this platform.");
+  }
+  ASSERT(r == 0);
+  ASSERT(UV_EINVAL == uv_listen_batch((uv_stream_t*) &server, 1, 0, batch_cb));
+  ASSERT(UV_EINVAL == uv_listen_batch((uv_stream_t*) &server, 1, 1, NULL));
+  ASSERT(0 == uv_idle_init(loop, &idle));
+
+  /* Loopback connects complete right away so they're all in the backlog by
+   * the time the loop polls.
+   */
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    ASSERT(0 == uv_tcp_init(loop, &clients[i]));
+    ASSERT(0 == uv_tcp_connect(&connect_reqs[i],
+                               &clients[i],
+                               (const struct sockaddr*) &addr,
+                               connect_cb));
+  }
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(connect_cb_called == NUM_CLIENTS);
+  ASSERT(accepted == NUM_CLIENTS);
+  ASSERT(largest_batch > 1);
+  ASSERT(batch_cb_called < NUM_CLIENTS);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void unexpected_batch_cb(uv_stream_t* server,
+                                int status,
+                                unsigned int count) {
+  ASSERT(0 && "unexpected_batch_cb should not have been called");
+}
+
+
+static void relisten_batch_cb(uv_stream_t* server,
+                              int status,
+                              unsigned int count) {
+  ASSERT(status == 0);
+  ASSERT(count == 1);
+  batch_cb_called++;
+
+  ASSERT(0 == uv_tcp_init(server->loop, &conns[0]));
+  ASSERT(0 == uv_accept(server, (uv_stream_t*) &conns[0]));
+
+  uv_close((uv_handle_t*) &conns[0], close_cb);
+  uv_close((uv_handle_t*) server, close_cb);
+}
+
+
+static void relisten_connect_cb(uv_connect_t* req, int status) {
+  ASSERT(status == 0);
+  connect_cb_called++;
+  uv_close((uv_handle_t*) req->handle, close_cb);
+}
+
+
+TEST_IMPL(tcp_listen_batch_relisten_error) {
+#ifdef _WIN32
+  RETURN_SKIP("Batched accepts are not supported on this platform.");
+#else
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  uv_os_fd_t fd;
+  int saved_fd;
+  int pipe_fds[2];
+
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_tcp_init(loop, &server));
+  ASSERT(0 == uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_listen_batch((uv_stream_t*) &server,
+                              1,
+                              MAX_BATCH,
+                              relisten_batch_cb));
+
+  /* Make listen() fail by swapping a pipe in for the socket. */
+  ASSERT(0 == uv_fileno((uv_handle_t*) &server, &fd));
+  ASSERT(0 == pipe(pipe_fds));
+  saved_fd = dup(fd);
+  ASSERT(saved_fd != -1);
+  ASSERT(fd == dup2(pipe_fds[0], fd));
+
+  ASSERT(UV_ENOTSOCK == uv_listen_batch((uv_stream_t*) &server,
+                                        1,
+                                        1,
+                                        unexpected_batch_cb));
+
+  ASSERT(fd == dup2(saved_fd, fd));
+  ASSERT(0 == close(saved_fd));
+  ASSERT(0 == close(pipe_fds[0]));
+  ASSERT(0 == close(pipe_fds[1]));
+
+  /* The server keeps accepting with its original callback. */
+  ASSERT(0 == uv_tcp_init(loop, &clients[0]));
+  ASSERT(0 == uv_tcp_connect(&connect_reqs[0],
+                             &clients[0],
+                             (const struct sockaddr*) &addr,
+                             relisten_connect_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(connect_cb_called == 1);
+  ASSERT(batch_cb_called == 1);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
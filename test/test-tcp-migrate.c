@@ -0,0 +1,283 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+/* More than fit in uv_write_t's inline buffer list. */
+#define NUM_BUFS 8
+
+static uv_loop_t target;
+static uv_async_t target_stop;
+static uv_thread_t target_thread;
+static uv_sem_t target_ready;
+
+static uv_tcp_t server;
+static uv_tcp_t conn;
+static uv_tcp_t client;
+static uv_connect_t connect_req;
+static uv_write_t client_write_req;
+static uv_write_t conn_write_req;
+static uv_buf_t conn_bufs[NUM_BUFS];
+static char slab[64];
+static size_t client_nread;
+
+static int migrate_cb_called;
+static int conn_write_cb_called;
+static int conn_read_on_target;
+static int close_cb_called;
+
+
+static int on_target_thread(void) {
+  uv_thread_t self;
+
+  self = uv_thread_self();
+  return uv_thread_equal(&self, &target_thread);
+}
+
+
+static void target_stop_cb(uv_async_t* handle) {
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static void target_run(void* arg) {
+  uv_sem_post(&target_ready);
+  ASSERT(0 == uv_run(&target, UV_RUN_DEFAULT));
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  buf->base = slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void conn_close_cb(uv_handle_t* handle) {
+  ASSERT(on_target_thread());
+  ASSERT(handle->loop == &target);
+  close_cb_called++;
+  ASSERT(0 == uv_async_send(&target_stop));
+}
+
+
+static void conn_write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+  ASSERT(on_target_thread());
+  ASSERT(1 == migrate_cb_called);
+  conn_write_cb_called++;
+}
+
+
+static void migrate_cb(uv_stream_t* handle, int status) {
+  ASSERT(status == 0);
+  ASSERT(handle == (uv_stream_t*) &conn);
+  ASSERT(handle->loop == &target);
+  ASSERT(on_target_thread());
+  ASSERT(0 == conn_write_cb_called);
+  migrate_cb_called++;
+}
+
+
+static void conn_read_cb(uv_stream_t* handle,
+                         ssize_t nread,
+                         const uv_buf_t* buf) {
+  unsigned int i;
+
+  if (nread == 0)
+    return;
+
+  if (migrate_cb_called == 0) {
+    /* Still on the source loop: reply and hand the connection over from
+     * inside the read callback.
+     */
+    ASSERT(!on_target_thread());
+    ASSERT(nread == 4);
+    ASSERT(0 == memcmp(buf->base, "ping", 4));
+
+    for (i = 0; i < NUM_BUFS; i++)
+      conn_bufs[i] = uv_buf_init("0123456789", 10);
+    ASSERT(0 == uv_write(&conn_write_req,
+                         handle,
+                         conn_bufs,
+                         NUM_BUFS,
+                         conn_write_cb));
+
+    /* Pooled buffers belong to the source loop. */
+    ASSERT(0 == uv_read_stop(handle));
+    ASSERT(0 == uv_read_start_pooled(handle, conn_read_cb));
+    ASSERT(UV_EBUSY == uv_stream_migrate(handle, &target, migrate_cb));
+    ASSERT(0 == uv_read_stop(handle));
+    ASSERT(0 == uv_read_start(handle, alloc_cb, conn_read_cb));
+
+    ASSERT(UV_EINVAL == uv_stream_migrate(handle, handle->loop, migrate_cb));
+    ASSERT(0 == uv_stream_migrate(handle, &target, migrate_cb));
+    ASSERT(UV_EBUSY == uv_stream_migrate(handle, &target, migrate_cb));
+    return;
+  }
+
+  ASSERT(on_target_thread());
+  ASSERT(handle->loop == &target);
+
+  if (nread == UV_EOF) {
+    ASSERT(1 == conn_read_on_target);
+    uv_close((uv_handle_t*) handle, conn_close_cb);
+    return;
+  }
+
+  ASSERT(nread == 4);
+  ASSERT(0 == memcmp(buf->base, "pong", 4));
+  conn_read_on_target++;
+}
+
+
+static void client_read_cb(uv_stream_t* handle,
+                           ssize_t nread,
+                           const uv_buf_t* buf) {
+  uv_buf_t pong;
+
+  ASSERT(nread >= 0);
+  client_nread += nread;
+  ASSERT(client_nread <= 10 * NUM_BUFS);
+
+  if (client_nread == 10 * NUM_BUFS) {
+    pong = uv_buf_init("pong", 4);
+    ASSERT(4 == uv_try_write(handle, &pong, 1));
+    uv_close((uv_handle_t*) handle, close_cb);
+    uv_close((uv_handle_t*) &server, close_cb);
+  }
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  uv_buf_t ping;
+
+  ASSERT(status == 0);
+  ping = uv_buf_init("ping", 4);
+  ASSERT(0 == uv_write(&client_write_req, req->handle, &ping, 1, NULL));
+  ASSERT(0 == uv_read_start(req->handle, alloc_cb, client_read_cb));
+}
+
+
+static void connection_cb(uv_stream_t* handle, int status) {
+  ASSERT(status == 0);
+  ASSERT(0 == uv_tcp_init(handle->loop, &conn));
+  ASSERT(0 == uv_accept(handle, (uv_stream_t*) &conn));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &conn, alloc_cb, conn_read_cb));
+}
+
+
+TEST_IMPL(tcp_migrate) {
+#ifdef _WIN32
+  RETURN_SKIP("Handles can't move between completion ports.");
+#else
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_loop_init(&target));
+  ASSERT(0 == uv_async_init(&target, &target_stop, target_stop_cb));
+  ASSERT(0 == uv_sem_init(&target_ready, 0));
+  ASSERT(0 == uv_thread_create(&target_thread, target_run, NULL));
+  uv_sem_wait(&target_ready);
+
+  ASSERT(0 == uv_tcp_init(loop, &server));
+  ASSERT(0 == uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_listen((uv_stream_t*) &server, 1, connection_cb));
+  ASSERT(UV_EINVAL == uv_stream_migrate((uv_stream_t*) &server,
+                                        &target,
+                                        migrate_cb));
+
+  ASSERT(0 == uv_tcp_init(loop, &client));
+  ASSERT(0 == uv_tcp_connect(&connect_req,
+                             &client,
+                             (const struct sockaddr*) &addr,
+                             connect_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(0 == uv_thread_join(&target_thread));
+
+  ASSERT(1 == migrate_cb_called);
+  ASSERT(1 == conn_write_cb_called);
+  ASSERT(1 == conn_read_on_target);
+  ASSERT(3 == close_cb_called);
+
+  uv_sem_destroy(&target_ready);
+  ASSERT(0 == uv_loop_close(&target));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
+
+
+static void cancelled_migrate_cb(uv_stream_t* handle, int status) {
+  ASSERT(status == UV_ECANCELED);
+  ASSERT(handle->loop == uv_default_loop());
+  ASSERT(uv_is_closing((uv_handle_t*) handle));
+  migrate_cb_called++;
+}
+
+
+TEST_IMPL(tcp_migrate_close) {
+#ifdef _WIN32
+  RETURN_SKIP("Handles can't move between completion ports.");
+#else
+  uv_tcp_t handle;
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_loop_init(&target));
+
+  ASSERT(0 == uv_tcp_init(loop, &handle));
+  ASSERT(UV_ENOTCONN == uv_stream_migrate((uv_stream_t*) &handle,
+                                          &target,
+                                          cancelled_migrate_cb));
+  uv_close((uv_handle_t*) &handle, NULL);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  /* Closing the handle before the source loop gets around to handing it over
+   * cancels the migration.
+   */
+  ASSERT(0 == uv_tcp_init_ex(loop, &handle, AF_INET));
+  ASSERT(0 == uv_stream_migrate((uv_stream_t*) &handle,
+                                &target,
+                                cancelled_migrate_cb));
+  uv_close((uv_handle_t*) &handle, close_cb);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(1 == migrate_cb_called);
+  ASSERT(1 == close_cb_called);
+  ASSERT(0 == uv_loop_close(&target));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
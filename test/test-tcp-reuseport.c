@@ -0,0 +1,109 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#define NUM_LOOPS 2
+#define NUM_CLIENTS 8
+
+static uv_loop_t loops[NUM_LOOPS];
+static uv_tcp_t servers[NUM_LOOPS];
+static uv_tcp_t clients[NUM_CLIENTS];
+static uv_connect_t connect_reqs[NUM_CLIENTS];
+static uv_tcp_t conns[NUM_CLIENTS];
+static int connection_cb_called;
+static int connect_cb_called;
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT(status == 0);
+  connect_cb_called++;
+  uv_close((uv_handle_t*) req->handle, NULL);
+}
+
+
+static void connection_cb(uv_stream_t* server, int status) {
+  uv_tcp_t* conn;
+
+  ASSERT(status == 0);
+  ASSERT(connection_cb_called < NUM_CLIENTS);
+
+  conn = &conns[connection_cb_called++];
+  ASSERT(0 == uv_tcp_init(server->loop, conn));
+  ASSERT(0 == uv_accept(server, (uv_stream_t*) conn));
+  uv_close((uv_handle_t*) conn, NULL);
+}
+
+
+TEST_IMPL(tcp_reuseport) {
+  struct sockaddr_in addr;
+  uv_tcp_t other;
+  int err;
+  int i;
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+
+  for (i = 0; i < NUM_LOOPS; i++) {
+    ASSERT(0 == uv_loop_init(&loops[i]));
+    ASSERT(0 == uv_tcp_init(&loops[i], &servers[i]));
+    err = uv_tcp_bind(&servers[i],
+                      (const struct sockaddr*) &addr,
+                      UV_TCP_REUSEPORT);
+    if (err == UV_ENOTSUP)
+      RETURN_SKIP("UV_TCP_REUSEPORT is not supported on this platform");
+    ASSERT(err == 0);
+    ASSERT(0 == uv_listen((uv_stream_t*) &servers[i], 128, connection_cb));
+  }
+
+  /* Sockets that didn't ask for it can't join the group. */
+  ASSERT(0 == uv_tcp_init(&loops[0], &other));
+  ASSERT(0 == uv_tcp_bind(&other, (const struct sockaddr*) &addr, 0));
+  ASSERT(UV_EADDRINUSE == uv_listen((uv_stream_t*) &other, 128, NULL));
+  uv_close((uv_handle_t*) &other, NULL);
+
+  /* Needs Linux 4.5 or newer. */
+  err = uv_tcp_reuseport_steer_cpu(&servers[0]);
+  ASSERT(err == 0 || err == UV_ENOPROTOOPT || err == UV_ENOTSUP);
+
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    ASSERT(0 == uv_tcp_init(&loops[0], &clients[i]));
+    ASSERT(0 == uv_tcp_connect(&connect_reqs[i],
+                               &clients[i],
+                               (const struct sockaddr*) &addr,
+                               connect_cb));
+  }
+
+  /* The loops share a thread so take turns. */
+  while (connect_cb_called < NUM_CLIENTS ||
+         connection_cb_called < NUM_CLIENTS) {
+    for (i = 0; i < NUM_LOOPS; i++)
+      uv_run(&loops[i], UV_RUN_NOWAIT);
+  }
+
+  for (i = 0; i < NUM_LOOPS; i++) {
+    uv_close((uv_handle_t*) &servers[i], NULL);
+    ASSERT(0 == uv_run(&loops[i], UV_RUN_DEFAULT));
+    ASSERT(0 == uv_loop_close(&loops[i]));
+  }
+
+  return 0;
+}
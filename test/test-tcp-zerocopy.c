@@ -0,0 +1,181 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_LARGE 4
+#define LARGE_SIZE (1024 * 1024)
+
+static uv_tcp_t server;
+static uv_tcp_t client;
+static uv_tcp_t conn;
+static uv_connect_t connect_req;
+static uv_shutdown_t shutdown_req;
+static uv_write_t large_reqs[NUM_LARGE];
+static uv_write_t small_req;
+static char* large_bufs[NUM_LARGE];
+static char small_buf[] = "tail";
+static size_t bytes_read;
+static int write_cb_called;
+static int shutdown_cb_called;
+static int eof_seen;
+static char read_buf[65536];
+
+
+static char pattern(size_t offset) {
+  return (char) ('a' + offset % 26);
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+
+  if (req == &small_req) {
+    /* Queued last, so it has to come out last. */
+    ASSERT(write_cb_called == NUM_LARGE);
+  } else {
+    ASSERT(req == &large_reqs[write_cb_called]);
+    /* The kernel is done with the buffer, scribbling over it must not
+     * change what the peer receives.
+     */
+    memset(large_bufs[write_cb_called], 0, LARGE_SIZE);
+  }
+
+  write_cb_called++;
+}
+
+
+static void shutdown_cb(uv_shutdown_t* req, int status) {
+  ASSERT(status == 0);
+  ASSERT(write_cb_called == NUM_LARGE + 1);
+  shutdown_cb_called++;
+  uv_close((uv_handle_t*) &client, NULL);
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  uv_buf_t buf;
+  int i;
+
+  ASSERT(status == 0);
+  ASSERT(0 == uv_tcp_zerocopy(&client, 1, 64 * 1024));
+
+  for (i = 0; i < NUM_LARGE; i++) {
+    buf = uv_buf_init(large_bufs[i], LARGE_SIZE);
+    ASSERT(0 == uv_write(&large_reqs[i],
+                         (uv_stream_t*) &client,
+                         &buf,
+                         1,
+                         write_cb));
+  }
+
+  buf = uv_buf_init(small_buf, sizeof(small_buf) - 1);
+  ASSERT(0 == uv_write(&small_req, (uv_stream_t*) &client, &buf, 1, write_cb));
+  ASSERT(0 == uv_shutdown(&shutdown_req, (uv_stream_t*) &client, shutdown_cb));
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  *buf = uv_buf_init(read_buf, sizeof(read_buf));
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  ssize_t i;
+
+  if (nread == UV_EOF) {
+    eof_seen = 1;
+    uv_close((uv_handle_t*) stream, NULL);
+    uv_close((uv_handle_t*) &server, NULL);
+    return;
+  }
+
+  ASSERT(nread >= 0);
+
+  for (i = 0; i < nread; i++, bytes_read++) {
+    if (bytes_read < (size_t) NUM_LARGE * LARGE_SIZE)
+      ASSERT(buf->base[i] == pattern(bytes_read));
+    else
+      ASSERT(buf->base[i] == small_buf[bytes_read - NUM_LARGE * LARGE_SIZE]);
+  }
+}
+
+
+static void connection_cb(uv_stream_t* handle, int status) {
+  ASSERT(status == 0);
+  ASSERT(0 == uv_tcp_init(handle->loop, &conn));
+  ASSERT(0 == uv_accept(handle, (uv_stream_t*) &conn));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &conn, alloc_cb, read_cb));
+}
+
+
+TEST_IMPL(tcp_zerocopy) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  size_t i;
+  int r;
+
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_tcp_init(loop, &client));
+  r = uv_tcp_zerocopy(&client, 1, 0);
+  if (r == UV_ENOTSUP) {
+    uv_close((uv_handle_t*) &client, NULL);
+    ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+    RETURN_SKIP("Zero-copy writes are not supported on this platform.");
+  }
+
+  /* There is no socket yet. */
+  ASSERT(r == UV_EBADF);
+
+  for (i = 0; i < NUM_LARGE; i++) {
+    large_bufs[i] = malloc(LARGE_SIZE);
+    ASSERT(large_bufs[i] != NULL);
+    for (r = 0; r < LARGE_SIZE; r++)
+      large_bufs[i][r] = pattern(i * LARGE_SIZE + r);
+  }
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_tcp_init(loop, &server));
+  ASSERT(0 == uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_listen((uv_stream_t*) &server, 1, connection_cb));
+  ASSERT(0 == uv_tcp_connect(&connect_req,
+                             &client,
+                             (const struct sockaddr*) &addr,
+                             connect_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(write_cb_called == NUM_LARGE + 1);
+  ASSERT(shutdown_cb_called == 1);
+  ASSERT(eof_seen == 1);
+  ASSERT(bytes_read == NUM_LARGE * LARGE_SIZE + sizeof(small_buf) - 1);
+
+  for (i = 0; i < NUM_LARGE; i++)
+    free(large_bufs[i]);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,228 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#ifndef _WIN32
+# include <sys/socket.h>
+# include <unistd.h>
+#endif
+
+static uv_tcp_t server;
+static uv_tcp_t client;
+static uv_tcp_t conn;
+static uv_connect_t connect_req;
+static uv_write_t write_req;
+static uv_idle_t idle;
+static char data[8];
+static size_t nread_total;
+static int eof_seen;
+
+
+static void close_cb(uv_handle_t* handle) {
+}
+
+
+static void idle_cb(uv_idle_t* handle) {
+  char a[3];
+  char b[3];
+  uv_buf_t bufs[2];
+  int r;
+
+  bufs[0] = uv_buf_init(a, sizeof(a));
+  bufs[1] = uv_buf_init(b, sizeof(b));
+
+  r = uv_try_read((uv_stream_t*) &conn, bufs, ARRAY_SIZE(bufs));
+  if (r == UV_EAGAIN)
+    return;
+
+  if (nread_total < sizeof(data)) {
+    /* Fills the buffers in order. */
+    ASSERT(r > 0);
+    ASSERT(nread_total + r <= sizeof(data));
+    memcpy(data + nread_total, a, r < 3 ? r : 3);
+    if (r > 3)
+      memcpy(data + nread_total + 3, b, r - 3);
+    nread_total += r;
+
+    if (nread_total == sizeof(data)) {
+      ASSERT(0 == memcmp(data, "PINGPONG", sizeof(data)));
+      /* Nothing more until the client goes away. */
+      ASSERT(UV_EAGAIN == uv_try_read((uv_stream_t*) &conn, bufs, 2));
+      uv_close((uv_handle_t*) &client, close_cb);
+    }
+    return;
+  }
+
+  ASSERT(r == UV_EOF);
+  eof_seen++;
+  /* And it stays that way. */
+  ASSERT(UV_EOF == uv_try_read((uv_stream_t*) &conn, bufs, 2));
+
+  uv_idle_stop(handle);
+  uv_close((uv_handle_t*) handle, close_cb);
+  uv_close((uv_handle_t*) &conn, close_cb);
+  uv_close((uv_handle_t*) &server, close_cb);
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  uv_buf_t buf;
+
+  ASSERT(status == 0);
+  buf = uv_buf_init("PINGPONG", 8);
+  ASSERT(0 == uv_write(&write_req, req->handle, &buf, 1, write_cb));
+}
+
+
+static void connection_cb(uv_stream_t* handle, int status) {
+  uv_buf_t buf;
+
+  ASSERT(status == 0);
+  ASSERT(0 == uv_tcp_init(handle->loop, &conn));
+  ASSERT(0 == uv_accept(handle, (uv_stream_t*) &conn));
+
+  buf = uv_buf_init(NULL, 0);
+  ASSERT(UV_EINVAL == uv_try_read((uv_stream_t*) &conn, &buf, 1));
+  ASSERT(UV_EINVAL == uv_try_read((uv_stream_t*) &conn, &buf, 0));
+
+  ASSERT(0 == uv_idle_start(&idle, idle_cb));
+}
+
+
+TEST_IMPL(try_read_tcp) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  uv_buf_t buf;
+  char c;
+
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_tcp_init(loop, &server));
+  ASSERT(0 == uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_listen((uv_stream_t*) &server, 1, connection_cb));
+  ASSERT(0 == uv_idle_init(loop, &idle));
+
+  ASSERT(0 == uv_tcp_init(loop, &client));
+  buf = uv_buf_init(&c, 1);
+  ASSERT(UV_ENOTCONN == uv_try_read((uv_stream_t*) &client, &buf, 1));
+  ASSERT(0 == uv_tcp_connect(&connect_req,
+                             &client,
+                             (const struct sockaddr*) &addr,
+                             connect_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(nread_total == sizeof(data));
+  ASSERT(eof_seen == 1);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+#ifndef _WIN32
+static uv_pipe_t ipc_sender;
+static uv_pipe_t ipc_receiver;
+static uv_tcp_t sent_handle;
+static uv_tcp_t received_handle;
+static int ipc_write_cb_called;
+
+
+static void ipc_write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+  ipc_write_cb_called++;
+}
+#endif
+
+
+TEST_IMPL(try_read_ipc) {
+#ifdef _WIN32
+  RETURN_SKIP("Reading IPC pipes synchronously is not supported on Windows.");
+#else
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  uv_buf_t buf;
+  char c;
+  int fds[2];
+  int r;
+
+  loop = uv_default_loop();
+
+  ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  ASSERT(0 == uv_pipe_init(loop, &ipc_sender, 1));
+  ASSERT(0 == uv_pipe_open(&ipc_sender, fds[0]));
+  ASSERT(0 == uv_pipe_init(loop, &ipc_receiver, 1));
+  ASSERT(0 == uv_pipe_open(&ipc_receiver, fds[1]));
+
+  buf = uv_buf_init(&c, 1);
+  ASSERT(UV_EAGAIN == uv_try_read((uv_stream_t*) &ipc_receiver, &buf, 1));
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_tcp_init(loop, &sent_handle));
+  ASSERT(0 == uv_tcp_bind(&sent_handle, (const struct sockaddr*) &addr, 0));
+
+  buf = uv_buf_init("X", 1);
+  ASSERT(0 == uv_write2(&write_req,
+                        (uv_stream_t*) &ipc_sender,
+                        &buf,
+                        1,
+                        (uv_stream_t*) &sent_handle,
+                        ipc_write_cb));
+  while (ipc_write_cb_called == 0)
+    ASSERT(0 <= uv_run(loop, UV_RUN_ONCE));
+
+  /* The data and the handle that came with it. */
+  buf = uv_buf_init(&c, 1);
+  ASSERT(1 == uv_try_read((uv_stream_t*) &ipc_receiver, &buf, 1));
+  ASSERT(c == 'X');
+  ASSERT(1 == uv_pipe_pending_count(&ipc_receiver));
+  ASSERT(UV_TCP == uv_pipe_pending_type(&ipc_receiver));
+  ASSERT(0 == uv_tcp_init(loop, &received_handle));
+  ASSERT(0 == uv_accept((uv_stream_t*) &ipc_receiver,
+                        (uv_stream_t*) &received_handle));
+  ASSERT(0 == uv_pipe_pending_count(&ipc_receiver));
+
+  r = uv_try_read((uv_stream_t*) &ipc_receiver, &buf, 1);
+  ASSERT(r == UV_EAGAIN);
+
+  uv_close((uv_handle_t*) &ipc_sender, close_cb);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(UV_EOF == uv_try_read((uv_stream_t*) &ipc_receiver, &buf, 1));
+
+  uv_close((uv_handle_t*) &ipc_receiver, close_cb);
+  uv_close((uv_handle_t*) &sent_handle, close_cb);
+  uv_close((uv_handle_t*) &received_handle, close_cb);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
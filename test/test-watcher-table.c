@@ -0,0 +1,141 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdlib.h>
+
+#ifndef _WIN32
+# include <sys/resource.h>
+# include <unistd.h>
+#endif
+
+/* Upper bound on the watcher table growth for a single high file descriptor.
+ * A flat array indexed by file descriptor needs several hundred kilobytes for
+ * the file descriptors this test uses.
+ */
+#define MAX_TABLE_GROWTH 16384
+
+static size_t live_bytes;
+static int poll_cb_called;
+
+
+static void* tracking_malloc(void* ctx, size_t size) {
+  size_t* p;
+
+  p = malloc(sizeof(*p) + size);
+  if (p == NULL)
+    return NULL;
+
+  *p = size;
+  live_bytes += size;
+
+  return p + 1;
+}
+
+
+static void* tracking_realloc(void* ctx, void* ptr, size_t size) {
+  size_t* p;
+
+  p = (size_t*) ptr - 1;
+  live_bytes -= *p;
+  p = realloc(p, sizeof(*p) + size);
+  ASSERT(p != NULL);
+  *p = size;
+  live_bytes += size;
+
+  return p + 1;
+}
+
+
+static void tracking_free(void* ctx, void* ptr) {
+  size_t* p;
+
+  p = (size_t*) ptr - 1;
+  live_bytes -= *p;
+  free(p);
+}
+
+
+static void poll_cb(uv_poll_t* handle, int status, int events) {
+  ASSERT(status == 0);
+  ASSERT(events == UV_READABLE);
+  poll_cb_called++;
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(watcher_table_sparse) {
+#ifdef _WIN32
+  RETURN_SKIP("Test does not currently work on Windows");
+#else
+  struct rlimit lim;
+  uv_loop_t loop;
+  uv_poll_t poll_handle;
+  size_t baseline;
+  int fds[2];
+  int fd;
+
+  ASSERT(0 == getrlimit(RLIMIT_NOFILE, &lim));
+  if (lim.rlim_cur < 65536 && lim.rlim_cur < lim.rlim_max) {
+    lim.rlim_cur = lim.rlim_max < 65536 ? lim.rlim_max : 65536;
+    setrlimit(RLIMIT_NOFILE, &lim);
+    ASSERT(0 == getrlimit(RLIMIT_NOFILE, &lim));
+  }
+
+  if (lim.rlim_cur != RLIM_INFINITY && lim.rlim_cur < 16384)
+    RETURN_SKIP("RLIMIT_NOFILE too low");
+
+  ASSERT(0 == pipe(fds));
+  fd = lim.rlim_cur == RLIM_INFINITY || lim.rlim_cur > 65536 ?
+       65535 : (int) lim.rlim_cur - 1;
+  ASSERT(fd == dup2(fds[0], fd));
+  ASSERT(0 == close(fds[0]));
+
+  ASSERT(0 == uv_loop_init(&loop));
+  ASSERT(0 == uv_loop_replace_allocator(&loop,
+                                        NULL,
+                                        tracking_malloc,
+                                        tracking_realloc,
+                                        tracking_free));
+  baseline = live_bytes;
+
+  ASSERT(0 == uv_poll_init(&loop, &poll_handle, fd));
+  ASSERT(0 == uv_poll_start(&poll_handle, UV_READABLE, poll_cb));
+  ASSERT(live_bytes > baseline);
+  ASSERT(live_bytes - baseline < MAX_TABLE_GROWTH);
+
+  ASSERT(1 == write(fds[1], "x", 1));
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT(1 == poll_cb_called);
+
+  /* The chunk that held the watcher is gone and so is the directory entry. */
+  ASSERT(live_bytes == baseline);
+
+  ASSERT(0 == uv_loop_close(&loop));
+  ASSERT(0 == live_bytes);
+  ASSERT(0 == close(fd));
+  ASSERT(0 == close(fds[1]));
+
+  return 0;
+#endif
+}
@@ -21,14 +21,17 @@
         'test-close-order.c',
         'test-connect-unspecified.c',
         'test-connection-fail.c',
+        'test-cpu-topology.c',
         'test-cwd-and-chdir.c',
         'test-default-loop-close.c',
+        'test-defer.c',
         'test-delayed-accept.c',
         'test-eintr-handling.c',
         'test-error.c',
         'test-embed.c',
         'test-emfile.c',
         'test-env-vars.c',
+        'test-epoch.c',
         'test-fail-always.c',
         'test-fork.c',
         'test-fs.c',
@@ -48,21 +51,31 @@
         'test-handle-fileno.c',
         'test-homedir.c',
         'test-hrtime.c',
+        'test-idle-task.c',
         'test-idle.c',
         'test-idna.c',
+        'test-io-priority.c',
         'test-ip6-addr.c',
         'test-ipc-heavy-traffic-deadlock-bug.c',
+        'test-ipc-send-handles.c',
         'test-ipc-send-recv.c',
         'test-ipc.c',
         'test-list.h',
         'test-loop-handles.c',
         'test-loop-alive.c',
+        'test-loop-alloc-stats.c',
+        'test-loop-allocator.c',
         'test-loop-close.c',
         'test-loop-stop.c',
+        'test-loop-time-budget.c',
         'test-loop-time.c',
+        'test-loop-trace.c',
+        'test-loop-watchdog.c',
         'test-loop-configure.c',
+        'test-loop-group.c',
         'test-walk-handles.c',
         'test-watcher-cross-stop.c',
+        'test-watcher-table.c',
         'test-multiple-listen.c',
         'test-osx-select.c',
         'test-pass-always.c',
@@ -88,7 +101,10 @@
         'test-process-title.c',
         'test-process-title-threadsafe.c',
         'test-queue-foreach-delete.c',
+        'test-read-pool.c',
+        'test-read-size.c',
         'test-ref.c',
+        'test-req-pool.c',
         'test-run-nowait.c',
         'test-run-once.c',
         'test-semaphore.c',
@@ -100,6 +116,7 @@
         'test-socket-buffer-size.c',
         'test-spawn.c',
         'test-strscpy.c',
+        'test-tcp-admission.c',
         'test-stdio-over-pipes.c',
         'test-tcp-alloc-cb-fail.c',
         'test-tcp-bind-error.c',
@@ -108,9 +125,12 @@
         'test-tcp-close-accept.c',
         'test-tcp-close-while-connecting.c',
         'test-tcp-create-socket-early.c',
+        'test-tcp-exclusive-accept.c',
         'test-tcp-connect-error-after-write.c',
         'test-tcp-shutdown-after-write.c',
         'test-tcp-flags.c',
+        'test-tcp-listen-batch.c',
+        'test-tcp-migrate.c',
         'test-tcp-connect-error.c',
         'test-tcp-connect-timeout.c',
         'test-tcp-connect6-error.c',
@@ -118,16 +138,19 @@
         'test-tcp-write-to-half-open-connection.c',
         'test-tcp-write-after-connect.c',
         'test-tcp-writealot.c',
+        'test-tcp-zerocopy.c',
         'test-tcp-write-fail.c',
         'test-tcp-try-write.c',
         'test-tcp-unexpected-read.c',
         'test-tcp-oob.c',
         'test-tcp-read-stop.c',
+        'test-tcp-reuseport.c',
         'test-tcp-write-queue-order.c',
         'test-threadpool.c',
         'test-threadpool-cancel.c',
         'test-thread-equal.c',
         'test-tmpdir.c',
+        'test-try-read.c',
         'test-mutexes.c',
         'test-thread.c',
         'test-barrier.c',
@@ -229,18 +252,23 @@
         'benchmark-async-pummel.c',
         'benchmark-fs-stat.c',
         'benchmark-getaddrinfo.c',
+        'benchmark-io-priority.c',
         'benchmark-list.h',
         'benchmark-loop-count.c',
+        'benchmark-loop-group.c',
         'benchmark-million-async.c',
         'benchmark-million-timers.c',
         'benchmark-multi-accept.c',
         'benchmark-ping-pongs.c',
         'benchmark-pound.c',
         'benchmark-pump.c',
+        'benchmark-req-pool.c',
         'benchmark-sizes.c',
         'benchmark-spawn.c',
         'benchmark-thread.c',
         'benchmark-tcp-write-batch.c',
+        'benchmark-tcp-write-small-batch.c',
+        'benchmark-tcp-zerocopy.c',
         'benchmark-udp-pummel.c',
         'dns-server.c',
         'echo-server.c',
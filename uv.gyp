@@ -68,16 +68,24 @@
         'include/uv/errno.h',
         'include/uv/threadpool.h',
         'include/uv/version.h',
+        'src/arena.c',
+        'src/defer.c',
+        'src/epoch.c',
         'src/fs-poll.c',
         'src/heap-inl.h',
+        'src/idle-task.c',
         'src/idna.c',
         'src/idna.h',
         'src/inet.c',
+        'src/loop-group.c',
         'src/queue.h',
+        'src/read-pool.c',
         'src/strscpy.c',
         'src/strscpy.h',
         'src/threadpool.c',
         'src/timer.c',
+        'src/trace.c',
+        'src/watchdog.c',
         'src/uv-data-getter-setters.c',
         'src/uv-common.c',
         'src/uv-common.h',